@@ -0,0 +1,182 @@
+#include "bench.h"
+#include <time.h>
+#include <sys/utsname.h>
+#include <limits.h>
+
+#define BENCH_MAX_RESULTS 128
+
+struct BenchResult {
+    char name[64];
+    long iters;
+    double real_ns, cpu_ns;
+};
+
+static const char *program = "bench";
+static char *json_dir;          // absolute, the program may chdir()
+static struct BenchResult results[BENCH_MAX_RESULTS];
+static int result_count;
+
+void bench_init(const char *argv0) {
+    const char *slash = strrchr(argv0, '/');
+    program = slash ? slash + 1 : argv0;
+
+    const char *dir = getenv("BENCH_JSON");
+    if (dir && *dir && !(json_dir = realpath(dir, NULL))) perror(dir);
+}
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int by_value(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void record(const char *name, double real_ns, double cpu_ns, long iters) {
+    if (result_count == BENCH_MAX_RESULTS) return;
+    struct BenchResult *r = &results[result_count++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->iters = iters;
+    r->real_ns = real_ns;
+    r->cpu_ns = cpu_ns;
+}
+
+// slow operations (a whole file written) read better in ms
+static void print_time(const char *name, double ns) {
+    if (ns >= 1e6) printf("%-32s %10.2f ms/op", name, ns / 1e6);
+    else printf("%-32s %10.2f ns/op", name, ns);
+}
+
+// ns/op, median of BENCH_REPS runs
+double bench_run(const char *name, bench_fn fn, void *arg) {
+    long iters = 1;
+    while (1) {
+        double t0 = bench_now();
+        fn(arg, iters);
+        double t = bench_now() - t0;
+        if (t >= BENCH_MIN_SEC || iters >= (1L << 40)) break;
+        // aim a bit past the minimum, at most 10x per step
+        double grow = t > 0 ? BENCH_MIN_SEC * 1.4 / t : 10;
+        if (grow > 10) grow = 10;
+        if (grow < 2) grow = 2;
+        iters = (long)(iters * grow);
+    }
+
+    double real[BENCH_REPS], cpu[BENCH_REPS];
+    for (int i = 0; i < BENCH_REPS; i++) {
+        double t0 = bench_now(), c0 = cpu_now();
+        fn(arg, iters);
+        cpu[i] = (cpu_now() - c0) * 1e9 / iters;
+        real[i] = (bench_now() - t0) * 1e9 / iters;
+    }
+    qsort(real, BENCH_REPS, sizeof(real[0]), by_value);
+    qsort(cpu, BENCH_REPS, sizeof(cpu[0]), by_value);
+
+    double ns = real[BENCH_REPS / 2];
+    print_time(name, ns);
+    printf("  (min %.2f ns, %ld iterations)\n", real[0], iters);
+    record(name, ns, cpu[BENCH_REPS / 2], iters);
+    return ns;
+}
+
+// a measurement the program timed itself
+void bench_report(const char *name, double ns_per_op, long iters) {
+    print_time(name, ns_per_op);
+    printf("\n");
+    record(name, ns_per_op, ns_per_op, iters);
+}
+
+// JSON only, for programs that print their own table
+void bench_record(const char *name, double ns, long iters) {
+    record(name, ns, ns, iters);
+}
+
+// fn in a fresh process (state that can only be set up once per
+// process, like a server start). Its return value and whatever it
+// recorded come back through a pipe
+double bench_in_child(double (*fn)(void *arg), void *arg) {
+    int fds[2];
+    if (pipe(fds) < 0) { perror("pipe"); exit(1); }
+    fflush(stdout);
+    int before = result_count;
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); exit(1); }
+    if (pid == 0) {
+        close(fds[0]);
+        double v = fn(arg);
+        fflush(stdout);
+        int n = result_count - before;
+        if (write(fds[1], &v, sizeof(v)) != sizeof(v) || write(fds[1], &n, sizeof(n)) != sizeof(n) ||
+            write(fds[1], &results[before], n * sizeof(results[0])) != (ssize_t)(n * sizeof(results[0]))) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    FILE *in = fdopen(fds[0], "r");
+    double v = -1;
+    int n = 0;
+    if (!in || fread(&v, sizeof(v), 1, in) != 1 || fread(&n, sizeof(n), 1, in) != 1) {
+        v = -1;
+        n = 0;
+    }
+    for (int i = 0; i < n && result_count < BENCH_MAX_RESULTS; i++) {
+        if (fread(&results[result_count], sizeof(results[0]), 1, in) != 1) break;
+        result_count++;
+    }
+    if (in) fclose(in);
+    else close(fds[0]);
+    waitpid(pid, NULL, 0);
+    return v;
+}
+
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// dir/<program>.json when BENCH_JSON=dir is set
+void bench_done(void) {
+    if (!json_dir) return;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.json", json_dir, program);
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return; }
+
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    struct utsname u;
+    if (uname(&u) < 0) snprintf(u.nodename, sizeof(u.nodename), "unknown");
+
+    fprintf(f, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"host_name\": ", date);
+    json_string(f, u.nodename);
+    fprintf(f, ",\n    \"executable\": ");
+    json_string(f, program);
+    fprintf(f, ",\n    \"num_cpus\": %ld,\n    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [\n",
+            sysconf(_SC_NPROCESSORS_ONLN));
+    for (int i = 0; i < result_count; i++) {
+        const struct BenchResult *r = &results[i];
+        fprintf(f, "    {\n      \"name\": ");
+        json_string(f, r->name);
+        fprintf(f, ",\n      \"run_type\": \"iteration\",\n      \"iterations\": %ld,\n"
+                   "      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n      \"time_unit\": \"ns\"\n    }%s\n",
+                r->iters, r->real_ns, r->cpu_ns, i + 1 < result_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+}
@@ -0,0 +1,27 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "game.h"
+
+// Shared by the bench/ programs (bench.c). bench_run() is a small
+// Google Benchmark-style loop: the iteration count grows until one run
+// takes BENCH_MIN_SEC, then BENCH_REPS runs are timed and the median is
+// kept. With BENCH_JSON=dir in the environment every result also goes
+// to dir/<program>.json in Google Benchmark's JSON layout, which
+// bench/compare.py diffs against a baseline.
+
+#define BENCH_MIN_SEC 0.1
+#define BENCH_REPS 5
+
+// run the measured operation `iters` times
+typedef void (*bench_fn)(void *arg, long iters);
+
+void   bench_init(const char *argv0);
+double bench_now(void);
+double bench_run(const char *name, bench_fn fn, void *arg);
+void   bench_report(const char *name, double ns_per_op, long iters);
+void   bench_record(const char *name, double ns, long iters);
+double bench_in_child(double (*fn)(void *arg), void *arg);
+void   bench_done(void);
+
+#endif
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Compares two sets of benchmark results (BENCH_JSON output of the
+# bench/ programs, Google Benchmark's JSON layout) and flags
+# regressions.
+# usage: bench/compare.py [-t percent] baseline current
+#   baseline, current: a directory of <program>.json files or one file
+# exits 1 if anything got slower by more than the threshold (default 10%)
+
+import json
+import os
+import sys
+
+UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path):
+    files = [path]
+    if os.path.isdir(path):
+        files = sorted(os.path.join(path, f) for f in os.listdir(path) if f.endswith(".json"))
+    results = {}
+    for f in files:
+        with open(f) as fp:
+            data = json.load(fp)
+        program = data.get("context", {}).get("executable", os.path.basename(f)[:-5])
+        for b in data.get("benchmarks", []):
+            if b.get("run_type", "iteration") != "iteration":
+                continue
+            ns = b["real_time"] * UNITS.get(b.get("time_unit", "ns"), 1.0)
+            results[(program, b["name"])] = ns
+    return results
+
+
+def fmt(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return "%.2f %s" % (ns / scale, unit)
+    return "%.2f ns" % ns
+
+
+def main(argv):
+    threshold = 10.0
+    args = argv[1:]
+    if len(args) >= 2 and args[0] == "-t":
+        threshold = float(args[1])
+        args = args[2:]
+    if len(args) != 2:
+        sys.stderr.write("usage: %s [-t percent] baseline current\n" % argv[0])
+        return 2
+
+    base, cur = load(args[0]), load(args[1])
+    if not base:
+        sys.stderr.write("%s: no results\n" % args[0])
+        return 2
+
+    regressions = 0
+    width = max(len("%s/%s" % k) for k in set(base) | set(cur))
+    print("%-*s %12s %12s %9s" % (width, "benchmark", "baseline", "current", "change"))
+    for key in sorted(set(base) | set(cur)):
+        name = "%s/%s" % key
+        if key not in cur:
+            print("%-*s %12s %12s %9s" % (width, name, fmt(base[key]), "-", "gone"))
+            continue
+        if key not in base:
+            print("%-*s %12s %12s %9s" % (width, name, "-", fmt(cur[key]), "new"))
+            continue
+        b, c = base[key], cur[key]
+        change = (c - b) / b * 100 if b > 0 else 0.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -threshold:
+            flag = "  faster"
+        print("%-*s %12s %12s %+8.1f%%%s" % (width, name, fmt(b), fmt(c), change, flag))
+
+    if regressions:
+        print("%d regression(s) over %.0f%%" % (regressions, threshold))
+        return 1
+    print("no regressions over %.0f%%" % threshold)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,157 @@
+#include "bench.h"
+
+// Microbenchmark: bitboard win/draw checks vs the old array scans.
+// usage: ./bench/engine_bench
+
+#define POSITIONS 4096
+
+/* ---------- reference: the original char-array scans ---------- */
+
+static int scan_check_win(char b[BOARD_N][BOARD_N], char sym) {
+    for (int r = 0; r < BOARD_N; r++) {
+        int ok = 1;
+        for (int c = 0; c < BOARD_N; c++) {
+            if (b[r][c] != sym) { ok = 0; break; }
+        }
+        if (ok) return 1;
+    }
+    for (int c = 0; c < BOARD_N; c++) {
+        int ok = 1;
+        for (int r = 0; r < BOARD_N; r++) {
+            if (b[r][c] != sym) { ok = 0; break; }
+        }
+        if (ok) return 1;
+    }
+    {
+        int ok = 1;
+        for (int i = 0; i < BOARD_N; i++) {
+            if (b[i][i] != sym) { ok = 0; break; }
+        }
+        if (ok) return 1;
+    }
+    {
+        int ok = 1;
+        for (int i = 0; i < BOARD_N; i++) {
+            if (b[i][BOARD_N - 1 - i] != sym) { ok = 0; break; }
+        }
+        if (ok) return 1;
+    }
+    return 0;
+}
+
+static int scan_check_draw(char b[BOARD_N][BOARD_N]) {
+    for (int r = 0; r < BOARD_N; r++) {
+        for (int c = 0; c < BOARD_N; c++) {
+            if (b[r][c] == EMPTY_CELL) return 0;
+        }
+    }
+    return 1;
+}
+
+/* ---------- fixtures ---------- */
+
+struct Position {
+    char board[BOARD_N][BOARD_N];
+    bitboard_t marks;       // marks of `sym`
+    bitboard_t occupied;
+    char sym;
+    int last;               // a cell holding `sym`
+};
+
+static struct Position pos[POSITIONS];
+static struct WinTable lines;   // classic rules: BOARD_N x BOARD_N, full line wins
+
+// random mid/late-game boards, so both early exits and full scans show up
+static void make_positions(void) {
+    const char syms[3] = { 'X', 'Y', 'Z' };
+    srand(42);
+    for (int p = 0; p < POSITIONS; p++) {
+        struct Position *q = &pos[p];
+        bb_clear(&q->marks);
+        bb_clear(&q->occupied);
+        q->sym = 'X';
+        q->last = 0;
+        int fill = 6 + rand() % (BOARD_N * BOARD_N - 5);
+        for (int cell = 0; cell < BOARD_N * BOARD_N; cell++) {
+            char ch = (rand() % (BOARD_N * BOARD_N) < fill) ? syms[rand() % 3] : EMPTY_CELL;
+            q->board[cell / BOARD_N][cell % BOARD_N] = ch;
+            if (ch != EMPTY_CELL) bb_set(&q->occupied, cell);
+            if (ch == q->sym) { bb_set(&q->marks, cell); q->last = cell; }
+        }
+    }
+}
+
+/* ---------- timed loops ---------- */
+
+static volatile long sink;
+
+static void run_scan_win(void *arg, long iters) {
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        struct Position *q = &pos[i & (POSITIONS - 1)];
+        sink += scan_check_win(q->board, q->sym);
+    }
+}
+
+static void run_bitboard_all(void *arg, long iters) {
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        struct Position *q = &pos[i & (POSITIONS - 1)];
+        sink += engine_wins(&lines, &q->marks);
+    }
+}
+
+// what check_win does on the move path
+static void run_bitboard_last(void *arg, long iters) {
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        struct Position *q = &pos[i & (POSITIONS - 1)];
+        sink += engine_wins_at(&lines, &q->marks, q->last);
+    }
+}
+
+static void run_scan_draw(void *arg, long iters) {
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        struct Position *q = &pos[i & (POSITIONS - 1)];
+        sink += scan_check_draw(q->board);
+    }
+}
+
+static void run_bitboard_draw(void *arg, long iters) {
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        struct Position *q = &pos[i & (POSITIONS - 1)];
+        sink += engine_full(&lines, &q->occupied);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    bench_init(argv[0]);
+    if (engine_build(&lines, BOARD_N, BOARD_N) < 0) return 1;
+    make_positions();
+
+    // both engines must agree before timing means anything
+    int wins = 0;
+    for (int p = 0; p < POSITIONS; p++) {
+        int a = scan_check_win(pos[p].board, pos[p].sym);
+        int b = engine_wins(&lines, &pos[p].marks);
+        if (a != b || scan_check_draw(pos[p].board) != engine_full(&lines, &pos[p].occupied)) {
+            fprintf(stderr, "mismatch at position %d\n", p);
+            return 1;
+        }
+        wins += a;
+    }
+    printf("%d x %d board, %d-in-a-row, %d win lines, %d/%d sample positions are wins\n",
+           BOARD_N, BOARD_N, BOARD_N, lines.line_count, wins, POSITIONS);
+
+    bench_run("scan check_win", run_scan_win, NULL);
+    bench_run("bitboard all lines", run_bitboard_all, NULL);
+    bench_run("bitboard last move", run_bitboard_last, NULL);
+    bench_run("scan check_draw", run_scan_draw, NULL);
+    bench_run("bitboard popcount draw", run_bitboard_draw, NULL);
+
+    bench_done();
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "bench.h"
+#include <sys/resource.h>
+
+// Microbenchmark: the order-statistic skip list behind /top, /rank and
+// /around, at server scale.
+// usage: ./bench/leaderboard_bench [players] [ops]
+
+#define CHECK_PLAYERS 2000
+
+static uint64_t rng = 88172645463325252ULL;
+
+static uint64_t next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+// a few stars, a long tail of players with a handful of wins
+static uint32_t random_wins(void) {
+    uint64_t r = next_rand();
+    return (uint32_t)((r % 1000) * (r % 1000) / 1000 + (r >> 40) % 8);
+}
+
+static int by_rank(const void *a, const void *b) {
+    const struct RankNode *x = *(struct RankNode * const *)a;
+    const struct RankNode *y = *(struct RankNode * const *)b;
+    if (x->wins != y->wins) return x->wins > y->wins ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+// rank/at must agree with a sort after random inserts and updates
+static int check(void) {
+    struct Leaderboard lb;
+    lb_init(&lb);
+    static struct RankNode *nodes[CHECK_PLAYERS];
+    char name[NAME_LEN];
+
+    for (int i = 0; i < CHECK_PLAYERS; i++) {
+        snprintf(name, sizeof(name), "p%d", i);
+        nodes[i] = lb_node_new(&lb, name, random_wins());
+        lb_insert(&lb, nodes[i]);
+    }
+    for (int i = 0; i < CHECK_PLAYERS * 4; i++) {
+        struct RankNode *n = nodes[next_rand() % CHECK_PLAYERS];
+        lb_remove(&lb, n);
+        n->wins++;
+        lb_insert(&lb, n);
+    }
+
+    static struct RankNode *sorted[CHECK_PLAYERS];
+    memcpy(sorted, nodes, sizeof(sorted));
+    qsort(sorted, CHECK_PLAYERS, sizeof(sorted[0]), by_rank);
+    for (uint32_t r = 1; r <= CHECK_PLAYERS; r++) {
+        if (lb_at(&lb, r) != sorted[r - 1] || lb_rank(&lb, sorted[r - 1]) != r) {
+            fprintf(stderr, "mismatch at rank %u\n", r);
+            return -1;
+        }
+    }
+    return lb.count == CHECK_PLAYERS && lb_at(&lb, CHECK_PLAYERS + 1) == NULL ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t players = (argc > 1) ? (uint32_t)atol(argv[1]) : 10000000;
+    long ops = (argc > 2) ? atol(argv[2]) : 2000000;
+
+    bench_init(argv[0]);
+    if (check() < 0) return 1;
+    printf("%u players, rank/at checked against a sort of %d\n", players, CHECK_PLAYERS);
+
+    struct RankNode **nodes = malloc((size_t)players * sizeof(*nodes));
+    if (!nodes) { perror("malloc"); return 1; }
+    char name[NAME_LEN];
+    double t0, t1;
+
+    // what a server start does with a compacted (rank-ordered) scores.db
+    struct Leaderboard sorted;
+    lb_init(&sorted);
+    t0 = bench_now();
+    for (uint32_t i = 0; i < players; i++) {
+        snprintf(name, sizeof(name), "p%u", i);
+        lb_insert(&sorted, lb_node_new(&sorted, name, players - i));
+    }
+    t1 = bench_now();
+    printf("%-28s %8.2f s (%.0f ns/player)\n", "load, rank order", t1 - t0, (t1 - t0) * 1e9 / players);
+    bench_record("load, rank order", (t1 - t0) * 1e9 / players, players);
+
+    // players arriving in no particular order
+    struct Leaderboard lb;
+    lb_init(&lb);
+    t0 = bench_now();
+    for (uint32_t i = 0; i < players; i++) {
+        snprintf(name, sizeof(name), "p%u", i);
+        nodes[i] = lb_node_new(&lb, name, random_wins());
+        lb_insert(&lb, nodes[i]);
+    }
+    t1 = bench_now();
+    printf("%-28s %8.2f s (%.0f ns/player)\n", "load, random order", t1 - t0, (t1 - t0) * 1e9 / players);
+    bench_record("load, random order", (t1 - t0) * 1e9 / players, players);
+
+    volatile uint64_t sink = 0;
+
+    t0 = bench_now();
+    for (long i = 0; i < ops; i++) {
+        struct RankNode *n = nodes[next_rand() % players];
+        lb_remove(&lb, n);
+        n->wins++;
+        lb_insert(&lb, n);
+    }
+    t1 = bench_now();
+    bench_report("win (re-rank)", (t1 - t0) * 1e9 / ops, ops);
+
+    t0 = bench_now();
+    for (long i = 0; i < ops; i++) sink += lb_rank(&lb, nodes[next_rand() % players]);
+    t1 = bench_now();
+    bench_report("rank of a player", (t1 - t0) * 1e9 / ops, ops);
+
+    t0 = bench_now();
+    for (long i = 0; i < ops; i++) sink += lb_at(&lb, (uint32_t)(next_rand() % players) + 1)->wins;
+    t1 = bench_now();
+    bench_report("player at a rank", (t1 - t0) * 1e9 / ops, ops);
+
+    long queries = ops / 100;
+    t0 = bench_now();
+    for (long i = 0; i < queries; i++) {
+        struct RankNode *n = lb_at(&lb, 1);
+        for (int k = 0; n && k < RANK_TOP_MAX; k++, n = n->link[0].next) sink += n->wins;
+    }
+    t1 = bench_now();
+    bench_report("top 100", (t1 - t0) * 1e9 / queries, queries);
+
+    t0 = bench_now();
+    for (long i = 0; i < queries; i++) {
+        uint32_t r = lb_rank(&lb, nodes[next_rand() % players]);
+        struct RankNode *n = lb_at(&lb, r > RANK_AROUND ? r - RANK_AROUND : 1);
+        for (int k = 0; n && k < 2 * RANK_AROUND + 1; k++, n = n->link[0].next) sink += n->wins;
+    }
+    t1 = bench_now();
+    bench_report("around a player (+-5)", (t1 - t0) * 1e9 / queries, queries);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("%-28s %8.0f bytes/player (both lists)\n", "max rss", ru.ru_maxrss * 1024.0 / (2.0 * players));
+
+    (void)sink;
+    bench_done();
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "bench.h"
+
+// Microbenchmark: what log_message() and log_event() cost the game
+// threads, with the logger thread draining the ring into game.log.
+// Each case runs in its own process (the ring is set up once):
+//   drop: the server default, a full ring discards (the producer's cost)
+//   block: a full ring waits for the logger (what the file keeps up with)
+//   4 threads: producers contending for the ring
+// usage: ./bench/logger_bench
+
+#define BENCH_THREADS 4
+
+struct Game *gameData;
+
+struct Case {
+    const char *name;
+    enum LogFullPolicy policy;
+    bool event;                 // log_event() instead of log_message()
+    int threads;
+};
+
+static const struct Case *cur;
+
+static void produce(long iters) {
+    char msg[] = "Room 12: Player 2 placed X at row 3, col 1"; // a typical line
+    for (long i = 0; i < iters; i++) {
+        if (cur->event) log_event(LOG_MOVE, (int)(i & 1023), 1, 'X', (uint16_t)i);
+        else log_message(msg);
+    }
+}
+
+static void *producer(void *arg) {
+    produce((long)(intptr_t)arg);
+    return NULL;
+}
+
+static void run_case(void *arg, long iters) {
+    (void)arg;
+    if (cur->threads <= 1) {
+        produce(iters);
+        return;
+    }
+    pthread_t t[BENCH_THREADS];
+    for (int i = 0; i < cur->threads; i++) {
+        pthread_create(&t[i], NULL, producer, (void *)(intptr_t)(iters / cur->threads));
+    }
+    for (int i = 0; i < cur->threads; i++) pthread_join(t[i], NULL);
+}
+
+static double one_case(void *arg) {
+    cur = arg;
+    gameData = mmap(NULL, sizeof(struct Game), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (gameData == MAP_FAILED) { perror("mmap"); exit(1); }
+    gameData->game_active = true;
+    logger_init(LOG_QUEUE_DEFAULT, cur->policy);
+
+    // its startup line would land in the middle of the table
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    pthread_t logger;
+    pthread_create(&logger, NULL, logger_thread, NULL);
+    usleep(10000);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(null);
+    close(saved);
+
+    double ns = bench_run(cur->name, run_case, NULL);
+
+    gameData->game_active = false;
+    logger_wake();
+    pthread_join(logger, NULL);
+
+    struct LogStats ls;
+    logger_stats(&ls);
+    printf("  %.1f%% of the records dropped, ring high water %llu/%llu\n",
+           100.0 * ls.dropped / (ls.written + ls.dropped), ls.high_water, ls.capacity);
+    unlink("game.log");
+    return ns;
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    bench_init(argv[0]);
+
+    char dir[] = "/tmp/logger_benchXXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) { perror("mkdtemp"); return 1; }
+
+    static const struct Case cases[] = {
+        { "log_message, drop",            LOG_FULL_DROP,  false, 1 },
+        { "log_event, drop",              LOG_FULL_DROP,  true,  1 },
+        { "log_message, block",           LOG_FULL_BLOCK, false, 1 },
+        { "log_event, block",             LOG_FULL_BLOCK, true,  1 },
+        { "log_message, drop, 4 threads", LOG_FULL_DROP,  false, BENCH_THREADS },
+        { "log_message, block, 4 threads", LOG_FULL_BLOCK, false, BENCH_THREADS },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) bench_in_child(one_case, (void *)&cases[i]);
+
+    if (chdir("/") == 0) rmdir(dir);
+    bench_done();
+    return 0;
+}
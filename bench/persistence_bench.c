@@ -0,0 +1,92 @@
+#include "bench.h"
+
+// Microbenchmark: scores.db, with the score writer thread running as in
+// the server.
+//   record_win: what the move path pays for a win (memory only, the
+//     writer group-commits it within SCORE_FLUSH_MS); a new player is
+//     also a table insert. `players` new ones, so the file sizes below
+//     don't depend on how many iterations the timed loops picked
+//   save_scores: the shutdown path, last commit + compaction of
+//     2 x players
+//   load_scores: a server start replaying the compacted file
+// usage: ./bench/persistence_bench [players]
+
+struct Game *gameData;
+
+static unsigned players;
+
+static uint64_t rng = 88172645463325252ULL;
+
+static uint64_t next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static void run_win_existing(void *arg, long iters) {
+    (void)arg;
+    char name[NAME_LEN];
+    for (long i = 0; i < iters; i++) {
+        snprintf(name, sizeof(name), "p%u", (unsigned)(next_rand() % players));
+        record_win(name);
+    }
+}
+
+// the name formatting alone, to subtract by eye
+static void run_names(void *arg, long iters) {
+    (void)arg;
+    char name[NAME_LEN];
+    volatile char sink = 0;
+    for (long i = 0; i < iters; i++) {
+        snprintf(name, sizeof(name), "p%u", (unsigned)(next_rand() % players));
+        sink += name[1];
+    }
+    (void)sink;
+}
+
+// a restart, in a process of its own
+static double timed_load(void *arg) {
+    (void)arg;
+    double t0 = bench_now();
+    load_scores();
+    return bench_now() - t0;
+}
+
+int main(int argc, char *argv[]) {
+    bench_init(argv[0]);
+    players = (argc > 1) ? (unsigned)atol(argv[1]) : 100000;
+    if (players < 1) players = 1;
+
+    char dir[] = "/tmp/persistence_benchXXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) { perror("mkdtemp"); return 1; }
+
+    load_scores();
+    char name[NAME_LEN];
+    for (unsigned i = 0; i < players; i++) {
+        snprintf(name, sizeof(name), "p%u", i);
+        record_win(name);
+    }
+    printf("%u players\n", players);
+
+    bench_run("format a name", run_names, NULL);
+    bench_run("record_win, existing player", run_win_existing, NULL);
+
+    double t0 = bench_now();
+    for (unsigned i = 0; i < players; i++) {
+        snprintf(name, sizeof(name), "new%u", i);
+        record_win(name);
+    }
+    bench_report("record_win, new player", (bench_now() - t0) * 1e9 / players, players);
+
+    t0 = bench_now();
+    save_scores();
+    bench_report("save_scores", (bench_now() - t0) * 1e9, 1);
+    bench_report("load_scores", bench_in_child(timed_load, NULL) * 1e9, 1);
+
+    unlink("scores.db");
+    unlink("scores.db.tmp");
+    if (chdir("/") == 0) rmdir(dir);
+    bench_done();
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "bench.h"
+
+// Recovery time against the number of games in progress. Each phase
+// runs in its own process, like a server restart:
+//   1. journal G games, 3 seats and 8 moves each, then die without a snapshot
+//   2. recover from the journal alone (this writes a snapshot)
+//   3. recover from that snapshot alone
+// usage: ./bench/recovery_bench [games...]
+
+#define BENCH_MOVES 8
+
+struct Game *gameData;
+
+static void setup(void) {
+    gameData = mmap(NULL, sizeof(struct Game), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (gameData == MAP_FAILED) { perror("mmap"); exit(1); }
+    pthread_mutex_init(&gameData->lobby_mutex, NULL);
+    if (rules_enable("classic") < 0) exit(1);
+    timer_init();
+    rooms_init(SEAT_GRACE_MS_DEFAULT);
+}
+
+// wal_recover() prints a line of its own, keep the table readable
+static double timed_recover(void) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+
+    double t0 = bench_now();
+    wal_recover();
+    double t = bench_now() - t0;
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(null);
+    close(saved);
+    return t;
+}
+
+// what the server journals for a table that filled up and played a bit
+static void journal_games(int games) {
+    const struct Rules *rules = &rule_sets[0];
+    for (int g = 0; g < games; g++) {
+        struct Room *room = &gameData->rooms[g];
+        pthread_mutex_lock(&room->board_mutex);
+        room->in_use = true;
+        for (int s = 0; s < rules->players; s++) {
+            room->player_active[s] = true;
+            room->player_token[s] = ((uint64_t)(g * 7919 + s + 1) << 16) | ((uint64_t)g << TOKEN_SEAT_BITS) | (uint64_t)s;
+            snprintf(room->player_name[s], NAME_LEN, "player%d", g * rules->players + s);
+            room->player_count++;
+            wal_seat_locked(room, s);
+        }
+        for (int s = 0; s < rules->players; s++) {
+            room->player_symbol[s] = rules->symbols[s];
+            wal_record_locked(room, WAL_SYMBOL, s, rules->symbols[s], 0);
+        }
+        wal_record_locked(room, WAL_TURN, -1, 0, 0);
+        for (int m = 0; m < BENCH_MOVES; m++) {
+            int seat = m % rules->players;
+            int cell = (m * 5) % (rules->n * rules->n); // 0 5 10 15 4 9 14 3: no line of 3
+            room->board[cell] = room->player_symbol[seat];
+            wal_record_locked(room, WAL_MOVE, seat, cell, MOVE_OK);
+            wal_record_locked(room, WAL_TURN, -1, (seat + 1) % rules->players, 0);
+        }
+        pthread_mutex_unlock(&room->board_mutex);
+    }
+    pthread_mutex_lock(&gameData->lobby_mutex);
+    gameData->room_high_water = games;
+    pthread_mutex_unlock(&gameData->lobby_mutex);
+}
+
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : 0;
+}
+
+struct Phase {
+    int games;
+    int which;
+};
+
+// one phase in a child process, the way a restarted server would see it
+// (bench_in_child() exits without wal_close(): that would snapshot).
+// returns the recovery time
+static double phase(void *arg) {
+    const struct Phase *ph = arg;
+    int games = ph->games, which = ph->which;
+    double t = 0;
+
+    setup();
+    if (which == 1) {
+        timed_recover(); // empty directory: just starts the journal
+        journal_games(games);
+        wal_sync();
+        printf("%8d %12ld", games, file_size("game.wal"));
+    } else {
+        t = timed_recover();
+        int live = 0;
+        for (int i = 0; i < games; i++) live += gameData->rooms[i].in_use;
+        if (live != games) printf(" (%d games lost!)", games - live);
+        if (which == 2) printf(" %12.1f %12ld", t * 1000, file_size("game.snap"));
+        else printf(" %12.1f\n", t * 1000);
+    }
+    return t;
+}
+
+int main(int argc, char *argv[]) {
+    bench_init(argv[0]);
+    int defaults[] = { 100, 1000, 5000, MAX_ROOMS };
+    int count = argc > 1 ? argc - 1 : (int)(sizeof(defaults) / sizeof(defaults[0]));
+
+    char dir[] = "/tmp/recovery_benchXXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) { perror("mkdtemp"); return 1; }
+
+    printf("%8s %12s %12s %12s %12s\n", "games", "journal B", "replay ms", "snapshot B", "snapshot ms");
+    for (int i = 0; i < count; i++) {
+        int games = argc > 1 ? atoi(argv[i + 1]) : defaults[i];
+        if (games < 1 || games > MAX_ROOMS) continue;
+        unlink("game.wal");
+        unlink("game.snap");
+        for (int p = 1; p <= 3; p++) {
+            struct Phase ph = { games, p };
+            double t = bench_in_child(phase, &ph);
+            char name[64];
+            snprintf(name, sizeof(name), p == 2 ? "replay %d games" : "snapshot %d games", games);
+            if (p > 1) bench_record(name, t * 1e9, 1);
+        }
+    }
+
+    unlink("game.wal");
+    unlink("game.snap");
+    if (chdir("/") == 0) rmdir(dir);
+    bench_done();
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "bench.h"
+
+// Microbenchmark: building what the players see, per rule set.
+//   compact: build_board_string(), the one-line board
+//   screen: the full screen (labels + board) from the template, what a
+//     reset costs; board: the same without the labels block
+//   move in place / move, copy: patching the cached screens after a
+//     move, with nobody / somebody still holding the old frames
+//   binary snapshot, delta: the binary protocol's P_BOARD and P_DELTA
+// usage: ./bench/render_bench
+
+struct Game *gameData;
+
+static struct Room room;
+static volatile long sink;
+
+// about half the cells taken, the way a board looks mid-game
+static void setup_room(const struct Rules *rules) {
+    render_reset_locked(&room);
+    memset(&room, 0, sizeof(room));
+    room.rules = rules;
+    room.current_turn_id = 0;
+    room.last_cell = -1;
+    int cells = rules->n * rules->n;
+    srand(42);
+    for (int i = 0; i < cells; i++) {
+        room.board[i] = (rand() % 2) ? rules->symbols[rand() % rules->players] : EMPTY_CELL;
+    }
+}
+
+static void run_compact(void *arg, long iters) {
+    (void)arg;
+    char out[4096];
+    for (long i = 0; i < iters; i++) {
+        build_board_string(&room, out, sizeof(out));
+        sink += out[0];
+    }
+}
+
+static void run_screen(void *arg, long iters) {
+    bool labels = arg != NULL;
+    for (long i = 0; i < iters; i++) {
+        render_reset_locked(&room);
+        sink += render_frame_locked(&room, labels)->len;
+    }
+}
+
+// every cached frame exists, as after a broadcast
+static void warm_frames(void) {
+    render_frame_locked(&room, true);
+    render_frame_locked(&room, false);
+    render_bin_frame_locked(&room);
+}
+
+static void run_move(void *arg, long iters) {
+    bool shared = arg != NULL;
+    int cells = room.rules->n * room.rules->n;
+    warm_frames();
+    for (long i = 0; i < iters; i++) {
+        int cell = (int)(i % cells);
+        room.board[cell] = room.board[cell] == EMPTY_CELL ? room.rules->symbols[0] : EMPTY_CELL;
+        if (!shared) {
+            render_cell_locked(&room, cell);
+            continue;
+        }
+        // a recipient still holds each screen: the patch copies it
+        struct Frame *held[3] = { frame_ref(room.frame), frame_ref(room.board_frame), frame_ref(room.bin_frame) };
+        render_cell_locked(&room, cell);
+        for (int k = 0; k < 3; k++) frame_unref(held[k]);
+    }
+}
+
+static void run_bin_snapshot(void *arg, long iters) {
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        render_reset_locked(&room);
+        room.seq++;
+        sink += render_bin_frame_locked(&room)->len;
+    }
+}
+
+static void run_delta(void *arg, long iters) {
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        room.seq++;
+        room.last_cell = (int)(i % (room.rules->n * room.rules->n));
+        struct Frame *f = render_delta_locked(&room);
+        sink += f->len;
+        frame_unref(f);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    bench_init(argv[0]);
+    if (rules_enable("classic,gomoku") < 0) return 1;
+
+    for (int r = 0; r < rule_count; r++) {
+        const struct Rules *rules = &rule_sets[r];
+        printf("%s: %d x %d, screen %zu bytes\n", rules->name, rules->n, rules->n, rules->screen_len);
+        char name[64];
+
+        setup_room(rules);
+        snprintf(name, sizeof(name), "compact/%s", rules->name);
+        bench_run(name, run_compact, NULL);
+        snprintf(name, sizeof(name), "screen/%s", rules->name);
+        bench_run(name, run_screen, "labels");
+        snprintf(name, sizeof(name), "board/%s", rules->name);
+        bench_run(name, run_screen, NULL);
+
+        setup_room(rules);
+        snprintf(name, sizeof(name), "move in place/%s", rules->name);
+        bench_run(name, run_move, NULL);
+        snprintf(name, sizeof(name), "move, copy/%s", rules->name);
+        bench_run(name, run_move, "shared");
+
+        setup_room(rules);
+        snprintf(name, sizeof(name), "binary snapshot/%s", rules->name);
+        bench_run(name, run_bin_snapshot, NULL);
+        snprintf(name, sizeof(name), "delta/%s", rules->name);
+        bench_run(name, run_delta, NULL);
+    }
+
+    bench_done();
+    return 0;
+}
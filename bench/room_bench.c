@@ -0,0 +1,102 @@
+#include "bench.h"
+
+// Microbenchmark: struct Room's layout, with the whole pool in play.
+//   scan: reading in_use across the pool (watch_find, rooms_resume)
+//   move: the fields a move and its broadcast touch in one room (turn
+//     and seat checks, board cell, bitboards, win check, counters,
+//     clients and cached screens, the turn clock), without the journal
+//     and logger around them. "1 room" stays in L1; "pool" goes round
+//     all MAX_ROOMS rooms, what thousands of busy tables look like
+// usage: ./bench/room_bench
+
+struct Game *gameData;
+
+static volatile long sink;
+
+static void setup_pool(void) {
+    gameData = mmap(NULL, sizeof(struct Game), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (gameData == MAP_FAILED) { perror("mmap"); exit(1); }
+    if (rules_enable("classic") < 0) exit(1);
+
+    const struct Rules *rules = &rule_sets[0];
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        struct Room *room = &gameData->rooms[i];
+        room->id = i;
+        pthread_mutex_init(&room->board_mutex, NULL);
+        pthread_mutex_init(&room->send_mutex, NULL);
+        memset(room->board, EMPTY_CELL, sizeof(room->board));
+        room->last_cell = -1;
+        if (i % 4 == 3) continue; // a quarter of the pool free
+        room->in_use = true;
+        room->rules = rules;
+        room->player_count = rules->players;
+        room->current_turn_id = 0;
+        for (int s = 0; s < rules->players; s++) {
+            room->player_active[s] = true;
+            room->player_symbol[s] = rules->symbols[s];
+        }
+    }
+    gameData->room_high_water = MAX_ROOMS;
+}
+
+static void run_scan(void *arg, long iters) {
+    (void)arg;
+    long live = 0;
+    for (long i = 0; i < iters; i++) live += gameData->rooms[i % MAX_ROOMS].in_use;
+    sink += live;
+}
+
+// one move in `room`, the way play_move() and the broadcast see it
+static void move_in(struct Room *room, long i) {
+    pthread_mutex_lock(&room->board_mutex);
+    int seat = room->current_turn_id;
+    if (room->in_use && !room->round_over && seat >= 0 && room->player_active[seat]) {
+        const struct Rules *rules = room->rules;
+        int cells = rules->n * rules->n;
+        int cell = (int)(i % cells);
+        if (room->board[cell] != EMPTY_CELL) {
+            // a new round
+            memset(room->board, EMPTY_CELL, (size_t)cells);
+            for (int s = 0; s < MAX_PLAYERS; s++) bb_clear(&room->marks[s]);
+            bb_clear(&room->occupied);
+        }
+        room->board[cell] = room->player_symbol[seat];
+        bb_set(&room->marks[seat], cell);
+        bb_set(&room->occupied, cell);
+        room->move_gen++;
+        room->last_cell = cell;
+        room->turn_misses[seat] = 0;
+        sink += engine_wins_at(&rules->lines, &room->marks[seat], cell);
+        room->wal_seq++;
+
+        room->seq++;
+        for (int s = 0; s < rules->players; s++) sink += room->clients[s] != NULL;
+        sink += room->frame != NULL;
+        room->current_turn_id = (seat + 1) % rules->players;
+        room->turn_deadline = i;
+        sink += room->turn_timer.armed;
+    }
+    pthread_mutex_unlock(&room->board_mutex);
+}
+
+// rooms in a scrambled order, the way moves arrive from many tables (a
+// walk in id order would let the prefetcher hide the misses)
+static void run_move(void *arg, long iters) {
+    long rooms = (long)(intptr_t)arg;
+    for (long i = 0; i < iters; i++) move_in(&gameData->rooms[(i * 7919) % rooms], i / rooms);
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc;
+    bench_init(argv[0]);
+    setup_pool();
+    printf("struct Room: %zu bytes, %d rooms\n", sizeof(struct Room), MAX_ROOMS);
+
+    bench_run("scan in_use, pool", run_scan, NULL);
+    bench_run("move, 1 room", run_move, (void *)(intptr_t)1);
+    bench_run("move, pool", run_move, (void *)(intptr_t)MAX_ROOMS);
+
+    bench_done();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "bench.h"
+
+// Microbenchmark: the hierarchical timer wheel with as many timers as
+// the server keeps (a move clock per room, a handshake/idle limit per
+// connection).
+//   arm/re-arm/cancel: cost per call with N timers spread over 20 minutes
+//   fire: N timers due within 2 s, how late the scheduler runs them
+// usage: ./bench/timer_bench [timers]
+
+struct Game *gameData;
+
+struct BenchTimer {
+    struct Timer t;
+    long long due;              // now_ms it was asked for
+};
+
+static struct BenchTimer *timers;
+static long long *late;         // per fired timer, ms
+static _Atomic long fired;
+
+static uint64_t rng = 88172645463325252ULL;
+
+static uint64_t next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static void noop_cb(void *arg) {
+    (void)arg;
+}
+
+static void fire_cb(void *arg) {
+    struct BenchTimer *b = arg;
+    late[atomic_fetch_add(&fired, 1)] = now_ms() - b->due;
+}
+
+static void *run_wheel(void *arg) {
+    (void)arg;
+    timer_run();
+    return NULL;
+}
+
+static int by_value(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    bench_init(argv[0]);
+    long n = (argc > 1) ? atol(argv[1]) : 1000000;
+    if (n < 1) n = 1;
+
+    gameData = mmap(NULL, sizeof(struct Game), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (gameData == MAP_FAILED) { perror("mmap"); return 1; }
+    gameData->game_active = true;
+    timer_init();
+
+    timers = calloc((size_t)n, sizeof(*timers));
+    late = calloc((size_t)n, sizeof(*late));
+    if (!timers || !late) { perror("calloc"); return 1; }
+    printf("%ld timers\n", n);
+
+    double t0, t1;
+
+    // idle limits and move clocks: seconds to minutes out, every level busy
+    t0 = bench_now();
+    for (long i = 0; i < n; i++) timer_arm(&timers[i].t, (long long)(next_rand() % 1200000), noop_cb, NULL);
+    t1 = bench_now();
+    bench_report("arm", (t1 - t0) * 1e9 / n, n);
+
+    // a move or a deadline pushed back: unlink + relink
+    t0 = bench_now();
+    for (long i = 0; i < n; i++) timer_arm(&timers[i].t, (long long)(next_rand() % 1200000), noop_cb, NULL);
+    t1 = bench_now();
+    bench_report("re-arm", (t1 - t0) * 1e9 / n, n);
+
+    t0 = bench_now();
+    for (long i = 0; i < n; i++) timer_cancel(&timers[i].t);
+    t1 = bench_now();
+    bench_report("cancel", (t1 - t0) * 1e9 / n, n);
+
+    // everything due within 2 s, some of it past a level 0 revolution
+    pthread_t wheel_thread;
+    pthread_create(&wheel_thread, NULL, run_wheel, NULL);
+    for (long i = 0; i < n; i++) {
+        long long delay = (long long)(next_rand() % 2000);
+        timers[i].due = now_ms() + delay;
+        timer_arm(&timers[i].t, delay, fire_cb, &timers[i]);
+    }
+    while (atomic_load(&fired) < n) usleep(10000);
+
+    // let timer_run() see game_active go false
+    struct Timer stop = {0};
+    gameData->game_active = false;
+    timer_arm(&stop, 0, noop_cb, NULL);
+    pthread_join(wheel_thread, NULL);
+
+    qsort(late, (size_t)n, sizeof(*late), by_value);
+    printf("%-28s %5lld / %lld / %lld ms (p50/p99/max)\n", "fired late by",
+           late[n / 2], late[n * 99 / 100], late[n - 1]);
+    bench_record("fired late p99", late[n * 99 / 100] * 1e6, n);
+    bench_done();
+    return 0;
+}
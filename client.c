@@ -1,12 +1,320 @@
 #include "game.h"
 #include <sys/select.h>
 
-int main(int argc, char *argv[]) {
-    const char *server_ip = "127.0.0.1";
-    if (argc >= 2) server_ip = argv[1];
+/* ---------- binary protocol (-b) ---------- */
+
+static const char *status_text[] = {
+    [ST_SERVER_FULL]   = "Server full.",
+    [ST_UNKNOWN_GAME]  = "Unknown game.",
+    [ST_BAD_SYMBOL]    = "Invalid symbol.",
+    [ST_SYMBOL_TAKEN]  = "That symbol is already taken. Choose another.",
+    [ST_SYMBOL_OK]     = "Your symbol has been assigned:",
+    [ST_WAITING]       = "Waiting for game to start...",
+    [ST_ROUND_OVER]    = "Round already ended. Please wait for reset...",
+    [ST_NOT_YOUR_TURN] = "It is not your turn. Please wait...",
+    [ST_BAD_MOVE]      = "Invalid input. Please enter a grid number.",
+    [ST_CELL_TAKEN]    = "Invalid move. Spot taken.",
+    [ST_ACCEPTED]      = "Move accepted.",
+    [ST_WON]           = "You won this round!",
+    [ST_DRAW]          = "Draw! No empty spots left.",
+    [ST_BAD_TOKEN]     = "No seat is waiting for that token.",
+    [ST_TURN_SKIPPED]  = "Time is up, your turn was skipped.",
+    [ST_TIMED_OUT]     = "Timed out by the server.",
+    [ST_WATCHING]      = "Watching room",
+    [ST_NO_ROOM]       = "No game in that room.",
+    [ST_MATCHING]      = "Looking for players at your level...",
+};
+
+#define RECONNECT_TRIES 30  // one a second, inside the server's seat grace
+
+static uint64_t seat_token;         // from the join; gets the seat back after a dropped connection
+
+static bool bin_mode;               // -b
+static int bin_prompt = PROMPT_NAME; // what the next stdin line answers
+static int bin_n = BOARD_N;
+static int bin_seat = -1;
+
+// local copy of the board, kept up to date by P_DELTA
+static uint8_t bin_board[MAX_CELLS];
+static int bin_turn = 0xff;
+static uint32_t bin_seq;
+static bool bin_synced;     // have a snapshot, deltas apply
+
+static void send_frame(int sock, uint8_t type, const void *payload, size_t len) {
+    uint8_t f[PROTO_HEADER + PROTO_MAX_PAYLOAD];
+    if (len > PROTO_MAX_PAYLOAD) len = PROTO_MAX_PAYLOAD;
+    f[0] = type;
+    f[1] = (uint8_t)(len >> 8);
+    f[2] = (uint8_t)(len & 0xff);
+    if (len) memcpy(f + PROTO_HEADER, payload, len);
+    send(sock, f, PROTO_HEADER + len, 0);
+}
+
+static void print_board(void) {
+    int n = bin_n;
+
+    printf("\n");
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) {
+            uint8_t cell = bin_board[r * n + c];
+            printf(" %c", cell ? cell : '.');
+        }
+        printf("\n");
+    }
+    if (bin_turn == 0xff) return; // not started or round over
+    if (bin_turn == bin_seat) printf("YOUR TURN\nInput next grid number (1-%d): ", n * n);
+    else printf("Player %d's turn\n", bin_turn + 1);
+}
+
+static void on_snapshot(const uint8_t *p, size_t len) {
+    int n = p[0];
+    if (n * n > MAX_CELLS || len < 6 + (size_t)n * n) return;
+
+    bin_n = n;
+    bin_turn = p[1];
+    memcpy(&bin_seq, p + 2, 4);
+    bin_seq = ntohl(bin_seq);
+    memcpy(bin_board, p + 6, (size_t)n * n);
+    bin_synced = true;
+    print_board();
+}
+
+// false: missed one, the caller asks for a snapshot
+static bool on_delta(const uint8_t *p, size_t len) {
+    if (len < 7 || !bin_synced) return true;
+
+    uint32_t seq;
+    memcpy(&seq, p, 4);
+    seq = ntohl(seq);
+    if ((int32_t)(seq - bin_seq) <= 0) return true;   // already in our snapshot
+    if (seq != bin_seq + 1) {
+        bin_synced = false;
+        return false;
+    }
+
+    bin_seq = seq;
+    if (p[4] != 0xff && p[4] < bin_n * bin_n) bin_board[p[4]] = p[5];
+    bin_turn = p[6];
+    print_board();
+    return true;
+}
+
+static void on_frame(int sock, uint8_t type, const uint8_t *p, size_t len) {
+    switch (type) {
+    case P_PROMPT:
+        if (len < 1) return;
+        bin_prompt = p[0];
+        switch (bin_prompt) {
+        case PROMPT_NAME:   printf("Enter your name: "); break;
+        case PROMPT_GAME:   printf("Choose a game (%.*s): ", (int)len - 1, (const char *)p + 1); break;
+        case PROMPT_SYMBOL: printf("Choose your symbol (%.*s): ", (int)len - 1, (const char *)p + 1); break;
+        case PROMPT_MOVE:   printf("Input next grid number (1-%d): ", bin_n * bin_n); break;
+        }
+        break;
+    case P_STATUS:
+        if (len < 1) return;
+        if (p[0] < sizeof(status_text) / sizeof(status_text[0]) && status_text[p[0]]) {
+            printf("%s", status_text[p[0]]);
+            if (p[0] == ST_SYMBOL_OK && len >= 2) {
+                printf(" %c", p[1]);
+                bin_prompt = PROMPT_MOVE; // also how a resumed seat learns its symbol
+            }
+            if (p[0] == ST_TIMED_OUT) seat_token = 0; // the server let us go, don't come back
+            if (p[0] == ST_WATCHING && len >= 5) {
+                uint32_t room;
+                memcpy(&room, p + 1, 4);
+                printf(" %u.", ntohl(room));
+                bin_synced = false; // a new table, its P_BOARD is next
+            }
+            printf("\n");
+        } else {
+            printf("Status %d\n", p[0]);
+        }
+        break;
+    case P_JOINED:
+        if (len < 8) return;
+        uint32_t room;
+        memcpy(&room, p, 4);
+        bin_seat = p[4];
+        bin_n = p[5];
+        printf("Joined room %u as player %d (%dx%d, %d in a row, %d players)\n",
+               ntohl(room), bin_seat + 1, p[5], p[5], p[6], p[7]);
+        if (len >= 16) {
+            uint32_t hi, lo;
+            memcpy(&hi, p + 8, 4);
+            memcpy(&lo, p + 12, 4);
+            seat_token = ((uint64_t)ntohl(hi) << 32) | ntohl(lo);
+        }
+        break;
+    case P_BOARD:
+        if (len < 1) return;
+        on_snapshot(p, len);
+        break;
+    case P_RANKS: {
+        if (len < 4) return;
+        size_t off = 4;
+        while (off + 9 <= len && off + 9 + p[off + 8] <= len) {
+            uint32_t rank, wins;
+            memcpy(&rank, p + off, 4);
+            memcpy(&wins, p + off + 4, 4);
+            printf("#%-8u %-31.*s %u\n", ntohl(rank), p[off + 8], (const char *)p + off + 9, ntohl(wins));
+            off += 9 + p[off + 8];
+        }
+        uint32_t total;
+        memcpy(&total, p, 4);
+        printf("(%u players ranked)\n", ntohl(total));
+        break;
+    }
+    case P_DELTA:
+        bin_prompt = PROMPT_MOVE; // deltas only flow once the game is on
+        if (!on_delta(p, len)) send_frame(sock, P_RESYNC, NULL, 0);
+        break;
+    }
+}
+
+// reassemble frames; returns false once the server is unusable
+static bool on_bytes(int sock, uint8_t *buf, size_t *have, bool *hello) {
+    size_t off = 0;
+
+    // the server greets every connection in text before it sees our
+    // hello; skip that up to its own hello
+    if (!*hello) {
+        uint8_t *m = NULL;
+        for (size_t i = 0; i + PROTO_MAGIC_LEN <= *have && !m; i++) {
+            if (memcmp(buf + i, PROTO_MAGIC, PROTO_MAGIC_LEN) == 0) m = buf + i;
+        }
+        if (!m || (size_t)(m - buf) + PROTO_MAGIC_LEN + 1 > *have) {
+            if (*have == BUFFER_SIZE) *have = 0;
+            return true;
+        }
+        if (m[PROTO_MAGIC_LEN] != PROTO_VERSION) {
+            printf("Server does not speak binary protocol version %d.\n", PROTO_VERSION);
+            return false;
+        }
+        *hello = true;
+        off = (size_t)(m - buf) + PROTO_MAGIC_LEN + 1;
+    }
 
+    while (*have - off >= PROTO_HEADER) {
+        size_t len = ((size_t)buf[off + 1] << 8) | buf[off + 2];
+        if (len > PROTO_MAX_PAYLOAD) return false;
+        if (*have - off < PROTO_HEADER + len) break;
+        on_frame(sock, buf[off], buf + off + PROTO_HEADER, len);
+        off += PROTO_HEADER + len;
+    }
+    fflush(stdout);
+
+    *have -= off;
+    memmove(buf, buf + off, *have);
+    return true;
+}
+
+// "/top 20", "/rank bob", "/around" work at any prompt, "/resume <token>"
+// and "/watch [room]" at the name prompt
+static void on_query(int sock, const char *input) {
+    char cmd[16];
+    int used = 0;
+    if (sscanf(input, "/%15s %n", cmd, &used) != 1) return;
+
+    if (strcmp(cmd, "resume") == 0) {
+        unsigned long long token = strtoull(input + used, NULL, 16);
+        uint32_t t[2] = { htonl((uint32_t)(token >> 32)), htonl((uint32_t)token) };
+        send_frame(sock, P_RESUME, t, sizeof(t));
+        bin_synced = false;
+        return;
+    }
+    if (strcmp(cmd, "watch") == 0) {
+        char *end;
+        unsigned long room = strtoul(input + used, &end, 10);
+        uint32_t r = htonl(end == input + used ? 0xffffffffu : (uint32_t)room);
+        send_frame(sock, P_WATCH, &r, sizeof(r));
+        return;
+    }
+
+    uint8_t q[2 + NAME_LEN];
+    size_t len = 2;
+    q[1] = 0;
+    if (strcmp(cmd, "top") == 0) {
+        int k = atoi(input + used);
+        q[0] = QUERY_TOP;
+        q[1] = (uint8_t)(k < 0 ? 0 : k > 255 ? 255 : k);
+    } else if (strcmp(cmd, "rank") == 0 || strcmp(cmd, "around") == 0) {
+        q[0] = strcmp(cmd, "rank") == 0 ? QUERY_RANK : QUERY_AROUND;
+        size_t nl = strnlen(input + used, NAME_LEN - 1);
+        memcpy(q + 2, input + used, nl);
+        len += nl;
+    } else {
+        printf("Commands: /top [count], /rank [name], /around [name], /resume <token>, /watch [room]\n");
+        return;
+    }
+    send_frame(sock, P_QUERY, q, len);
+}
+
+static void on_input(int sock, char *input) {
+    input[strcspn(input, "\r\n")] = '\0';
+    if (input[0] == '/') {
+        on_query(sock, input);
+        return;
+    }
+
+    switch (bin_prompt) {
+    case PROMPT_NAME:   send_frame(sock, P_NAME, input, strlen(input)); break;
+    case PROMPT_GAME:   send_frame(sock, P_GAME, input, strlen(input)); break;
+    case PROMPT_SYMBOL: send_frame(sock, P_SYMBOL, input, strlen(input)); break;
+    case PROMPT_MOVE: {
+        char *end;
+        long v = strtol(input, &end, 10);
+        if (end == input || v < 1 || v > bin_n * bin_n) v = 0; // server says invalid
+        uint8_t cell = (uint8_t)(v ? v - 1 : 0xff);
+        send_frame(sock, P_MOVE, &cell, 1);
+        break;
+    }
+    }
+}
+
+static int connect_server(const struct sockaddr_in *addr) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) { perror("socket"); return 1; }
+    if (sock < 0) return -1;
+    if (connect(sock, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    if (bin_mode) {
+        char h[PROTO_MAGIC_LEN + 1];
+        memcpy(h, PROTO_MAGIC, PROTO_MAGIC_LEN);
+        h[PROTO_MAGIC_LEN] = PROTO_VERSION;
+        send(sock, h, sizeof(h), 0);
+    }
+    return sock;
+}
+
+// the connection dropped: the server holds our seat for a while, go
+// back to it with the seat token instead of a new name. -1 if we can't
+static int reconnect(const struct sockaddr_in *addr) {
+    if (!seat_token) return -1;
+    printf("\nConnection lost, reconnecting...\n");
+    fflush(stdout);
+
+    for (int i = 0; i < RECONNECT_TRIES; i++) {
+        sleep(1);
+        int sock = connect_server(addr);
+        if (sock < 0) continue;
+
+        char cmd[40];
+        snprintf(cmd, sizeof(cmd), "/resume %016llx\n", (unsigned long long)seat_token);
+        if (bin_mode) on_input(sock, cmd);
+        else send(sock, cmd, strlen(cmd), 0);
+        return sock;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *server_ip = "127.0.0.1";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0) bin_mode = true;
+        else server_ip = argv[i];
+    }
 
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
@@ -15,17 +323,20 @@ int main(int argc, char *argv[]) {
 
     if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
         perror("inet_pton");
-        close(sock);
         return 1;
     }
 
-    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    int sock = connect_server(&server_addr);
+    if (sock < 0) {
         perror("connect");
-        close(sock);
         return 1;
     }
 
     printf("Server Connected!\n");
+
+    uint8_t inbuf[BUFFER_SIZE];
+    size_t have = 0;
+    bool hello = false;
     //printf("Enter move as: row col (example: 1 2)\n\n");
 
     fd_set readfds;
@@ -43,25 +354,46 @@ int main(int argc, char *argv[]) {
         }
 
         // Receive message from server
-        if (FD_ISSET(sock, &readfds)) {
+        int bytes = 0;
+        if (FD_ISSET(sock, &readfds) && bin_mode) {
+            bytes = recv(sock, inbuf + have, sizeof(inbuf) - have, 0);
+            if (bytes > 0) {
+                have += (size_t)bytes;
+                if (!on_bytes(sock, inbuf, &have, &hello)) break;
+            }
+        } else if (FD_ISSET(sock, &readfds)) {
             char buffer[BUFFER_SIZE];
-            int bytes = recv(sock, buffer, sizeof(buffer) - 1, 0);
+            bytes = recv(sock, buffer, sizeof(buffer) - 1, 0);
+            if (bytes > 0) {
+                buffer[bytes] = '\0';
+                printf("%s", buffer);
+                fflush(stdout);
 
-            if (bytes <= 0) {
+                // "... send /resume <token>" in the join message
+                const char *t = strstr(buffer, "/resume ");
+                uint64_t token = t ? strtoull(t + 8, NULL, 16) : 0;
+                if (token) seat_token = token;
+                if (strstr(buffer, "Timed out: ")) seat_token = 0;
+            }
+        }
+        if (FD_ISSET(sock, &readfds) && bytes <= 0) {
+            close(sock);
+            have = 0;
+            hello = false;
+            sock = reconnect(&server_addr);
+            if (sock < 0) {
                 printf("\nServer disconnected. GAME OVER.\n");
-                break;
+                return 0;
             }
-
-            buffer[bytes] = '\0';
-            printf("%s", buffer);
-            fflush(stdout);
+            continue;
         }
 
         // Send user input to server
         if (FD_ISSET(STDIN_FILENO, &readfds)) {
             char input[BUFFER_SIZE];
             if (!fgets(input, sizeof(input), stdin)) break;
-            send(sock, input, strlen(input), 0);
+            if (bin_mode) on_input(sock, input);
+            else send(sock, input, strlen(input), 0);
         }
     }
 
@@ -11,9 +11,14 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/tcp.h>
 #include <string.h>
 #include <signal.h>
 #include <errno.h>
@@ -22,64 +27,631 @@
 #define BUFFER_SIZE 1024
 #define SERVER_PORT 8080
 
-#define MIN_PLAYERS 3
-#define MAX_PLAYERS 3
+#define MAX_PLAYERS 4   // seats per room; each rule set uses 2..MAX_PLAYERS
 
-#define BOARD_N 4       //4x4
+#define BOARD_N 4       //4x4, the classic rule set
 #define EMPTY_CELL '.'  
 
+// largest board any rule set may use (15x15 gomoku)
+#define MAX_BOARD_N 15
+#define MAX_CELLS (MAX_BOARD_N * MAX_BOARD_N)
+#define MAX_RULES 8
+
+// bitboards: one bit per cell, cell = row * n + col
+#define BB_WORDS ((MAX_BOARD_N * MAX_BOARD_N + 63) / 64)
+typedef struct { uint64_t w[BB_WORDS]; } bitboard_t;
+
+// precomputed k-in-a-row masks for an n x n board (engine.c)
+struct WinTable {
+    int n, k, cells;
+    int line_count;
+    bitboard_t *lines;
+    int *cell_start;    // lines through cell c: cell_lines[cell_start[c] .. cell_start[c+1])
+    int *cell_lines;
+};
+
+/* ---------- binary protocol ---------- */
+// A client that opens with PROTO_MAGIC + a version byte speaks binary
+// for the rest of the connection, anything else is the text protocol.
+// The server answers with the same 5 bytes (after the text name prompt,
+// which a binary client skips), then both sides send frames:
+//   u8 type | u16 payload length, network order | payload
+// The board goes out once as a P_BOARD snapshot (join, new round,
+// P_RESYNC), then as one P_DELTA per move/turn change. Deltas carry the
+// room's seq; a client that sees a gap asks for a fresh snapshot.
+// A spectator sends P_WATCH instead of P_NAME and gets the same
+// P_BOARD/P_DELTA stream for the room it watches.
+#define PROTO_MAGIC "TTTB"
+#define PROTO_MAGIC_LEN 4
+#define PROTO_VERSION 2
+#define PROTO_HEADER 3
+#define PROTO_MAX_PAYLOAD 512
+
+enum ProtoType {
+    // client -> server
+    P_NAME   = 0x01,    // name bytes
+    P_GAME   = 0x02,    // rule set name
+    P_SYMBOL = 0x03,    // 1 byte
+    P_MOVE   = 0x04,    // 1 byte, 0-based cell
+    P_RESYNC = 0x05,    // empty, asks for a P_BOARD
+    P_QUERY  = 0x06,    // u8 enum QueryKind, u8 count (top), name (rank/around, empty = own)
+    P_RESUME = 0x07,    // u64 seat token, instead of P_NAME: back to a held seat (dropped connection, restart)
+    P_WATCH  = 0x08,    // u32 room (0xffffffff: any table in play), instead of P_NAME: spectate
+    // server -> client
+    P_PROMPT = 0x81,    // u8 enum ProtoPrompt, then choices ("classic/gomoku", "XYZ")
+    P_STATUS = 0x82,    // u8 enum ProtoStatus, then status-specific bytes
+    P_JOINED = 0x83,    // u32 room, u8 seat, u8 n, u8 k, u8 players, u64 seat token
+    P_BOARD  = 0x84,    // u8 n, u8 seat to move (0xff: none), u32 seq, n*n cells (0 = empty, else symbol)
+    P_DELTA  = 0x85,    // u32 seq, u8 cell (0xff: none), u8 symbol, u8 seat to move (0xff: none)
+    P_RANKS  = 0x86     // u32 players ranked, then rows: u32 rank, u32 wins, u8 len, name
+};
+
+enum QueryKind { QUERY_TOP = 1, QUERY_RANK, QUERY_AROUND };
+
+enum ProtoPrompt { PROMPT_NAME = 1, PROMPT_GAME, PROMPT_SYMBOL, PROMPT_MOVE };
+
+enum ProtoStatus {
+    ST_SERVER_FULL = 1,
+    ST_UNKNOWN_GAME,
+    ST_BAD_SYMBOL,
+    ST_SYMBOL_TAKEN,
+    ST_SYMBOL_OK,       // + u8 symbol
+    ST_WAITING,
+    ST_ROUND_OVER,
+    ST_NOT_YOUR_TURN,
+    ST_BAD_MOVE,
+    ST_CELL_TAKEN,
+    ST_ACCEPTED,
+    ST_WON,
+    ST_DRAW,
+    ST_BAD_TOKEN,       // P_RESUME: no seat is waiting for that token
+    ST_TURN_SKIPPED,    // the move clock ran out, play went on
+    ST_TIMED_OUT,       // connection closed: handshake/idle limit, or the seat was forfeited
+    ST_WATCHING,        // + u32 room; P_BOARD and P_DELTAs of that room follow
+    ST_NO_ROOM,         // P_WATCH: no game in that room
+    ST_MATCHING         // queued for a table; a symbol sent now is kept for it
+};
+
+// A rule set: board size, win length and player count, with the
+// win-line table and board renderer built once at startup (rules.c)
+struct Rules {
+    const char *name;
+    int n;                      // board is n x n
+    int k;                      // marks in a row to win
+    int players;                // seats needed to start
+    char symbols[MAX_PLAYERS + 1];  // "XYZ" for 3 players
+    char symbol_prompt[64];     // "Choose your symbol (X/Y/Z): "
+
+    struct WinTable lines;
+
+    // full screen (labels + board) with every cell as EMPTY_CELL;
+    // rendering copies it and patches screen[cell_offset[i]]. The first
+    // labels_len bytes are the GRID LABELS block, sent once per client
+    char *screen;
+    size_t screen_len;
+    size_t labels_len;
+    int *cell_offset;
+
+    // status lines sent after the screen, prebuilt so a broadcast formats nothing
+    char turn_suffix[80];       // ">>> YOUR TURN! <<<\nInput next grid number (1-16): "
+    size_t turn_suffix_len;
+    char wait_suffix[64];
+    size_t wait_suffix_len;
+
+    // compact board (build_board_string), same patching scheme
+    char *compact;
+    size_t compact_len;
+    int *compact_offset;
+};
+
+// Opening book for the classic rules, written by ./solver (book.c).
+// Position key: 2 bits per cell, cell i at bits 2i; 0 = empty,
+// 1..3 = the seat that moves 1st/2nd/3rd. Outcome: 0 draw, 1..3 winner.
+#define BOOK_MAGIC "TTTBOOK1"
+#define BOOK_DRAW 0
+#define BOOK_SLOT(key, outcome) (((uint64_t)(key) << 32) | (uint64_t)((outcome) + 1))
+
+struct BookHeader {
+    char magic[8];
+    uint32_t n, k, players;
+    uint32_t plies;             // positions with up to this many marks
+    uint32_t slots_log2;        // then 1 << slots_log2 uint64 slots
+    uint32_t count;
+};
+
+// AI seats (ai.c)
+#define AI_WORKERS_DEFAULT 2
+#define AI_MOVE_MS_DEFAULT 300      // search budget per AI move
+#define AI_FILL_MS_DEFAULT 10000    // how long a table waits for humans before the AI sits down
+
+// Timeouts, all on the timer wheel (timer.c). A turn not played in time
+// is skipped, TURN_MISSES_FORFEIT in a row give up the seat
+#define TURN_MS_DEFAULT 30000       // -m
+#define TURN_MISSES_FORFEIT 2
+#define HANDSHAKE_MS_DEFAULT 30000  // -H, connect until seated
+#define IDLE_MS_DEFAULT 600000      // -I, seated and nothing received
+
+// room pool: every room is one independent table
+#define MAX_ROOMS 10240
+
+// Matchmaking (match.c): players wait in queues by rule set and rating
+// bucket, and the matchmaker thread deals full tables of players at the
+// same level. The rating is the wins in scores.db on a log scale:
+// bucket b >= 1 holds 2^(b-1) .. 2^b - 1 wins, the last one the rest
+#define MATCH_BUCKETS 8
+#define MATCH_WIDEN_MS 1000         // a waiting player accepts one bucket further per second
+#define MATCH_WAIT_MS_DEFAULT 3000  // then any open table of the rule set, AI seats included (-k)
+#define MATCH_BATCH 64              // tables seated per lobby lock
+
+// Spectators (watch.c): each room publishes its board once into a
+// WatchChannel, fan-out threads copy it to the watchers
+#define WATCH_RING 64               // deltas a fan-out thread may fall behind before it takes the snapshot
+#define WATCH_THREADS_DEFAULT 1     // -w
+#define NAME_LEN 32
+
+// Leaderboard: order-statistic skip list by wins (leaderboard.c)
+#define LB_MAX_LEVEL 32
+#define RANK_TOP_DEFAULT 10     // /top with no count
+#define RANK_TOP_MAX 100
+#define RANK_AROUND 5           // /around: players shown either side
+
+struct RankNode {
+    uint32_t wins;
+    uint8_t level;
+    bool dirty;                     // changed since the last scores.db commit
+    char name[NAME_LEN];
+    struct RankLink {
+        struct RankNode *next;
+        uint32_t span;              // nodes `next` jumps over, counting itself
+    } link[];
+};
+
+struct Leaderboard {
+    struct RankNode *head;
+    int level;
+    uint32_t count;
+    uint64_t rng;
+    // last node per level, kept while every insert has been an append
+    struct RankNode *tail[LB_MAX_LEVEL];
+    uint32_t tail_rank[LB_MAX_LEVEL];
+    bool tail_ok;
+};
+
+// one row of a ranked query
+struct RankEntry {
+    uint32_t rank;                  // 1 = most wins
+    uint32_t wins;
+    char name[NAME_LEN];
+};
+
+// Game journal (wal.c): every change to a room is appended to game.wal,
+// game.snap holds all rooms as of the last snapshot. A restarted server
+// loads the snapshot, replays the journal on top and gives recovered
+// seats RECLAIM_MS to be taken back with their seat token
+#define WAL_SNAPSHOT_SECS 60                    // snapshot at least this often while games change
+#define WAL_SNAPSHOT_BYTES (16 * 1024 * 1024)   // or once the journal is this big
+#define RECLAIM_MS 60000
+#define SEAT_GRACE_MS_DEFAULT 30000             // a dropped player's seat is held this long (-G)
+
+enum WalType {
+    WAL_SEAT = 1,   // seat taken (human or AI), followed by a struct WalSeat
+    WAL_SYMBOL,     // a = symbol
+    WAL_TURN,       // a = seat to move, 0xff = none
+    WAL_MOVE,       // a = cell, b = enum MoveResult
+    WAL_RESET,      // board cleared for the next round
+    WAL_LEAVE       // seat freed; the last human out frees the room
+};
+
+// seat token: random high bits, then room id and seat so a resume
+// finds its room without a search
+#define TOKEN_SEAT_BITS 2
+#define TOKEN_ROOM_BITS 14
+
 //  logger.c requires these
 #define MAX_LOG_LENGTH 256
-#define MAX_QUEUE_SIZE 50
+#define LOG_QUEUE_DEFAULT 4096  // records in the log ring, rounded to a power of two
+#define LOG_FLUSH_MS 100        // longest a record waits in the ring
+#define LOG_ROTATE_BYTES_DEFAULT (64LL * 1024 * 1024)
 
-struct Game {
+// game.log on-disk format: LOG_FILE_MAGIC then records back to back,
+// each a LOG_RECORD_HEADER-byte header followed by `len` text bytes
+#define LOG_FILE_MAGIC "TTTLOG1\n"
+#define LOG_MAGIC_LEN 8
+#define LOG_RECORD_HEADER 24
+#define LOG_TEXT_MAX (MAX_LOG_LENGTH - LOG_RECORD_HEADER)
 
-    struct { // Scoring
-        char name[32];
-        int wins;
-    } scores[MAX_PLAYERS]; 
-    int total_games_played;
+enum LogType {
+    LOG_TEXT = 1,   // free text in `text`
+    LOG_MOVE = 2    // seat placed sym at arg = (row << 8) | col
+};
 
-    bool round_over;
+struct LogRecord {
+    uint64_t ts_ns;     // CLOCK_REALTIME
+    uint32_t seq;       // ring position, gaps mean overwritten records
+    int32_t  room;      // -1 = server wide
+    uint8_t  type;      // enum LogType
+    int8_t   seat;
+    char     sym;
+    uint8_t  flags;
+    uint16_t len;       // bytes of text
+    uint16_t arg;
+    char     text[LOG_TEXT_MAX];
+};
 
-    // Board (4x4)
-    char board[BOARD_N][BOARD_N];   // '.', 'X', 'Y', 'Z'
+// what log_message does when the ring is full
+enum LogFullPolicy {
+    LOG_FULL_DROP,        // discard the new record (counted)
+    LOG_FULL_BLOCK,       // wait for the logger thread
+    LOG_FULL_OVERWRITE    // evict the oldest record (counted)
+};
 
-    // Game state
-    bool game_active;
-    bool turn_complete;
-    int  current_turn_id;           // 0..MAX_PLAYERS-1
+struct LogStats {
+    unsigned long long written;
+    unsigned long long dropped;
+    unsigned long long overwritten;
+    unsigned long long high_water;  // deepest the ring has been
+    unsigned long long depth;
+    unsigned long long capacity;
+};
 
-    // Players
+// runtime metrics (metrics.c): per-thread counters and latency histograms
+#define METRICS_PORT_DEFAULT 8081
+
+enum MetricCounter {
+    MC_ACCEPTED,
+    MC_CLOSED,
+    MC_MOVES,
+    MC_MOVES_REJECTED,
+    MC_BYTES_SENT,
+    MC_SEND_BLOCKED,        // sendmsg() hit a full socket buffer
+    MC_TIMEOUTS,            // handshake/idle limit
+    MC_TABLES_MATCHED,      // full tables dealt by the matchmaker
+    MC_COUNT
+};
+
+enum MetricOp {
+    MO_ACCEPT,              // accept4 .. name prompt queued
+    MO_HANDSHAKE,           // accepted .. seated with a symbol
+    MO_MOVE,                // a move line/frame: parse, validate, place, reply
+    MO_CHECK_WIN,
+    MO_RENDER,              // building a board frame, or patching one after a move
+    MO_BROADCAST,           // a room's queued deliveries sent after unlock
+    MO_SAVE_SCORES,         // one scores.db group commit, write + fdatasync
+    MO_WATCH,               // a room's changes copied out to its spectators on one fan-out thread
+    MO_MATCH_WAIT,          // queued for a table .. seated
+    MO_COUNT
+};
+
+// timer wheel entry, embed it in whatever owns the timeout
+struct Timer {
+    struct Timer *next, *prev;      // slot list
+    long long tick;
+    int slot;                       // wheel slot while armed
+    bool armed;
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+// A rendered screen. Once handed to a recipient it is shared and never
+// written again; the owner patches it in place only while refs == 1
+// (render.c)
+struct Frame {
+    _Atomic int refs;
+    size_t len;
+    char data[];
+};
+
+// a room's board for spectators. Written only with the room locked,
+// read without any lock: the snapshot under a seqlock (odd `lock` =
+// being written), the deltas in a ring whose slots carry their seq
+struct WatchDelta {
+    _Atomic uint32_t seq;           // 0 while being written
+    uint8_t cell;                   // 0xff: none
+    uint8_t sym;
+    uint8_t turn;                   // seat to move, 0xff: none
+    bool reset;                     // board cleared or rule set changed, take the snapshot
+};
+
+struct WatchChannel {
+    _Atomic uint32_t lock;
+    const struct Rules *rules;
+    uint32_t seq;
+    uint8_t turn;
+    char cells[MAX_CELLS];
+
+    _Atomic uint32_t head;          // seq of the newest change
+    _Atomic int watchers;           // nobody watching: publishing wakes no one
+    struct WatchDelta ring[WATCH_RING];
+};
+
+// Grouped by how often the game touches them, each group on cache lines
+// of its own: a move reads and writes the first line, then the seats'
+// connections and cached screens (the broadcast), the bitboards, one
+// board cell and the turn clock; joins, resets and the other timers the
+// cold part. The two mutexes share a line neither with each other nor
+// with the state they guard, and the spectators' channel, read by the
+// fan-out threads after every move, sits apart from the move path.
+// Rooms are 64-byte aligned in the pool, so a room never shares a line
+// with its neighbours either
+struct Room {
+    // hot: every move, and the pool scans (in_use)
+    _Alignas(64) bool in_use;       // at least one seat taken
+    bool round_over;
+    bool draw;
+    int  id;
+    int  current_turn_id;           // 0..MAX_PLAYERS-1
     int  player_count;
+    int  last_cell;                 // placed since the last broadcast, -1 = none
+    unsigned move_gen;              // bumped on every move/reset, stale AI answers are dropped
+    uint32_t seq;                   // bumped per P_DELTA, never reset
+    uint32_t wal_seq;               // changes journaled, never reset; replay skips what a snapshot has
+    const struct Rules *rules;      // set when the room leaves the free pool
+    long long turn_deadline;        // now_ms the current turn runs out, 0 = no clock
     bool player_active[MAX_PLAYERS];
-    int  client_sockets[MAX_PLAYERS];
+    bool player_ai[MAX_PLAYERS];         // seat played by the AI, no socket
     char player_symbol[MAX_PLAYERS];     // 'X','Y','Z'
-    char player_name[MAX_PLAYERS][32];
+    uint8_t turn_misses[MAX_PLAYERS];    // turns in a row a seat let run out
 
-    // end state flag used in your code
-    bool draw;
+    // broadcast
+    _Alignas(64) struct Conn *clients[MAX_PLAYERS]; // seat's connection (a ref), NULL for AI/empty
+    struct Frame *frame;            // cached screen of `board`, NULL = rebuild on next use
+    struct Frame *board_frame;      // same without the labels block
+    struct Frame *bin_frame;        // same for binary clients (P_BOARD)
+
+    // Board, cell = row * rules->n + col
+    _Alignas(64) bitboard_t occupied;    // all seats, used for draw checks
+    bitboard_t marks[MAX_PLAYERS];       // per seat, used for win checks
+    char board[MAX_CELLS];               // '.', 'X', 'Y', 'Z', kept for rendering
+    struct Timer turn_timer;             // the move clock of a human to move (fills the board's last line)
+
+    _Alignas(64) pthread_mutex_t board_mutex;
+    _Alignas(64) pthread_mutex_t send_mutex;    // orders outbox flushes, see room_unlock()
+
+    // cold: seat owners, held seats, the other timers
+    _Alignas(64) char player_name[MAX_PLAYERS][NAME_LEN];
+    uint64_t player_token[MAX_PLAYERS];  // lets a player take the seat back (reconnect, restart), 0 for AI
+    long long seat_deadline[MAX_PLAYERS]; // seat held for its dropped player until then (now_ms), 0 = not held
+    struct Timer reset_timer;       // round_over -> new round after 5s
+    struct Timer fill_timer;        // waiting too long for humans -> AI takes the empty seats
+    struct Timer ai_timer;          // AI queue was full, ask again
+    struct Timer reclaim_timer;     // at the first seat_deadline: held seats nobody took back are freed
+
+    _Alignas(64) struct WatchChannel watch; // the board for spectators
+};
+
+_Static_assert(offsetof(struct Room, clients) == 64, "a room's hot state is one cache line");
+
+struct Game {
+    bool game_active;               // read by every thread's loop, written once
+
+    // Lobby: open_room[r] is the table currently being filled for
+    // rule set r, free_rooms is a stack of unused room ids
+    _Alignas(64) pthread_mutex_t lobby_mutex;   // open_room, free_rooms
+    int open_room[MAX_RULES];
+    int free_top;
+    int room_high_water;            // rooms[0..room_high_water) have been used
+    int free_rooms[MAX_ROOMS];
+
+    _Alignas(64) struct Room rooms[MAX_ROOMS];
+};
+
+// per-connection handshake state, replaces the blocking recv() sequence
+enum ConnState {
+    CONN_NAME,      // waiting for player name
+    CONN_GAME,      // waiting for a rule set (only when several are enabled)
+    CONN_SYMBOL,    // waiting for X/Y/Z
+    CONN_QUEUED,    // waiting for the matchmaker, a symbol may be picked already
+    CONN_PLAYING,   // seated, sending grid numbers
+    CONN_WATCHING   // spectator, the fan-out thread sends the board
+};
+
+// a queued connection, between the matchmaker and its reactor
+enum MatchState {
+    MATCH_NONE,
+    MATCH_QUEUED,
+    MATCH_CLAIMED,      // the matchmaker is seating it
+    MATCH_SEATED,       // match_room/match_seat are set, the reactor takes them over
+    MATCH_CANCELLED     // hung up while queued, or no room left
+};
+#define MATCH_SYMBOL_CLOSED (-1)    // match_symbol once the seat is dealt
+
+// what to do when a connection's send queue is full (fanout.c)
+enum SlowPolicy {
+    SLOW_DROP,          // drop the new message
+    SLOW_COALESCE,      // replace queued boards with the newest, else drop
+    SLOW_DISCONNECT     // close the connection
+};
+
+#define OUTQ_CAP 64     // messages queued per connection
 
-    // logger queue fields required by src/logger.c
-    char log_queue[MAX_QUEUE_SIZE][MAX_LOG_LENGTH];
-    int log_head;
-    int log_tail;
+struct OutMsg {
+    struct Frame *frame;            // shared screen or copied text, ref held; may be NULL
+    const char *suffix;             // static status line, may be NULL
+    size_t suffix_len;
+    bool board;                     // a full board, a newer one supersedes it
+};
+
+// one socket, read by exactly one reactor thread; any thread may queue output
+struct Conn {
+    int fd;
+    _Atomic int refs;               // reactor + room seat + pending deliveries
+    enum ConnState state;
+    struct Room *room;              // NULL until seated
+    int seat;
+    int watch_room;                 // room spectated, -1 = none
+    char name[NAME_LEN];
+    bool binary;                    // negotiated PROTO_MAGIC at connect
+    bool seen_labels;               // text: got the GRID LABELS block once
+    size_t inlen;                   // bytes in inbuf (binary: a partial frame)
+    struct Timer timer;             // handshake/idle limit, holds a ref while armed
+    _Atomic long long deadline;     // now_ms the limit runs out, pushed back by input; 0 = none
+    long long accepted_ns;          // metrics_now() at accept, for the handshake time
+
+    // matchmaking (match.c): the matchmaker seats a queued player and
+    // hands the seat over here, the reactor adopts it on the next input
+    _Atomic int match_state;        // enum MatchState
+    _Atomic int match_symbol;       // symbol picked while queued, 0 = none
+    const struct Rules *match_rules;
+    int match_bucket;
+    long long match_since;          // metrics_now() when queued
+    struct Room *match_room;
+    int match_seat;
+    bool match_playing;             // the picked symbol was free, no prompt needed
+    char inbuf[BUFFER_SIZE];
 
-    pthread_mutex_t board_mutex;
-    pthread_mutex_t log_mutex;
+    // outgoing queue (fanout.c)
+    pthread_mutex_t out_lock;
+    bool out_closed;
+    int out_head, out_len;
+    size_t out_off;                 // bytes of the head message already sent
+    struct OutMsg outq[OUTQ_CAP];
 };
 
+enum MoveResult { MOVE_OK, MOVE_WIN, MOVE_DRAW };
+
 extern struct Game *gameData;
-extern const char* SHM_NAME;
-extern const size_t SHM_SIZE;
+extern struct Rules rule_sets[MAX_RULES];
+extern int rule_count;
 
 void log_message(char *msg);
+void log_event(uint8_t type, int room, int seat, char sym, uint16_t arg);
+void logger_init(size_t capacity, enum LogFullPolicy policy);
+void logger_set_rotation(long long max_bytes, int max_secs);
+void logger_wake(void);
+void logger_stats(struct LogStats *out);
 void* scheduler_thread(void* arg);
+void room_try_start_locked(struct Room *room);
+void room_move_done_locked(struct Room *room);
+void room_resume_locked(struct Room *room);
+void room_pass_turn_locked(struct Room *room);
+void turns_init(int turn_ms);
 void* logger_thread(void* arg);
-void handle_client(int client_socket, int player_id, int human_player_number);
-void signal_handler(int signo);
-void build_board_string(char *out, size_t out_sz);
-void load_scores();
-void save_scores();
+int  handle_client(struct Conn *conn, size_t len);
+void client_connected(struct Conn *conn);
+void client_disconnected(struct Conn *conn);
+void client_timeouts(int handshake_ms, int idle_ms);
+void client_seated(struct Conn *conn, struct Room *room, int seat);
+void build_board_string(struct Room *room, char *out, size_t out_sz);
+void load_scores(void);
+void save_scores(void);
+void record_win(const char *name);
+uint32_t scores_wins(const char *name);
+size_t scores_top(struct RankEntry *out, size_t k, uint32_t *total);
+size_t scores_around(const char *name, size_t radius, struct RankEntry *out, uint32_t *total);
+
+void lb_init(struct Leaderboard *lb);
+struct RankNode *lb_node_new(struct Leaderboard *lb, const char *name, uint32_t wins);
+void lb_insert(struct Leaderboard *lb, struct RankNode *x);
+void lb_remove(struct Leaderboard *lb, struct RankNode *x);
+uint32_t lb_rank(const struct Leaderboard *lb, const struct RankNode *x);
+struct RankNode *lb_at(const struct Leaderboard *lb, uint32_t rank);
+
+// room.c
+void rooms_init(int grace_ms);
+void rooms_resume(void);
+struct Room *room_join(const struct Rules *rules, struct Conn *conn, const char *name, int *out_seat);
+int  room_open_tables(const struct Rules *rules, struct Conn **conns, int tables, struct Room **out);
+struct Room *room_reclaim(uint64_t token, struct Conn *conn, int *out_seat);
+void room_leave(struct Room *room, int seat);
+bool room_drop(struct Room *room, int seat, struct Conn *conn);
+void room_forfeit_locked(struct Room *room, int seat);
+void room_reset_locked(struct Room *room);
+enum MoveResult room_place_locked(struct Room *room, int seat, int cell);
+void room_fill_ai(struct Room *room);
+
+// wal.c
+void wal_recover(void);
+void wal_sync(void);
+void wal_close(void);
+void wal_seat_locked(struct Room *room, int seat);
+void wal_record_locked(struct Room *room, enum WalType type, int seat, int a, int b);
+
+// engine.c
+void bb_clear(bitboard_t *b);
+void bb_set(bitboard_t *b, int cell);
+bool bb_test(const bitboard_t *b, int cell);
+int  bb_popcount(const bitboard_t *b);
+int  engine_build(struct WinTable *t, int n, int k);
+bool engine_wins_at(const struct WinTable *t, const bitboard_t *marks, int cell);
+bool engine_wins(const struct WinTable *t, const bitboard_t *marks);
+bool engine_full(const struct WinTable *t, const bitboard_t *occupied);
+
+// rules.c
+int  rules_enable(const char *list);
+const struct Rules *rules_find(const char *name);
+int  rules_index(const struct Rules *rules);
+
+// timer.c
+long long now_ms(void);
+void timer_init(void);
+void timer_arm(struct Timer *t, long long delay_ms, void (*fn)(void *arg), void *arg);
+bool timer_cancel(struct Timer *t);
+bool timer_pending(struct Timer *t);
+void timer_run(void);
+
+// render.c
+struct Frame *frame_new(size_t len);
+struct Frame *frame_ref(struct Frame *f);
+void frame_unref(struct Frame *f);
+struct Frame *frame_proto(uint8_t type, const void *payload, size_t len);
+struct Frame *render_board(const struct Rules *rules, const char *cells, bool labels);
+struct Frame *render_frame_locked(struct Room *room, bool labels);
+struct Frame *render_bin_frame_locked(struct Room *room);
+struct Frame *render_delta_locked(struct Room *room);
+void render_cell_locked(struct Room *room, int cell);
+void render_reset_locked(struct Room *room);
+
+// fanout.c
+void fanout_set_policy(enum SlowPolicy policy);
+void fanout_stats(unsigned long long *dropped, unsigned long long *coalesced, unsigned long long *kicked);
+struct Conn *conn_new(int fd);
+struct Conn *conn_ref(struct Conn *conn);
+void conn_unref(struct Conn *conn);
+void conn_shutdown(struct Conn *conn);
+bool conn_closed(struct Conn *conn);
+void conn_send(struct Conn *conn, struct Frame *frame, const char *suffix, size_t suffix_len, bool board);
+void conn_send_text(struct Conn *conn, const char *text, size_t len);
+void conn_flush(struct Conn *conn);
+void outbox_add(struct Conn *conn, struct Frame *frame, const char *suffix, size_t suffix_len, bool board);
+void outbox_flush(void);
+void room_unlock(struct Room *room);
+
+// book.c
+uint32_t book_canonical(uint32_t key);
+uint32_t book_hash(uint32_t key);
+bool book_better(int mover, int a, int b);
+int  book_open(const char *path);
+int  book_lookup(uint32_t key);
+int  book_plies(void);
+
+// ai.c
+void ai_init(int workers, int move_ms, int fill_ms);
+void ai_request_move_locked(struct Room *room);
+void ai_fill_later_locked(struct Room *room);
+
+// watch.c
+void watch_init(int threads);
+void watch_publish_locked(struct Room *room, bool reset);
+int  watch_find(int room_id);
+void watch_join(struct Conn *conn, int room_id);
+void watch_leave(struct Conn *conn);
+void watch_resync(struct Conn *conn);
+
+// match.c
+void match_init(int wait_ms);
+void match_enqueue(struct Conn *conn, const struct Rules *rules);
+bool match_prefer(struct Conn *conn, char sym);
+bool match_adopt(struct Conn *conn, bool wait);
+bool match_leave(struct Conn *conn);
+
+// metrics.c
+long long metrics_now(void);
+void metrics_count(enum MetricCounter c, unsigned long long n);
+void metrics_time(enum MetricOp op, long long start);
+void metrics_start(int port);
+
+// reactor.c
+int  reactor_listen(void);
+void* reactor_thread(void* arg);
 
 #endif
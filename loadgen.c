@@ -0,0 +1,605 @@
+#include "game.h"
+#include <time.h>
+#include <sys/resource.h>
+
+// Load generator: thousands of bot players on the binary protocol.
+// Each bot connects, sends its name, takes a symbol and moves whenever
+// a board or delta says it is its turn: a random empty cell, or with
+// -S the first empty one. Reports the connection setup rate, moves/sec,
+// move -> broadcast latency (a move until the bot sees its own delta)
+// and errors. Exits 1 if nothing was played or any bot ran into trouble.
+// usage: ./loadgen [-c bots] [-t threads] [-d seconds] [-r connects_per_sec]
+//                  [-w think_ms] [-g game] [-n name_prefix] [-S] [host]
+
+#define HIST_SUB 32                     // buckets per power of two, ~3% resolution
+#define HIST_BUCKETS ((64 - 4) * HIST_SUB)
+#define CONNECT_BATCH 256               // connects per loop turn when not rate limited
+
+enum BotState { BOT_IDLE, BOT_CONNECTING, BOT_JOINING, BOT_PLAYING, BOT_DEAD };
+
+struct Bot {
+    int fd;
+    enum BotState state;
+    int id;
+    uint64_t rng;
+    bool hello;                 // got the server's PROTO_MAGIC back
+    long long t_connect;        // ns
+    int seat, n;
+    int sym_try;                // symbols asked for since seated
+    char symbols[MAX_PLAYERS + 1];  // as offered
+    uint8_t board[MAX_CELLS];
+    int turn;                   // seat to move, 0xff = none
+    uint32_t seq;
+    bool synced;
+    int moved;                  // cell sent, waiting for its delta; -1 = none
+    long long t_move;           // ns the move went out
+    bool queued;                // in the think queue
+    size_t inlen;
+    uint8_t in[4096];
+};
+
+// counters are read by the main thread for the progress line
+struct Stats {
+    _Atomic unsigned long connected, seated, moves, wins, draws;
+    _Atomic unsigned long connect_failed, dropped, rejected, skipped, resyncs, protocol;
+    unsigned long setup[HIST_BUCKETS];  // connect -> symbol accepted, us
+    unsigned long latency[HIST_BUCKETS]; // move -> own delta, us
+};
+
+struct Worker {
+    pthread_t thread;
+    int epfd;
+    struct Bot *bots;
+    int count;
+    int next;                   // next bot to connect
+    long long t_start;
+    double rate;                // connects/sec for this thread, 0 = as fast as possible
+    // think queue: every bot waits the same think time, so FIFO order is due order
+    int *queue;
+    long long *due;
+    int q_head, q_len;
+    long long last_seated;      // ns
+    struct Stats st;
+};
+
+static struct sockaddr_in server_addr;
+static const char *game;
+static const char *name_prefix = "bot";
+static bool scripted;
+static long long think_ns;
+static volatile bool running = true;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint64_t next_rand(uint64_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static void count(_Atomic unsigned long *c) {
+    atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+}
+
+static unsigned long get(const _Atomic unsigned long *c) {
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+/* ---------- histogram ---------- */
+
+static int hist_index(uint64_t us) {
+    if (us < HIST_SUB) return (int)us;
+    int e = 63 - __builtin_clzll(us);
+    int idx = (e - 4) * HIST_SUB + (int)((us >> (e - 5)) & (HIST_SUB - 1));
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+// lower bound of a bucket, us
+static uint64_t hist_value(int idx) {
+    if (idx < HIST_SUB) return (uint64_t)idx;
+    int e = idx / HIST_SUB + 4;
+    return (uint64_t)(HIST_SUB + idx % HIST_SUB) << (e - 5);
+}
+
+static void hist_add(unsigned long *h, long long ns) {
+    h[hist_index(ns > 0 ? (uint64_t)ns / 1000 : 0)]++;
+}
+
+static double hist_pct(const unsigned long *h, double pct) {
+    unsigned long total = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) total += h[i];
+    if (total == 0) return 0;
+
+    unsigned long want = (unsigned long)(total * pct / 100.0);
+    if (want >= total) want = total - 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h[i];
+        if (seen > want) return hist_value(i) / 1000.0;
+    }
+    return hist_value(HIST_BUCKETS - 1) / 1000.0;
+}
+
+/* ---------- sending ---------- */
+
+static void bot_close(struct Worker *w, struct Bot *b, _Atomic unsigned long *why) {
+    if (b->state == BOT_DEAD) return;
+    if (why) count(why);
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, b->fd, NULL);
+    close(b->fd);
+    b->state = BOT_DEAD;
+}
+
+// frames are tiny: a socket that can't take one whole is a dead bot
+static bool send_frame(struct Worker *w, struct Bot *b, uint8_t type, const void *payload, size_t len) {
+    uint8_t f[PROTO_HEADER + PROTO_MAX_PAYLOAD];
+    f[0] = type;
+    f[1] = (uint8_t)(len >> 8);
+    f[2] = (uint8_t)(len & 0xff);
+    if (len) memcpy(f + PROTO_HEADER, payload, len);
+    if (send(b->fd, f, PROTO_HEADER + len, MSG_NOSIGNAL) != (ssize_t)(PROTO_HEADER + len)) {
+        bot_close(w, b, &w->st.dropped);
+        return false;
+    }
+    return true;
+}
+
+static void play(struct Worker *w, struct Bot *b) {
+    int cells = b->n * b->n, empty = 0, pick = -1;
+    for (int i = 0; i < cells; i++) if (!b->board[i]) empty++;
+    if (empty == 0) return;
+
+    int nth = scripted ? 0 : (int)(next_rand(&b->rng) % (uint64_t)empty);
+    for (int i = 0; i < cells && pick < 0; i++) {
+        if (!b->board[i] && nth-- == 0) pick = i;
+    }
+
+    uint8_t cell = (uint8_t)pick;
+    b->moved = pick;
+    b->t_move = now_ns();
+    if (send_frame(w, b, P_MOVE, &cell, 1)) count(&w->st.moves);
+}
+
+// our turn on the board we hold: move now or after the think time
+static void maybe_play(struct Worker *w, struct Bot *b) {
+    if (b->turn != b->seat || b->moved >= 0 || b->queued || !b->synced) return;
+    if (think_ns == 0) {
+        play(w, b);
+        return;
+    }
+    int slot = (w->q_head + w->q_len++) % w->count;
+    w->queue[slot] = (int)(b - w->bots);
+    w->due[slot] = now_ns() + think_ns;
+    b->queued = true;
+}
+
+static void run_queue(struct Worker *w) {
+    long long now = now_ns();
+    while (w->q_len > 0 && w->due[w->q_head] <= now) {
+        struct Bot *b = &w->bots[w->queue[w->q_head]];
+        w->q_head = (w->q_head + 1) % w->count;
+        w->q_len--;
+        b->queued = false;
+        if (b->state == BOT_PLAYING && b->turn == b->seat && b->moved < 0) play(w, b);
+    }
+}
+
+/* ---------- receiving ---------- */
+
+static void on_status(struct Worker *w, struct Bot *b, const uint8_t *p) {
+    switch (p[0]) {
+    case ST_SYMBOL_OK:
+        if (b->state != BOT_JOINING) break;
+        b->state = BOT_PLAYING;
+        count(&w->st.seated);
+        w->last_seated = now_ns();
+        hist_add(w->st.setup, w->last_seated - b->t_connect);
+        maybe_play(w, b);
+        break;
+    case ST_NOT_YOUR_TURN:
+    case ST_CELL_TAKEN:
+    case ST_BAD_MOVE:
+    case ST_ROUND_OVER:
+        count(&w->st.rejected);
+        b->moved = -1;
+        break;
+    case ST_WON:    count(&w->st.wins);  break;
+    case ST_DRAW:   count(&w->st.draws); break;
+    case ST_TURN_SKIPPED: count(&w->st.skipped); break;
+    case ST_SERVER_FULL:
+    case ST_TIMED_OUT:
+        bot_close(w, b, &w->st.dropped);
+        break;
+    }
+}
+
+static void on_snapshot(struct Worker *w, struct Bot *b, const uint8_t *p, size_t len) {
+    int n = p[0];
+    if (n * n > MAX_CELLS || len < 6 + (size_t)n * n) {
+        count(&w->st.protocol);
+        return;
+    }
+    b->n = n;
+    b->turn = p[1];
+    memcpy(&b->seq, p + 2, 4);
+    b->seq = ntohl(b->seq);
+    memcpy(b->board, p + 6, (size_t)n * n);
+    b->synced = true;
+    b->moved = -1;          // a new round, or a resync: whatever was in flight is settled
+    maybe_play(w, b);
+}
+
+static void on_delta(struct Worker *w, struct Bot *b, const uint8_t *p, size_t len) {
+    if (len < 7) {
+        count(&w->st.protocol);
+        return;
+    }
+    if (!b->synced) return;
+
+    uint32_t seq;
+    memcpy(&seq, p, 4);
+    seq = ntohl(seq);
+    if ((int32_t)(seq - b->seq) <= 0) return;
+    if (seq != b->seq + 1) {
+        count(&w->st.resyncs);
+        b->synced = false;
+        send_frame(w, b, P_RESYNC, NULL, 0);
+        return;
+    }
+
+    b->seq = seq;
+    int cell = p[4];
+    if (cell != 0xff && cell < b->n * b->n) {
+        b->board[cell] = p[5];
+        if (cell == b->moved) {
+            hist_add(w->st.latency, now_ns() - b->t_move);
+            b->moved = -1;
+        }
+    }
+    b->turn = p[6];
+    maybe_play(w, b);
+}
+
+static void on_frame(struct Worker *w, struct Bot *b, uint8_t type, const uint8_t *p, size_t len) {
+    switch (type) {
+    case P_PROMPT:
+        if (len < 1) break;
+        if (p[0] == PROMPT_GAME) {
+            // -g, else the first game offered
+            const char *g = game;
+            size_t gl = game ? strlen(game) : 0;
+            if (!g) {
+                g = (const char *)p + 1;
+                while (gl < len - 1 && g[gl] != '/') gl++;
+            }
+            send_frame(w, b, P_GAME, g, gl);
+        } else if (p[0] == PROMPT_SYMBOL) {
+            // our seat's symbol first, then the next one each time the
+            // server asks again (taken). Queued, the seat isn't known
+            // yet: bots queued together likely share a table, so by id
+            size_t sl = len - 1 < MAX_PLAYERS ? len - 1 : MAX_PLAYERS;
+            memcpy(b->symbols, p + 1, sl);
+            b->symbols[sl] = '\0';
+            if (sl > 0) {
+                int first = b->seat >= 0 ? b->seat : b->id;
+                uint8_t sym = (uint8_t)b->symbols[(size_t)(first + b->sym_try++) % sl];
+                send_frame(w, b, P_SYMBOL, &sym, 1);
+            }
+        }
+        break;
+    case P_STATUS:
+        if (len >= 1) on_status(w, b, p);
+        break;
+    case P_JOINED:
+        if (len < 8) { count(&w->st.protocol); break; }
+        b->seat = p[4];
+        b->sym_try = 0;
+        b->n = p[5];
+        break;
+    case P_BOARD:
+        if (len >= 1) on_snapshot(w, b, p, len);
+        break;
+    case P_DELTA:
+        on_delta(w, b, p, len);
+        break;
+    }
+}
+
+// the server's text greeting comes before its hello, skip up to PROTO_MAGIC
+static bool skip_greeting(struct Bot *b, size_t *off) {
+    for (size_t i = 0; i + PROTO_MAGIC_LEN < b->inlen; i++) {
+        if (memcmp(b->in + i, PROTO_MAGIC, PROTO_MAGIC_LEN) != 0) continue;
+        if (b->in[i + PROTO_MAGIC_LEN] != PROTO_VERSION) return false;
+        b->hello = true;
+        *off = i + PROTO_MAGIC_LEN + 1;
+        return true;
+    }
+    if (b->inlen == sizeof(b->in)) return false;
+    return true;
+}
+
+static void on_readable(struct Worker *w, struct Bot *b) {
+    while (b->state != BOT_DEAD) {
+        ssize_t r = recv(b->fd, b->in + b->inlen, sizeof(b->in) - b->inlen, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (r <= 0) {
+            bot_close(w, b, &w->st.dropped);
+            return;
+        }
+        b->inlen += (size_t)r;
+
+        size_t off = 0;
+        if (!b->hello && !skip_greeting(b, &off)) {
+            bot_close(w, b, &w->st.protocol);
+            return;
+        }
+        while (b->hello && b->inlen - off >= PROTO_HEADER && b->state != BOT_DEAD) {
+            size_t len = ((size_t)b->in[off + 1] << 8) | b->in[off + 2];
+            if (len > PROTO_MAX_PAYLOAD) {
+                bot_close(w, b, &w->st.protocol);
+                return;
+            }
+            if (b->inlen - off < PROTO_HEADER + len) break;
+            on_frame(w, b, b->in[off], b->in + off + PROTO_HEADER, len);
+            off += PROTO_HEADER + len;
+        }
+        if (b->hello) {
+            b->inlen -= off;
+            memmove(b->in, b->in + off, b->inlen);
+        }
+    }
+}
+
+/* ---------- connecting ---------- */
+
+static void bot_connect(struct Worker *w, struct Bot *b) {
+    b->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (b->fd < 0) {
+        b->state = BOT_DEAD;
+        count(&w->st.connect_failed);
+        return;
+    }
+    int one = 1;
+    setsockopt(b->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    b->t_connect = now_ns();
+    if (connect(b->fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        close(b->fd);
+        b->state = BOT_DEAD;
+        count(&w->st.connect_failed);
+        return;
+    }
+
+    b->state = BOT_CONNECTING;
+    b->seat = -1;
+    b->sym_try = 0;
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = b;
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, b->fd, &ev);
+}
+
+// connected: hello, then the name right behind it
+static void on_connected(struct Worker *w, struct Bot *b) {
+    int err = 0;
+    socklen_t el = sizeof(err);
+    getsockopt(b->fd, SOL_SOCKET, SO_ERROR, &err, &el);
+    if (err) {
+        bot_close(w, b, &w->st.connect_failed);
+        return;
+    }
+    count(&w->st.connected);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = b;
+    epoll_ctl(w->epfd, EPOLL_CTL_MOD, b->fd, &ev);
+
+    uint8_t h[PROTO_MAGIC_LEN + 1];
+    memcpy(h, PROTO_MAGIC, PROTO_MAGIC_LEN);
+    h[PROTO_MAGIC_LEN] = PROTO_VERSION;
+    if (send(b->fd, h, sizeof(h), MSG_NOSIGNAL) != (ssize_t)sizeof(h)) {
+        bot_close(w, b, &w->st.dropped);
+        return;
+    }
+    b->state = BOT_JOINING;
+
+    char name[NAME_LEN];
+    int nl = snprintf(name, sizeof(name), "%s%d", name_prefix, b->id);
+    send_frame(w, b, P_NAME, name, (size_t)(nl < NAME_LEN ? nl : NAME_LEN - 1));
+}
+
+// how many of this thread's bots should have connected by now
+static void ramp(struct Worker *w) {
+    int target = w->count;
+    if (w->rate > 0) {
+        double secs = (now_ns() - w->t_start) / 1e9;
+        target = (int)(secs * w->rate) + 1;
+        if (target > w->count) target = w->count;
+    }
+    for (int i = 0; w->next < target && i < CONNECT_BATCH; i++) bot_connect(w, &w->bots[w->next++]);
+}
+
+/* ---------- threads ---------- */
+
+static void *worker_thread(void *arg) {
+    struct Worker *w = arg;
+    struct epoll_event events[256];
+
+    w->t_start = now_ns();
+    while (running) {
+        ramp(w);
+
+        int timeout = 100;
+        if (w->next < w->count) timeout = 1;
+        else if (w->q_len > 0) {
+            long long wait = (w->due[w->q_head] - now_ns()) / 1000000;
+            timeout = wait < 0 ? 0 : wait > 100 ? 100 : (int)wait;
+        }
+
+        int n = epoll_wait(w->epfd, events, 256, timeout);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            struct Bot *b = events[i].data.ptr;
+            if (b->state == BOT_CONNECTING) on_connected(w, b);
+            else if (b->state != BOT_DEAD) on_readable(w, b);
+        }
+        run_queue(w);
+    }
+
+    for (int i = 0; i < w->next; i++) bot_close(w, &w->bots[i], NULL);
+    return NULL;
+}
+
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static void on_sigint(int signo) {
+    (void)signo;
+    running = false;
+}
+
+int main(int argc, char *argv[]) {
+    int bots = 3000;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int seconds = 30;
+    double rate = 0;
+    const char *host = "127.0.0.1";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) bots = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) seconds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) think_ns = atoll(argv[++i]) * 1000000LL;
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) game = argv[++i];
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) name_prefix = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0) scripted = true;
+        else if (argv[i][0] != '-') host = argv[i];
+        else {
+            fprintf(stderr, "Usage: %s [-c bots] [-t threads] [-d seconds] [-r connects_per_sec]\n"
+                            "          [-w think_ms] [-g game] [-n name_prefix] [-S] [host]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (bots < 1) bots = 1;
+    if (threads < 1) threads = 1;
+    if (threads > bots) threads = bots;
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(SERVER_PORT);
+    if (inet_pton(AF_INET, host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Bad address: %s\n", host);
+        return 1;
+    }
+    raise_fd_limit();
+    signal(SIGINT, on_sigint);
+
+    struct Bot *all = calloc((size_t)bots, sizeof(*all));
+    struct Worker *ws = calloc((size_t)threads, sizeof(*ws));
+    if (!all || !ws) { perror("calloc"); return 1; }
+
+    printf("%d bots on %d threads against %s:%d for %d s%s\n", bots, threads, host, SERVER_PORT, seconds,
+           scripted ? ", scripted moves" : "");
+
+    // bots handed out in contiguous blocks, each thread connects its own
+    long long t0 = now_ns();
+    for (int t = 0, first = 0; t < threads; t++) {
+        struct Worker *w = &ws[t];
+        w->count = bots / threads + (t < bots % threads);
+        w->bots = all + first;
+        for (int i = 0; i < w->count; i++) {
+            struct Bot *b = &w->bots[i];
+            b->id = first + i;
+            b->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(b->id + 1);
+            b->moved = -1;
+            b->turn = 0xff;
+        }
+        first += w->count;
+        w->rate = rate / threads;
+        w->queue = calloc((size_t)w->count, sizeof(*w->queue));
+        w->due = calloc((size_t)w->count, sizeof(*w->due));
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (!w->queue || !w->due || w->epfd < 0) { perror("worker"); return 1; }
+        pthread_create(&w->thread, NULL, worker_thread, w);
+    }
+
+    // one progress line a second
+    unsigned long last_moves = 0;
+    for (int s = 1; s <= seconds && running; s++) {
+        sleep(1);
+        unsigned long seated = 0, moves = 0, errors = 0;
+        for (int t = 0; t < threads; t++) {
+            struct Stats *st = &ws[t].st;
+            seated += get(&st->seated);
+            moves += get(&st->moves);
+            errors += get(&st->connect_failed) + get(&st->dropped) + get(&st->rejected) + get(&st->protocol);
+        }
+        printf("[%3ds] seated %6lu  moves/s %8lu  errors %lu\n", s, seated, moves - last_moves, errors);
+        fflush(stdout);
+        last_moves = moves;
+    }
+    running = false;
+    for (int t = 0; t < threads; t++) pthread_join(ws[t].thread, NULL);
+    double elapsed = (now_ns() - t0) / 1e9;
+
+    // merge
+    struct Stats *sum = calloc(1, sizeof(*sum));
+    if (!sum) { perror("calloc"); return 1; }
+    long long seated_at = 0;
+    for (int t = 0; t < threads; t++) {
+        struct Stats *st = &ws[t].st;
+        if (ws[t].last_seated > seated_at) seated_at = ws[t].last_seated;
+        sum->connected += get(&st->connected);
+        sum->seated += get(&st->seated);
+        sum->moves += get(&st->moves);
+        sum->wins += get(&st->wins);
+        sum->draws += get(&st->draws);
+        sum->connect_failed += get(&st->connect_failed);
+        sum->dropped += get(&st->dropped);
+        sum->rejected += get(&st->rejected);
+        sum->skipped += get(&st->skipped);
+        sum->resyncs += get(&st->resyncs);
+        sum->protocol += get(&st->protocol);
+        for (int i = 0; i < HIST_BUCKETS; i++) {
+            sum->setup[i] += st->setup[i];
+            sum->latency[i] += st->latency[i];
+        }
+    }
+
+    unsigned long seated = get(&sum->seated), moves = get(&sum->moves);
+    printf("\n");
+    if (seated) {
+        double ramp_s = (seated_at - t0) / 1e9;
+        printf("%-12s %lu of %d seated in %.2f s (%.0f/s)\n", "connections", seated, bots, ramp_s, seated / ramp_s);
+    } else {
+        printf("%-12s none of %d seated\n", "connections", bots);
+    }
+    printf("%-12s p50 %.3f  p99 %.3f  p999 %.3f ms (connect -> symbol accepted)\n", "setup",
+           hist_pct(sum->setup, 50), hist_pct(sum->setup, 99), hist_pct(sum->setup, 99.9));
+    printf("%-12s %lu in %.1f s, %.0f/s; rounds won %lu, drawn %lu\n", "moves",
+           moves, elapsed, moves / elapsed, get(&sum->wins), get(&sum->draws));
+    printf("%-12s p50 %.3f  p99 %.3f  p999 %.3f ms (move -> own delta)\n", "latency",
+           hist_pct(sum->latency, 50), hist_pct(sum->latency, 99), hist_pct(sum->latency, 99.9));
+    printf("%-12s connect %lu, dropped %lu, rejected moves %lu, protocol %lu (turns skipped %lu, resyncs %lu)\n",
+           "errors", get(&sum->connect_failed), get(&sum->dropped), get(&sum->rejected), get(&sum->protocol),
+           get(&sum->skipped), get(&sum->resyncs));
+
+    unsigned long errors = get(&sum->connect_failed) + get(&sum->dropped) + get(&sum->rejected) + get(&sum->protocol);
+    return moves == 0 || errors > 0;
+}
@@ -0,0 +1,59 @@
+#include "game.h"
+#include <time.h>
+
+// Offline decoder for the binary game.log written by src/logger.c
+// usage: ./logdump [game.log.2 game.log.1 game.log ...]
+
+static int dump_file(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) { perror(path); return 1; }
+
+    char magic[LOG_MAGIC_LEN];
+    if (fread(magic, 1, LOG_MAGIC_LEN, fp) != LOG_MAGIC_LEN ||
+        memcmp(magic, LOG_FILE_MAGIC, LOG_MAGIC_LEN) != 0) {
+        fprintf(stderr, "%s: not a game log\n", path);
+        fclose(fp);
+        return 1;
+    }
+
+    struct LogRecord rec;
+    while (fread(&rec, 1, LOG_RECORD_HEADER, fp) == LOG_RECORD_HEADER) {
+        if (rec.len > LOG_TEXT_MAX || fread(rec.text, 1, rec.len, fp) != rec.len) {
+            fprintf(stderr, "%s: truncated record\n", path);
+            break;
+        }
+
+        // timestamp
+        time_t secs = (time_t)(rec.ts_ns / 1000000000ull);
+        struct tm tm;
+        localtime_r(&secs, &tm);
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+        printf("%s.%03u  ", when, (unsigned)(rec.ts_ns / 1000000ull % 1000));
+
+        switch (rec.type) {
+        case LOG_TEXT:
+            printf("%.*s\n", (int)rec.len, rec.text);
+            break;
+        case LOG_MOVE:
+            printf("Room %d: Player %d placed %c at (%d,%d)\n",
+                   rec.room, rec.seat + 1, rec.sym, rec.arg >> 8, rec.arg & 0xff);
+            break;
+        default:
+            printf("Room %d: event %u seat %d arg %u\n",
+                   rec.room, rec.type, rec.seat, rec.arg);
+            break;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) return dump_file("game.log");
+
+    int rc = 0;
+    for (int i = 1; i < argc; i++) rc |= dump_file(argv[i]);
+    return rc;
+}
@@ -1,187 +1,214 @@
 #include "game.h"
+#include <sys/resource.h>
 
 struct Game *gameData;
-const char* SHM_NAME = "/game_shm";
-const size_t SHM_SIZE = sizeof(struct Game);
+static pthread_t logger;
 
-// kill zombie 
-void signal_handler(int signo) {
-    (void)signo;
-    while (waitpid(-1, NULL, WNOHANG) > 0) {}
-}
-
-static void init_game_locked(void) {
+static void init_game(const char *rules, int ai_workers, int ai_move_ms, int ai_fill_ms, int grace_ms, int turn_ms) {
 
+    // scores.db + its writer thread
     load_scores();
 
-    // Init board to EMPTY_CELL
-    for (int r = 0; r < BOARD_N; r++) {
-        for (int c = 0; c < BOARD_N; c++) {
-            gameData->board[r][c] = EMPTY_CELL;
-        }
-
-        gameData->draw = false;
-        gameData->round_over = false;
-    }
-
     // Game state
     gameData->game_active = true;
-    gameData->turn_complete = false;
-    gameData->current_turn_id = -1;
-
-    // required by your request + client_handler usage
-    gameData->draw = false;
-
-    // required for logger.c
-    gameData->log_head = 0;
-    gameData->log_tail = 0;
-
-    // Players
-    gameData->player_count = 0;
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        gameData->player_active[i] = false;
-        gameData->client_sockets[i] = -1;
-        gameData->player_symbol[i] = 0;
-        gameData->player_name[i][0] = '\0';
-    }
 
-    // Clear log queue (optional but clean)
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        gameData->log_queue[i][0] = '\0';
-    }
+    // rule sets: win-line masks + screen templates, built once
+    if (rules_enable(rules) < 0) exit(1);
+
+    // AI seats for tables that don't fill up
+    ai_init(ai_workers, ai_move_ms, ai_fill_ms);
+
+    // Rooms + lobby, then whatever game.snap + game.wal say was in progress
+    timer_init();
+    turns_init(turn_ms);
+    rooms_init(grace_ms);
+    wal_recover();
+    rooms_resume();
 }
 
-void shutdown_handler(int signo) {
+// Ctrl-C / kill: SIGINT and SIGTERM are blocked in every thread and
+// taken here, by sigwait(), so the shutdown runs as an ordinary thread
+// and can lock and join like any other code (a handler could interrupt
+// a thread holding the very lock it needs, or the thread it joins)
+static void *shutdown_thread(void *arg) {
+    sigset_t *signals = arg;
+    int signo;
+    while (sigwait(signals, &signo) != 0) {}
     printf("\nShutting down...\n");
-    
-    if (gameData) {
-        gameData->game_active = false; // Kill threads
-        save_scores();                 // SAVE SCORES (Requirement 7.1)
-    }
-    
-    // Clean up
-    shm_unlink(SHM_NAME);
-    exit(0);
-}
 
-int main() {
+    gameData->game_active = false; // Kill threads
+    wal_close();                   // rooms in progress, for the next start; no room changes after it
+    save_scores();                 // SAVE SCORES (Requirement 7.1)
 
-    signal(SIGCHLD, signal_handler);
-    signal(SIGINT, shutdown_handler);
+    // let the logger drain what is still in the ring
+    logger_wake();
+    pthread_join(logger, NULL);
 
-    shm_unlink(SHM_NAME);
+    struct LogStats ls;
+    logger_stats(&ls);
+    printf("Logger: %llu written, %llu dropped, %llu overwritten, high water %llu/%llu\n",
+           ls.written, ls.dropped, ls.overwritten, ls.high_water, ls.capacity);
 
-    // Shared memory create
-    int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd < 0) { perror("shm_open"); exit(1); }
+    unsigned long long dropped, coalesced, kicked;
+    fanout_stats(&dropped, &coalesced, &kicked);
+    printf("Slow clients: %llu messages dropped, %llu boards coalesced, %llu disconnected\n",
+           dropped, coalesced, kicked);
 
-    if (ftruncate(shm_fd, SHM_SIZE) < 0) { perror("ftruncate"); exit(1); }
+    exit(0);
+}
 
-    // Map shared memory
-    gameData = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+// every player is a socket in one process now, lift the fd limit
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    // reactor threads, default one per core
+    int reactors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t log_capacity = LOG_QUEUE_DEFAULT;
+    enum LogFullPolicy log_policy = LOG_FULL_DROP;
+    long long rotate_mb = LOG_ROTATE_BYTES_DEFAULT / (1024 * 1024);
+    int rotate_secs = 0;
+    const char *rules = "classic";
+    int ai_workers = AI_WORKERS_DEFAULT;
+    int ai_move_ms = AI_MOVE_MS_DEFAULT;
+    int ai_fill_ms = AI_FILL_MS_DEFAULT;
+    int grace_ms = SEAT_GRACE_MS_DEFAULT;
+    int turn_ms = TURN_MS_DEFAULT;
+    int handshake_ms = HANDSHAKE_MS_DEFAULT;
+    int idle_ms = IDLE_MS_DEFAULT;
+    int metrics_port = METRICS_PORT_DEFAULT;
+    int watch_threads = WATCH_THREADS_DEFAULT;
+    int match_wait_ms = MATCH_WAIT_MS_DEFAULT;
+    const char *book_path = NULL;
+    enum SlowPolicy slow_policy = SLOW_COALESCE;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            reactors = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            log_capacity = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char *p = argv[++i];
+            if (strcmp(p, "drop") == 0) log_policy = LOG_FULL_DROP;
+            else if (strcmp(p, "block") == 0) log_policy = LOG_FULL_BLOCK;
+            else if (strcmp(p, "overwrite") == 0) log_policy = LOG_FULL_OVERWRITE;
+            else { fprintf(stderr, "Unknown log policy: %s\n", p); return 1; }
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rotate_mb = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            rotate_secs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            rules = argv[++i];
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            ai_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+            ai_move_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-W") == 0 && i + 1 < argc) {
+            ai_fill_ms = atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "-G") == 0 && i + 1 < argc) {
+            grace_ms = atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            turn_ms = atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            handshake_ms = atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) {
+            idle_ms = atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            metrics_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            watch_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            match_wait_ms = atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            book_path = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            const char *p = argv[++i];
+            if (strcmp(p, "drop") == 0) slow_policy = SLOW_DROP;
+            else if (strcmp(p, "coalesce") == 0) slow_policy = SLOW_COALESCE;
+            else if (strcmp(p, "disconnect") == 0) slow_policy = SLOW_DISCONNECT;
+            else { fprintf(stderr, "Unknown slow client policy: %s\n", p); return 1; }
+        } else {
+            fprintf(stderr, "Usage: %s [-t reactor_threads] [-q log_queue_size] [-f drop|block|overwrite]\n"
+                            "          [-r rotate_log_mb] [-T rotate_log_seconds] [-g game[,game...]]\n"
+                            "          [-a ai_workers] [-M ai_move_ms] [-W ai_fill_wait_seconds] [-b book.bin]\n"
+                            "          [-s drop|coalesce|disconnect] [-G seat_grace_seconds]\n"
+                            "          [-m move_seconds] [-H handshake_seconds] [-I idle_seconds]\n"
+                            "          [-P metrics_port] [-w watch_threads] [-k match_wait_seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reactors < 1) reactors = 1;
+
+    // before any thread starts, so they all inherit the mask; a signal
+    // that comes in during startup waits for shutdown_thread
+    static sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    signal(SIGPIPE, SIG_IGN); // dead peers show up as send() errors instead
+    raise_fd_limit();
+
+    // Game state lives in this process only; no fork, so no shared memory
+    gameData = mmap(NULL, sizeof(struct Game), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if (gameData == MAP_FAILED) { perror("mmap"); exit(1); }
 
-    // Init mutexes (process-shared)
-    pthread_mutexattr_t attr;
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&gameData->lobby_mutex, NULL);
+    fanout_set_policy(slow_policy);
+    client_timeouts(handshake_ms, idle_ms);
+    logger_init(log_capacity, log_policy);
+    logger_set_rotation(rotate_mb * 1024 * 1024, rotate_secs);
 
-    pthread_mutex_init(&gameData->board_mutex, &attr);
-    pthread_mutex_init(&gameData->log_mutex, &attr);
+    // solved openings for the AI, from ./solver
+    if (book_path && book_open(book_path) < 0) exit(1);
 
-    // Init game data
-    pthread_mutex_lock(&gameData->board_mutex);
-    init_game_locked();
-    pthread_mutex_unlock(&gameData->board_mutex);
+    // Init game data (threads not started yet, no locking needed)
+    init_game(rules, ai_workers, ai_move_ms, ai_fill_ms, grace_ms, turn_ms);
 
-    // Start scheduler + logger threads
-    pthread_t scheduler, logger;
-    pthread_create(&scheduler, NULL, scheduler_thread, NULL);
-    pthread_create(&logger, NULL, logger_thread, NULL);
+    // tables by rating, off the reactors
+    match_init(match_wait_ms);
 
-    // Socket setup
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) { perror("socket"); exit(1); }
+    // spectator fan-out, off the players' threads
+    watch_init(watch_threads);
 
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // Prometheus text on 127.0.0.1, -P 0 turns the endpoint off
+    metrics_start(metrics_port);
 
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(SERVER_PORT);
-    addr.sin_addr.s_addr = INADDR_ANY;
+    // Start scheduler + logger threads
+    pthread_t scheduler;
+    pthread_create(&scheduler, NULL, scheduler_thread, NULL);
+    pthread_create(&logger, NULL, logger_thread, NULL);
 
-    if (bind(server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        perror("bind");
-        exit(1);
-    }
+    pthread_t stopper;
+    pthread_create(&stopper, NULL, shutdown_thread, &stop_signals);
+    pthread_detach(stopper);
 
-    if (listen(server_fd, 10) < 0) {
-        perror("listen");
-        exit(1);
+    // Socket setup: one SO_REUSEPORT listener per reactor
+    int listen_fds[reactors];
+    for (int i = 0; i < reactors; i++) {
+        listen_fds[i] = reactor_listen();
+        if (listen_fds[i] < 0) exit(1);
     }
 
-    signal(SIGCHLD, signal_handler);
-
-    printf("Server started. Waiting for players...\n");
+    printf("Server started with %d reactor thread(s). Waiting for players...\n", reactors);
 
-    // Accept loop // game start 
-    while (1) {
-        struct sockaddr_in caddr;
-        socklen_t clen = sizeof(caddr);
-        int client_fd = accept(server_fd, (struct sockaddr*)&caddr, &clen);
-
-        if (client_fd < 0) {
-            if (errno == EINTR) continue;
-            continue;
-        }
-
-        pthread_mutex_lock(&gameData->board_mutex);
-        int id = -1;
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (!gameData->player_active[i]) {
-                id = i;
-                gameData->player_active[i] = true;
-                gameData->client_sockets[i] = client_fd; // parent keeps for broadcast
-                gameData->player_count++;
-                break;
-            }
-        }
-        pthread_mutex_unlock(&gameData->board_mutex);
-
-        if (id == -1) {
-            send(client_fd, "Server full.\n", strlen("Server full.\n"), 0);
-            close(client_fd);
-            continue;
-        }
-
-        pid_t pid = fork();
-        if (pid == 0) {
-            // Child handles this client
-            close(server_fd);
-            handle_client(client_fd, id, id + 1);
-            exit(0);
-
-        } else if (pid > 0) {
-            // Parent keeps socket open for broadcast
-            printf("Client connected (ID: %d, PID: %d)\n", id + 1, pid);
-        
-        } else {
-            // fork failed
-            perror("fork");
-            close(client_fd);
-
-            pthread_mutex_lock(&gameData->board_mutex);
-            gameData->player_active[id] = false;
-            gameData->client_sockets[id] = -1;
-            gameData->player_count--;
-            pthread_mutex_unlock(&gameData->board_mutex);
-        }
+    // reactor 0 runs on the main thread
+    for (int i = 1; i < reactors; i++) {
+        pthread_t t;
+        pthread_create(&t, NULL, reactor_thread, (void*)(intptr_t)listen_fds[i]);
+        pthread_detach(t);
     }
+    reactor_thread((void*)(intptr_t)listen_fds[0]);
 
     // (Not reached normally)
-    close(server_fd);
+    for (int i = 0; i < reactors; i++) close(listen_fds[i]);
     return 0;
 }
 
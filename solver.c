@@ -0,0 +1,350 @@
+#include "game.h"
+#include <stdatomic.h>
+
+// Offline solver for the classic game: BOARD_N x BOARD_N, a full line
+// wins, three seats moving in turn. Every reachable position is valued
+// with max-n (see book_better) and stored once per symmetry class in a
+// lock-free table shared by all threads. The top SPLIT_PLY moves are cut
+// into tasks; each thread works its own deque and steals from the others
+// when it runs dry. Positions up to -p marks are written as an opening
+// book the server can mmap (./server -b book.bin).
+// usage: ./solver [-j threads] [-p book_plies] [-o book.bin] [-m table_log2] [-s]
+
+#define CELLS (BOARD_N * BOARD_N)
+#define SPLIT_PLY 4
+#define TABLE_PROBES 64
+
+static struct WinTable lines;
+static uint32_t line_mask[64];          // 2-bit masks of each win line
+static uint32_t line_pat[64][4];        // line_mask filled with seat code p
+
+static _Atomic uint64_t *table;
+static uint64_t table_mask;
+static _Atomic unsigned long long table_count;
+static _Atomic unsigned long long table_full;
+
+struct Worker {
+    pthread_t tid;
+    int id;
+    unsigned long long nodes;
+    unsigned long long steals;
+
+    // tasks[top..bottom): owner pops at bottom, thieves take from top
+    pthread_mutex_t lock;
+    uint32_t *tasks;
+    int top, bottom;
+};
+
+static struct Worker *workers;
+static int worker_count;
+
+/* ---------- board ---------- */
+
+static int marks_on(uint32_t key) {
+    return __builtin_popcount((key | (key >> 1)) & 0x55555555u);
+}
+
+static bool wins_at(uint32_t key, int code, int cell) {
+    for (int i = lines.cell_start[cell]; i < lines.cell_start[cell + 1]; i++) {
+        int l = lines.cell_lines[i];
+        if ((key & line_mask[l]) == line_pat[l][code]) return true;
+    }
+    return false;
+}
+
+static void build_lines(void) {
+    if (engine_build(&lines, BOARD_N, BOARD_N) < 0 || lines.line_count > 64) {
+        fprintf(stderr, "engine_build failed\n");
+        exit(1);
+    }
+    for (int l = 0; l < lines.line_count; l++) {
+        for (int c = 0; c < CELLS; c++) {
+            if (!bb_test(&lines.lines[l], c)) continue;
+            line_mask[l] |= 3u << (2 * c);
+            for (int p = 1; p <= 3; p++) line_pat[l][p] |= (uint32_t)p << (2 * c);
+        }
+    }
+}
+
+/* ---------- shared table ---------- */
+
+static int table_get(uint32_t canon) {
+    uint64_t i = book_hash(canon) & table_mask;
+    for (int probe = 0; probe < TABLE_PROBES; probe++) {
+        uint64_t e = atomic_load_explicit(&table[i], memory_order_relaxed);
+        if (e == 0) return -1;
+        if ((uint32_t)(e >> 32) == canon) return (int)(e & 0xff) - 1;
+        i = (i + 1) & table_mask;
+    }
+    return -1;
+}
+
+// first writer wins; two threads solving the same position agree anyway
+static void table_put(uint32_t canon, int outcome) {
+    uint64_t e = BOOK_SLOT(canon, outcome);
+    uint64_t i = book_hash(canon) & table_mask;
+    for (int probe = 0; probe < TABLE_PROBES; probe++) {
+        uint64_t expected = 0;
+        if (atomic_compare_exchange_strong_explicit(&table[i], &expected, e,
+                memory_order_relaxed, memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&table_count, 1, memory_order_relaxed);
+            return;
+        }
+        if ((uint32_t)(expected >> 32) == canon) return;
+        i = (i + 1) & table_mask;
+    }
+    atomic_fetch_add_explicit(&table_full, 1, memory_order_relaxed); // just not cached
+}
+
+/* ---------- search ---------- */
+
+static int solve(struct Worker *w, uint32_t key, int ply) {
+    w->nodes++;
+
+    uint32_t canon = book_canonical(key);
+    int v = table_get(canon);
+    if (v >= 0) return v;
+
+    int mover = ply % 3 + 1;
+    int best = -1;
+    for (int cell = 0; cell < CELLS; cell++) {
+        if ((key >> (2 * cell)) & 3) continue;
+
+        uint32_t child = key | (uint32_t)mover << (2 * cell);
+        int cv;
+        if (wins_at(child, mover, cell)) cv = mover;
+        else if (ply + 1 == CELLS) cv = BOOK_DRAW;
+        else cv = solve(w, child, ply + 1);
+
+        if (best < 0 || book_better(mover, cv, best)) best = cv;
+        if (best == mover) break; // nothing beats winning
+    }
+
+    table_put(canon, best);
+    return best;
+}
+
+// distinct non-terminal positions SPLIT_PLY moves in
+static int collect_tasks(uint32_t key, int ply, uint32_t *out, int count) {
+    if (ply == SPLIT_PLY) {
+        uint32_t canon = book_canonical(key);
+        for (int i = 0; i < count; i++) {
+            if (out[i] == canon) return count;
+        }
+        out[count++] = canon;
+        return count;
+    }
+    int mover = ply % 3 + 1;
+    for (int cell = 0; cell < CELLS; cell++) {
+        if ((key >> (2 * cell)) & 3) continue;
+        uint32_t child = key | (uint32_t)mover << (2 * cell);
+        if (wins_at(child, mover, cell)) continue;
+        count = collect_tasks(child, ply + 1, out, count);
+    }
+    return count;
+}
+
+/* ---------- work stealing ---------- */
+
+static bool pop_task(struct Worker *w, uint32_t *out) {
+    pthread_mutex_lock(&w->lock);
+    bool ok = w->bottom > w->top;
+    if (ok) *out = w->tasks[--w->bottom];
+    pthread_mutex_unlock(&w->lock);
+    return ok;
+}
+
+static bool steal_task(struct Worker *victim, uint32_t *out) {
+    pthread_mutex_lock(&victim->lock);
+    bool ok = victim->bottom > victim->top;
+    if (ok) *out = victim->tasks[victim->top++];
+    pthread_mutex_unlock(&victim->lock);
+    return ok;
+}
+
+static void *worker_main(void *arg) {
+    struct Worker *w = arg;
+    uint32_t key;
+
+    for (;;) {
+        if (pop_task(w, &key)) {
+            solve(w, key, marks_on(key));
+            continue;
+        }
+
+        // own deque is dry: take the oldest (largest) task from someone else
+        bool stole = false;
+        for (int i = 1; i < worker_count && !stole; i++) {
+            stole = steal_task(&workers[(w->id + i) % worker_count], &key);
+        }
+        if (!stole) break; // tasks never spawn more tasks, so we're done
+        w->steals++;
+        solve(w, key, marks_on(key));
+    }
+    return NULL;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Run {
+    int outcome;
+    double secs;
+    unsigned long long nodes, steals;
+};
+
+// full solve from an empty table with `threads` workers
+static struct Run solve_all(int threads, uint32_t *tasks, int task_count) {
+    memset((void *)table, 0, sizeof(uint64_t) * (table_mask + 1));
+    atomic_store(&table_count, 0);
+    atomic_store(&table_full, 0);
+
+    worker_count = threads;
+    workers = calloc((size_t)threads, sizeof(*workers));
+    if (!workers) { perror("calloc"); exit(1); }
+
+    // contiguous slices; stealing evens out the uneven subtrees
+    for (int i = 0; i < threads; i++) {
+        struct Worker *w = &workers[i];
+        w->id = i;
+        pthread_mutex_init(&w->lock, NULL);
+        w->top = (int)((long)task_count * i / threads);
+        w->bottom = (int)((long)task_count * (i + 1) / threads);
+        w->tasks = tasks;
+    }
+
+    double t0 = now_sec();
+    for (int i = 0; i < threads; i++) pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]);
+
+    struct Run run = { 0 };
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        run.nodes += workers[i].nodes;
+        run.steals += workers[i].steals;
+    }
+
+    // the top of the tree, mostly table hits now
+    struct Worker root = { 0 };
+    run.outcome = solve(&root, 0, 0);
+    run.nodes += root.nodes;
+    run.secs = now_sec() - t0;
+
+    for (int i = 0; i < threads; i++) pthread_mutex_destroy(&workers[i].lock);
+    free(workers);
+    return run;
+}
+
+/* ---------- book ---------- */
+
+static int write_book(const char *path, int plies) {
+    uint32_t count = 0;
+    for (uint64_t i = 0; i <= table_mask; i++) {
+        uint64_t e = atomic_load_explicit(&table[i], memory_order_relaxed);
+        if (e && marks_on((uint32_t)(e >> 32)) <= plies) count++;
+    }
+
+    // at most half full
+    uint32_t bits = 4;
+    while ((1ULL << bits) < 2ULL * count) bits++;
+
+    uint64_t *slots = calloc(1ULL << bits, sizeof(uint64_t));
+    if (!slots) { perror("calloc"); return -1; }
+    uint64_t mask = (1ULL << bits) - 1;
+    for (uint64_t i = 0; i <= table_mask; i++) {
+        uint64_t e = atomic_load_explicit(&table[i], memory_order_relaxed);
+        if (!e || marks_on((uint32_t)(e >> 32)) > plies) continue;
+        uint64_t j = book_hash((uint32_t)(e >> 32)) & mask;
+        while (slots[j]) j = (j + 1) & mask;
+        slots[j] = e;
+    }
+
+    struct BookHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BOOK_MAGIC, sizeof(h.magic));
+    h.n = BOARD_N;
+    h.k = BOARD_N;
+    h.players = 3;
+    h.plies = (uint32_t)plies;
+    h.slots_log2 = bits;
+    h.count = count;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) { perror(path); free(slots); return -1; }
+    int rc = 0;
+    if (fwrite(&h, sizeof(h), 1, fp) != 1 || fwrite(slots, sizeof(uint64_t), 1ULL << bits, fp) != (1ULL << bits)) {
+        perror(path);
+        rc = -1;
+    }
+    if (fclose(fp) != 0) rc = -1;
+    free(slots);
+
+    if (rc == 0) {
+        printf("Wrote %s: %u positions up to %d marks, %llu KB\n", path, count, plies,
+               (unsigned long long)((sizeof(h) + (sizeof(uint64_t) << bits)) / 1024));
+    }
+    return rc;
+}
+
+static const char *outcome_name(int v) {
+    switch (v) {
+    case 1:  return "first player wins";
+    case 2:  return "second player wins";
+    case 3:  return "third player wins";
+    default: return "draw";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int plies = 6;
+    int table_bits = 26;
+    const char *out = "book.bin";
+    bool scale = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) plies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out = argv[++i];
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) table_bits = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0) scale = true;
+        else {
+            fprintf(stderr, "Usage: %s [-j threads] [-p book_plies] [-o book.bin] [-m table_log2] [-s]\n"
+                            "  -s  solve once per thread count 1..threads and report scaling\n", argv[0]);
+            return 1;
+        }
+    }
+    if (threads < 1) threads = 1;
+    if (table_bits < 16 || table_bits > 32) table_bits = 26;
+
+    build_lines();
+
+    table_mask = (1ULL << table_bits) - 1;
+    table = calloc(table_mask + 1, sizeof(uint64_t));
+    if (!table) { perror("solver table"); return 1; }
+
+    // SPLIT_PLY moves in there are at most 16*15*14*13 boards
+    uint32_t *tasks = malloc(sizeof(uint32_t) * 16 * 15 * 14 * 13);
+    if (!tasks) { perror("malloc"); return 1; }
+    int task_count = collect_tasks(0, 0, tasks, 0);
+    printf("Solving %dx%d, %d in a row, 3 players: %d root tasks, %llu MB table\n",
+           BOARD_N, BOARD_N, BOARD_N, task_count, (unsigned long long)((table_mask + 1) * 8 >> 20));
+
+    struct Run base = { 0 }, run = { 0 };
+    for (int t = scale ? 1 : threads; t <= threads; t++) {
+        run = solve_all(t, tasks, task_count);
+        if (t == (scale ? 1 : threads)) base = run;
+
+        printf("%2d thread(s): %.2f s, %llu nodes, %.2f M positions/s, %llu steals, speedup %.2fx\n",
+               t, run.secs, run.nodes, run.nodes / run.secs / 1e6, run.steals, base.secs / run.secs);
+    }
+
+    printf("Result: %s (%llu distinct positions", outcome_name(run.outcome),
+           (unsigned long long)atomic_load(&table_count));
+    if (atomic_load(&table_full)) printf(", %llu not cached, try a bigger -m", (unsigned long long)atomic_load(&table_full));
+    printf(")\n");
+
+    return write_book(out, plies) < 0;
+}
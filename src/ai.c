@@ -0,0 +1,507 @@
+#include "game.h"
+#include <stdatomic.h>
+
+// AI seats. Search is paranoid alpha-beta: the AI maximises, every
+// other seat is assumed to play against it, which turns the 3-player
+// game into a two-sided search. Iterative deepening runs until the
+// per-move budget is spent; positions are Zobrist-hashed into one
+// transposition table shared by all workers (lock-free, key ^ data).
+// Turns are queued to a fixed worker pool, so the reactors and the
+// room locks never wait on a search.
+
+#define AI_QUEUE_CAP 1024
+#define AI_TT_BITS 20               // 1M entries, 16 MB
+#define AI_MAX_DEPTH 64
+#define AI_WIN 1000000
+#define AI_INF (AI_WIN + 1000)
+#define AI_MATE (AI_WIN - 1000)     // scores past this are forced wins/losses
+
+enum { TT_EXACT, TT_LOWER, TT_UPPER };
+
+struct TTEntry {
+    _Atomic uint64_t check;         // key ^ data, torn writes just miss
+    _Atomic uint64_t data;
+};
+
+static struct TTEntry *tt;
+static uint64_t tt_mask;
+
+// Zobrist keys
+static uint64_t z_cell[MAX_CELLS][MAX_PLAYERS];
+static uint64_t z_turn[MAX_PLAYERS];
+static uint64_t z_me[MAX_PLAYERS];
+static uint64_t z_rules[MAX_RULES];
+static uint64_t z_left[MAX_PLAYERS];   // per seat that has left: a shorter turn order is another game
+
+// per rule set: cells centre-first, and on big boards the 3x3
+// neighbourhood of each cell (only moves next to a mark are tried)
+static int *cell_order[MAX_RULES];
+static bitboard_t *near_mask[MAX_RULES];
+
+static int move_budget_ms = AI_MOVE_MS_DEFAULT;
+static int fill_wait_ms = AI_FILL_MS_DEFAULT;
+static int worker_count;
+
+// bounded job queue
+struct AiJob {
+    struct Room *room;
+    int seat;
+    unsigned gen;                   // room->move_gen when asked
+};
+
+static struct AiJob queue[AI_QUEUE_CAP];
+static int q_head, q_len;
+static pthread_mutex_t q_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t q_cond = PTHREAD_COND_INITIALIZER;
+
+/* ---------- tables ---------- */
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void build_tables(void) {
+    uint64_t seed = 0x7474746169ull;
+    for (int c = 0; c < MAX_CELLS; c++) {
+        for (int p = 0; p < MAX_PLAYERS; p++) z_cell[c][p] = splitmix64(&seed);
+    }
+    for (int p = 0; p < MAX_PLAYERS; p++) {
+        z_turn[p] = splitmix64(&seed);
+        z_me[p] = splitmix64(&seed);
+    }
+    for (int r = 0; r < MAX_RULES; r++) z_rules[r] = splitmix64(&seed);
+    for (int p = 0; p < MAX_PLAYERS; p++) z_left[p] = splitmix64(&seed);
+
+    for (int ri = 0; ri < rule_count; ri++) {
+        int n = rule_sets[ri].n;
+        int cells = n * n;
+
+        // centre-first move order
+        int *order = calloc((size_t)cells, sizeof(int));
+        int *dist = calloc((size_t)cells, sizeof(int));
+        if (!order || !dist) { perror("ai tables"); exit(1); }
+        for (int c = 0; c < cells; c++) {
+            int dr = 2 * (c / n) - (n - 1), dc = 2 * (c % n) - (n - 1);
+            dist[c] = dr * dr + dc * dc;
+            order[c] = c;
+        }
+        for (int i = 1; i < cells; i++) {   // insertion sort, runs once
+            int v = order[i], j = i - 1;
+            while (j >= 0 && dist[order[j]] > dist[v]) { order[j + 1] = order[j]; j--; }
+            order[j + 1] = v;
+        }
+        free(dist);
+        cell_order[ri] = order;
+
+        if (n <= 5) continue; // small boards: every empty cell is a candidate
+
+        bitboard_t *near = calloc((size_t)cells, sizeof(bitboard_t));
+        if (!near) { perror("ai tables"); exit(1); }
+        for (int c = 0; c < cells; c++) {
+            int r = c / n, col = c % n;
+            for (int dr = -1; dr <= 1; dr++) {
+                for (int dc = -1; dc <= 1; dc++) {
+                    int rr = r + dr, cc = col + dc;
+                    if (rr >= 0 && rr < n && cc >= 0 && cc < n) bb_set(&near[c], rr * n + cc);
+                }
+            }
+        }
+        near_mask[ri] = near;
+    }
+}
+
+static int tt_probe(uint64_t key, int *score, int *depth, int *flag, int *move) {
+    struct TTEntry *e = &tt[key & tt_mask];
+    uint64_t data = atomic_load_explicit(&e->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+    if ((check ^ data) != key) return 0;
+
+    *score = (int32_t)(uint32_t)data;
+    *depth = (int)((data >> 32) & 0xff);
+    *flag = (int)((data >> 40) & 0x3);
+    *move = (int)((data >> 48) & 0xffff) - 1;
+    return 1;
+}
+
+static void tt_store(uint64_t key, int score, int depth, int flag, int move) {
+    uint64_t data = (uint64_t)(uint32_t)score
+                  | (uint64_t)(depth & 0xff) << 32
+                  | (uint64_t)flag << 40
+                  | (uint64_t)((move + 1) & 0xffff) << 48;
+    struct TTEntry *e = &tt[key & tt_mask];
+    atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&e->data, data, memory_order_relaxed);
+}
+
+/* ---------- search ---------- */
+
+struct Search {
+    const struct Rules *rules;
+    int ri;
+    int me;                         // the AI seat
+    int players;
+    bool active[MAX_PLAYERS];
+    bitboard_t marks[MAX_PLAYERS];
+    bitboard_t occupied;
+    int empty;
+    uint64_t hash;                  // marks only
+    uint64_t base;                  // z_me ^ z_rules ^ z_left, same for the whole search
+    long long deadline;
+    long nodes;
+    bool stop;
+};
+
+static int next_seat(const struct Search *s, int seat) {
+    do {
+        seat = (seat + 1) % s->players;
+    } while (!s->active[seat]);
+    return seat;
+}
+
+static void place(struct Search *s, int seat, int cell) {
+    bb_set(&s->marks[seat], cell);
+    bb_set(&s->occupied, cell);
+    s->hash ^= z_cell[cell][seat];
+    s->empty--;
+}
+
+static void unplace(struct Search *s, int seat, int cell) {
+    s->marks[seat].w[cell >> 6] &= ~(1ULL << (cell & 63));
+    s->occupied.w[cell >> 6] &= ~(1ULL << (cell & 63));
+    s->hash ^= z_cell[cell][seat];
+    s->empty++;
+}
+
+static int count_in(const bitboard_t *marks, const bitboard_t *line) {
+    int n = 0;
+    for (int i = 0; i < BB_WORDS; i++) n += __builtin_popcountll(marks->w[i] & line->w[i]);
+    return n;
+}
+
+// open lines only: a line one seat has started and nobody has blocked
+static int evaluate(const struct Search *s) {
+    const struct WinTable *t = &s->rules->lines;
+    long long score = 0;
+
+    for (int l = 0; l < t->line_count; l++) {
+        int owner = -1, cnt = 0;
+        for (int p = 0; p < s->players; p++) {
+            if (!s->active[p]) continue;
+            int c = count_in(&s->marks[p], &t->lines[l]);
+            if (!c) continue;
+            if (owner >= 0) { owner = -2; break; } // blocked
+            owner = p;
+            cnt = c;
+        }
+        if (owner < 0) continue;
+
+        long long w = 1LL << (cnt * 3 < 30 ? cnt * 3 : 30);
+        score += (owner == s->me) ? w : -w;
+    }
+
+    if (score > AI_MATE / 2) score = AI_MATE / 2;
+    if (score < -AI_MATE / 2) score = -AI_MATE / 2;
+    return (int)score;
+}
+
+// candidate moves, `first` (TT / previous best) in front, then centre-first
+static int gen_moves(const struct Search *s, int first, int *out) {
+    int cells = s->rules->n * s->rules->n;
+    bitboard_t cand;
+
+    if (near_mask[s->ri] && s->empty < cells) {
+        bb_clear(&cand);
+        for (int w = 0; w < BB_WORDS; w++) {
+            uint64_t bits = s->occupied.w[w];
+            while (bits) {
+                int c = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                for (int i = 0; i < BB_WORDS; i++) cand.w[i] |= near_mask[s->ri][c].w[i];
+            }
+        }
+    } else if (near_mask[s->ri]) {
+        bb_clear(&cand);
+        bb_set(&cand, cell_order[s->ri][0]); // empty big board: take the centre
+    } else {
+        memset(&cand, 0xff, sizeof(cand));
+    }
+    for (int i = 0; i < BB_WORDS; i++) cand.w[i] &= ~s->occupied.w[i];
+
+    int n = 0;
+    if (first >= 0 && first < cells && bb_test(&cand, first)) out[n++] = first;
+    for (int i = 0; i < cells; i++) {
+        int c = cell_order[s->ri][i];
+        if (c != first && bb_test(&cand, c)) out[n++] = c;
+    }
+    return n;
+}
+
+// score is always from the AI seat's point of view
+static int search(struct Search *s, int turn, int depth, int ply, int alpha, int beta) {
+    if ((++s->nodes & 1023) == 0 && now_ms() >= s->deadline) s->stop = true;
+    if (s->stop) return 0;
+    if (s->empty == 0) return 0;            // draw
+    if (depth == 0) return evaluate(s);
+
+    uint64_t key = s->hash ^ s->base ^ z_turn[turn];
+    int tt_move = -1, tt_score, tt_depth, tt_flag;
+    if (tt_probe(key, &tt_score, &tt_depth, &tt_flag, &tt_move) && tt_depth >= depth) {
+        // forced results are stored relative to the node
+        if (tt_score > AI_MATE) tt_score -= ply;
+        else if (tt_score < -AI_MATE) tt_score += ply;
+
+        if (tt_flag == TT_EXACT) return tt_score;
+        if (tt_flag == TT_LOWER && tt_score >= beta) return tt_score;
+        if (tt_flag == TT_UPPER && tt_score <= alpha) return tt_score;
+    }
+
+    bool maxing = (turn == s->me);
+    int alpha0 = alpha, beta0 = beta;
+    int best = maxing ? -AI_INF : AI_INF;
+    int best_move = -1;
+    int next = next_seat(s, turn);
+
+    int moves[MAX_CELLS];
+    int count = gen_moves(s, tt_move, moves);
+    for (int i = 0; i < count; i++) {
+        int cell = moves[i];
+        int v;
+
+        place(s, turn, cell);
+        if (engine_wins_at(&s->rules->lines, &s->marks[turn], cell)) {
+            v = maxing ? AI_WIN - ply : -(AI_WIN - ply);
+        } else {
+            v = search(s, next, depth - 1, ply + 1, alpha, beta);
+        }
+        unplace(s, turn, cell);
+        if (s->stop) return 0;
+
+        if (maxing) {
+            if (v > best) { best = v; best_move = cell; }
+            if (best > alpha) alpha = best;
+        } else {
+            if (v < best) { best = v; best_move = cell; }
+            if (best < beta) beta = best;
+        }
+        if (alpha >= beta) break;
+    }
+
+    int flag = (best <= alpha0) ? TT_UPPER : (best >= beta0) ? TT_LOWER : TT_EXACT;
+    int stored = best;
+    if (stored > AI_MATE) stored += ply;
+    else if (stored < -AI_MATE) stored -= ply;
+    tt_store(key, stored, depth, flag, best_move);
+    return best;
+}
+
+// iterative deepening at the root; returns the best move of the
+// deepest iteration that finished inside the budget
+static int choose_move(struct Search *s) {
+    int moves[MAX_CELLS];
+    int best_move = -1;
+    int next = next_seat(s, s->me);
+
+    for (int depth = 1; depth <= s->empty && depth <= AI_MAX_DEPTH; depth++) {
+        int count = gen_moves(s, best_move, moves);
+        int alpha = -AI_INF, iter_best = -1;
+
+        for (int i = 0; i < count; i++) {
+            int cell = moves[i];
+            int v;
+
+            place(s, s->me, cell);
+            if (engine_wins_at(&s->rules->lines, &s->marks[s->me], cell)) {
+                v = AI_WIN;
+            } else {
+                v = search(s, next, depth - 1, 1, alpha, AI_INF);
+            }
+            unplace(s, s->me, cell);
+            if (s->stop) break;
+
+            if (v > alpha || iter_best < 0) { alpha = v; iter_best = cell; }
+        }
+
+        if (s->stop) {
+            if (best_move < 0) best_move = iter_best >= 0 ? iter_best : moves[0];
+            break;
+        }
+        best_move = iter_best;
+        if (alpha > AI_MATE || alpha < -AI_MATE) break; // outcome is forced either way
+    }
+    return best_move;
+}
+
+/* ---------- opening book ---------- */
+
+// classic game with all three seats playing, from seat 0's first move:
+// pick the child the solved book rates best. -1 if not covered
+static int book_move(const struct Search *s) {
+    const struct Rules *r = s->rules;
+    if (r->n != BOARD_N || r->k != BOARD_N || r->players != 3) return -1;
+    for (int p = 0; p < 3; p++) if (!s->active[p]) return -1;
+
+    int cells = BOARD_N * BOARD_N;
+    int ply = cells - s->empty;
+    if (ply >= book_plies() || ply % 3 != s->me) return -1;
+
+    uint32_t key = 0;
+    for (int p = 0; p < 3; p++) {
+        for (int c = 0; c < cells; c++) {
+            if (bb_test(&s->marks[p], c)) key |= (uint32_t)(p + 1) << (2 * c);
+        }
+    }
+
+    int mover = s->me + 1;
+    int best = -1, best_move = -1;
+    for (int c = 0; c < cells; c++) {
+        if (bb_test(&s->occupied, c)) continue;
+
+        uint32_t child = key | (uint32_t)mover << (2 * c);
+        bitboard_t mine = s->marks[s->me];
+        bb_set(&mine, c);
+        int v = engine_wins_at(&r->lines, &mine, c) ? mover : book_lookup(child);
+        if (v < 0) return -1;
+        if (best < 0 || book_better(mover, v, best)) { best = v; best_move = c; }
+    }
+    return best_move;
+}
+
+/* ---------- workers ---------- */
+
+static bool still_my_turn(struct Room *room, const struct AiJob *job) {
+    return room->in_use && !room->round_over &&
+           room->move_gen == job->gen &&
+           room->current_turn_id == job->seat &&
+           room->player_ai[job->seat];
+}
+
+static void ai_play(const struct AiJob *job) {
+    struct Room *room = job->room;
+    struct Search s;
+    memset(&s, 0, sizeof(s));
+
+    // snapshot the board, then search without the room lock
+    pthread_mutex_lock(&room->board_mutex);
+    if (!still_my_turn(room, job)) {
+        pthread_mutex_unlock(&room->board_mutex);
+        return;
+    }
+    s.rules = room->rules;
+    s.ri = rules_index(room->rules);
+    s.me = job->seat;
+    s.players = room->rules->players;
+    for (int p = 0; p < s.players; p++) {
+        s.active[p] = room->player_active[p];
+        s.marks[p] = room->marks[p];
+        for (int w = 0; w < BB_WORDS; w++) {
+            uint64_t bits = s.marks[p].w[w];
+            while (bits) {
+                s.hash ^= z_cell[w * 64 + __builtin_ctzll(bits)][p];
+                bits &= bits - 1;
+            }
+        }
+    }
+    s.occupied = room->occupied;
+    pthread_mutex_unlock(&room->board_mutex);
+
+    s.empty = s.rules->n * s.rules->n - bb_popcount(&s.occupied);
+    s.base = z_me[s.me] ^ z_rules[s.ri];
+    for (int p = 0; p < s.players; p++) {
+        if (!s.active[p]) s.base ^= z_left[p];
+    }
+    s.deadline = now_ms() + move_budget_ms;
+
+    int cell = book_move(&s);
+    if (cell < 0) cell = choose_move(&s);
+    if (cell < 0) return;
+
+    pthread_mutex_lock(&room->board_mutex);
+    // humans may have left or the round been reset meanwhile
+    if (still_my_turn(room, job) && room->board[cell] == EMPTY_CELL) {
+        room_place_locked(room, job->seat, cell);
+        room_move_done_locked(room);
+    }
+    room_unlock(room);
+}
+
+static void *ai_worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&q_mutex);
+        while (q_len == 0) pthread_cond_wait(&q_cond, &q_mutex);
+        struct AiJob job = queue[q_head];
+        q_head = (q_head + 1) % AI_QUEUE_CAP;
+        q_len--;
+        pthread_mutex_unlock(&q_mutex);
+
+        ai_play(&job);
+    }
+    return NULL;
+}
+
+// queue was full: try again shortly from the timer thread
+static void ai_retry_cb(void *arg) {
+    struct Room *room = arg;
+    pthread_mutex_lock(&room->board_mutex);
+    if (room->in_use && !room->round_over && room->current_turn_id >= 0 &&
+        room->player_ai[room->current_turn_id]) {
+        ai_request_move_locked(room);
+    }
+    room_unlock(room);
+}
+
+static void ai_fill_cb(void *arg) {
+    room_fill_ai(arg);
+}
+
+/* ---------- public api ---------- */
+
+// workers = 0 disables AI seats, fill_ms < 0 never fills seats
+void ai_init(int workers, int move_ms, int fill_ms) {
+    worker_count = workers;
+    move_budget_ms = move_ms;
+    fill_wait_ms = fill_ms;
+    if (workers <= 0) return;
+
+    tt_mask = (1ULL << AI_TT_BITS) - 1;
+    tt = calloc(tt_mask + 1, sizeof(*tt));
+    if (!tt) { perror("ai transposition table"); exit(1); }
+    build_tables();
+
+    for (int i = 0; i < workers; i++) {
+        pthread_t t;
+        pthread_create(&t, NULL, ai_worker, NULL);
+        pthread_detach(t);
+    }
+    printf("[AI] %d worker(s), %d ms per move.\n", workers, move_ms);
+}
+
+// current turn belongs to an AI seat; room is locked
+void ai_request_move_locked(struct Room *room) {
+    if (worker_count <= 0) return;
+
+    pthread_mutex_lock(&q_mutex);
+    bool queued = (q_len < AI_QUEUE_CAP);
+    if (queued) {
+        struct AiJob *job = &queue[(q_head + q_len) % AI_QUEUE_CAP];
+        job->room = room;
+        job->seat = room->current_turn_id;
+        job->gen = room->move_gen;
+        q_len++;
+        pthread_cond_signal(&q_cond);
+    }
+    pthread_mutex_unlock(&q_mutex);
+
+    if (!queued) timer_arm(&room->ai_timer, 50, ai_retry_cb, room);
+}
+
+// a table is short of players; give the humans fill_wait_ms before the AI sits down
+void ai_fill_later_locked(struct Room *room) {
+    if (worker_count <= 0 || fill_wait_ms < 0) return;
+    if (!timer_pending(&room->fill_timer)) {
+        timer_arm(&room->fill_timer, fill_wait_ms, ai_fill_cb, room);
+    }
+}
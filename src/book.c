@@ -0,0 +1,132 @@
+#include "game.h"
+
+// Opening book for the classic rules (BOARD_N x BOARD_N, 3 seats).
+// Positions are stored once per symmetry class: the key is reduced to
+// the smallest of its 8 rotations/reflections. The file is a header plus
+// an open-addressed table of BOOK_SLOT()s, mmap'd read-only, so a
+// lookup is one hash and a short probe.
+
+_Static_assert(BOARD_N * BOARD_N * 2 <= 32, "book key is 2 bits per cell in a uint32");
+
+#define CELLS (BOARD_N * BOARD_N)
+#define BOOK_PROBES 64
+
+// sym_byte[t][b][v]: cells 4b..4b+3 holding byte v, moved by transform t
+static uint32_t sym_byte[8][CELLS / 4][256];
+static pthread_once_t sym_once = PTHREAD_ONCE_INIT;
+
+static const struct BookHeader *book;
+static const uint64_t *book_slots;
+static uint64_t book_mask;
+
+static int transform(int t, int r, int c) {
+    int n = BOARD_N - 1;
+    switch (t) {
+    case 0:  return r * BOARD_N + c;
+    case 1:  return c * BOARD_N + (n - r);          // rotate 90
+    case 2:  return (n - r) * BOARD_N + (n - c);    // rotate 180
+    case 3:  return (n - c) * BOARD_N + r;          // rotate 270
+    case 4:  return r * BOARD_N + (n - c);          // mirror
+    case 5:  return (n - r) * BOARD_N + c;          // flip
+    case 6:  return c * BOARD_N + r;                // transpose
+    default: return (n - c) * BOARD_N + (n - r);    // anti-transpose
+    }
+}
+
+static void build_sym(void) {
+    for (int t = 0; t < 8; t++) {
+        for (int b = 0; b < CELLS / 4; b++) {
+            for (int v = 0; v < 256; v++) {
+                uint32_t out = 0;
+                for (int i = 0; i < 4; i++) {
+                    int cell = b * 4 + i;
+                    uint32_t mark = (v >> (2 * i)) & 3;
+                    out |= mark << (2 * transform(t, cell / BOARD_N, cell % BOARD_N));
+                }
+                sym_byte[t][b][v] = out;
+            }
+        }
+    }
+}
+
+/* ---------- keys ---------- */
+
+// smallest key among the 8 symmetric boards
+uint32_t book_canonical(uint32_t key) {
+    pthread_once(&sym_once, build_sym);
+
+    uint32_t best = key;
+    for (int t = 1; t < 8; t++) {
+        uint32_t k = 0;
+        for (int b = 0; b < CELLS / 4; b++) k |= sym_byte[t][b][(key >> (8 * b)) & 0xff];
+        if (k < best) best = k;
+    }
+    return best;
+}
+
+uint32_t book_hash(uint32_t key) {
+    uint32_t h = key * 0x9E3779B1u;
+    return h ^ (h >> 15);
+}
+
+// max-n choice for `mover`: own win, then draw, then a loss. Between two
+// losses the lower seat is assumed to win, a fixed rule so every
+// symmetric position gets the same value
+bool book_better(int mover, int a, int b) {
+    int ua = (a == mover) ? 2 : (a == BOOK_DRAW) ? 1 : 0;
+    int ub = (b == mover) ? 2 : (b == BOOK_DRAW) ? 1 : 0;
+    if (ua != ub) return ua > ub;
+    return a < b;
+}
+
+/* ---------- file ---------- */
+
+int book_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { perror(path); return -1; }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct BookHeader)) {
+        fprintf(stderr, "%s: not an opening book\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) { perror("mmap book"); return -1; }
+
+    const struct BookHeader *h = map;
+    size_t need = sizeof(*h) + (sizeof(uint64_t) << h->slots_log2);
+    if (memcmp(h->magic, BOOK_MAGIC, sizeof(h->magic)) != 0 || h->slots_log2 > 32 ||
+        (size_t)st.st_size < need || h->n != BOARD_N || h->k != BOARD_N || h->players != 3) {
+        fprintf(stderr, "%s: not an opening book for the classic game\n", path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    book = h;
+    book_slots = (const uint64_t *)(h + 1);
+    book_mask = (1ULL << h->slots_log2) - 1;
+    printf("Opening book: %u positions up to %u marks.\n", h->count, h->plies);
+    return 0;
+}
+
+// outcome of the position with best play, -1 if it isn't in the book
+int book_lookup(uint32_t key) {
+    if (!book) return -1;
+
+    uint32_t canon = book_canonical(key);
+    uint64_t i = book_hash(canon) & book_mask;
+    for (int probe = 0; probe < BOOK_PROBES; probe++) {
+        uint64_t slot = book_slots[i];
+        if (slot == 0) return -1;
+        if ((uint32_t)(slot >> 32) == canon) return (int)(slot & 0xff) - 1;
+        i = (i + 1) & book_mask;
+    }
+    return -1;
+}
+
+int book_plies(void) {
+    return book ? (int)book->plies : 0;
+}
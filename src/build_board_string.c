@@ -1,17 +1,17 @@
 #include "game.h"
 
-void build_board_string(char *out, size_t out_sz) {
-    size_t used = 0;
-    used += (size_t)snprintf(out + used, out_sz - used, "\n    0 1 2 3\n");
-    for (int r = 0; r < BOARD_N; r++) {
-        used += (size_t)snprintf(out + used, out_sz - used, "%d | ", r);
-        for (int c = 0; c < BOARD_N; c++) {
-            char cell = gameData->board[r][c];
-            if (cell == 0) cell = '.';
-            used += (size_t)snprintf(out + used, out_sz - used, "%c ", cell);
-        }
-        used += (size_t)snprintf(out + used, out_sz - used, "\n");
-        if (used >= out_sz) break;
+// compact board: copy the rule set's template and patch the occupied cells
+void build_board_string(struct Room *room, char *out, size_t out_sz) {
+    const struct Rules *rules = room->rules;
+    if (rules->compact_len + 1 > out_sz) {
+        if (out_sz) out[0] = '\0';
+        return;
+    }
+
+    memcpy(out, rules->compact, rules->compact_len + 1);
+    int cells = rules->n * rules->n;
+    for (int i = 0; i < cells; i++) {
+        char cell = room->board[i];
+        if (cell != 0 && cell != EMPTY_CELL) out[rules->compact_offset[i]] = cell;
     }
-    used += (size_t)snprintf(out + used, out_sz - used, "\n");
 }
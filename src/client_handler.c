@@ -1,5 +1,8 @@
 #include "game.h"
 
+static int handshake_ms = HANDSHAKE_MS_DEFAULT;
+static int idle_ms = IDLE_MS_DEFAULT;
+
 /* ---------- helpers ---------- */
 
 static void trim_newline(char *s) {
@@ -7,288 +10,794 @@ static void trim_newline(char *s) {
     s[strcspn(s, "\r\n")] = '\0';
 }
 
-static void send_str(int sock, const char *s) {
+// queued on the connection, never blocks
+static void send_str(struct Conn *conn, const char *s) {
     if (!s) return;
-    send(sock, s, strlen(s), 0);
+    conn_send_text(conn, s, strlen(s));
+}
+
+static void send_bin(struct Conn *conn, uint8_t type, const void *payload, size_t len) {
+    struct Frame *f = frame_proto(type, payload, len);
+    conn_send(conn, f, NULL, 0, false);
+    frame_unref(f);
+}
+
+// status reply: a code for binary clients, the sentence for humans
+static void reply(struct Conn *conn, enum ProtoStatus code, const char *text) {
+    if (conn->binary) {
+        uint8_t c = (uint8_t)code;
+        send_bin(conn, P_STATUS, &c, 1);
+    } else {
+        send_str(conn, text);
+    }
 }
 
-static void send_prompt(int sock, int max_cell) {
+// prompt with its choices ("XYZ", "classic/gomoku") for binary clients
+static void send_bin_prompt(struct Conn *conn, enum ProtoPrompt kind, const char *choices) {
+    uint8_t p[PROTO_MAX_PAYLOAD];
+    size_t len = choices ? strnlen(choices, sizeof(p) - 1) : 0;
+    p[0] = (uint8_t)kind;
+    if (len) memcpy(p + 1, choices, len);
+    send_bin(conn, P_PROMPT, p, 1 + len);
+}
+
+static void send_prompt(struct Conn *conn, int max_cell) {
+    if (conn->binary) {
+        send_bin_prompt(conn, PROMPT_MOVE, NULL);
+        return;
+    }
     char p[80];
     snprintf(p, sizeof(p), "Input next grid number (1-%d): ", max_cell);
-    send_str(sock, p);
+    send_str(conn, p);
+}
+
+// P_BOARD as the room is now; P_DELTAs follow from its seq
+static void send_snapshot(struct Conn *conn, struct Room *room) {
+    pthread_mutex_lock(&room->board_mutex);
+    outbox_add(conn, render_bin_frame_locked(room), NULL, 0, true);
+    room_unlock(room);
 }
 
-static int parse_grid_number(const char *msg, int *out_r, int *out_c) {
+static void send_symbol_prompt(struct Conn *conn, const struct Rules *rules) {
+    if (conn->binary) send_bin_prompt(conn, PROMPT_SYMBOL, rules->symbols);
+    else send_str(conn, rules->symbol_prompt);
+}
+
+static int parse_grid_number(const char *msg, int n, int *out_r, int *out_c) {
     // accepts: "7"  (grid number)
     // you can extend later to accept "row col" if needed
     int idx;
     if (sscanf(msg, "%d", &idx) != 1) return 0;
 
-    int max_cell = BOARD_N * BOARD_N;
+    int max_cell = n * n;
     if (idx < 1 || idx > max_cell) return 0;
 
     idx -= 1; // make 0-based
-    *out_r = idx / BOARD_N; // row 
-    *out_c = idx % BOARD_N; // column
+    *out_r = idx / n; // row 
+    *out_c = idx % n; // column
     return 1;
 }
 
 // check symbol if taken 
-static int symbol_taken(char sym) {
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (gameData->player_active[i] && gameData->player_symbol[i] == sym) return 1;
+static int symbol_taken(struct Room *room, char sym) {
+    for (int i = 0; i < room->rules->players; i++) {
+        if (room->player_active[i] && room->player_symbol[i] == sym) return 1;
     }
     return 0;
 }
 
-/* 4x4 win: any full row/col, or two diagonals */
-static int check_win(char b[BOARD_N][BOARD_N], char sym) {
-    // rows // horizontal  
-    for (int r = 0; r < BOARD_N; r++) {
-        int ok = 1;
-        for (int c = 0; c < BOARD_N; c++) {
-            if (b[r][c] != sym) { ok = 0; break; }
-        }
-        if (ok) return 1;
-    }
+/* ---------- connection lifecycle ---------- */
+
+// limits in ms, 0 = none
+void client_timeouts(int handshake, int idle) {
+    handshake_ms = handshake;
+    idle_ms = idle;
+}
+
+// input only moves conn->deadline, so a busy connection costs one
+// timer_arm() per limit, not one per read. The timer never waits past
+// idle_ms: getting seated can bring the deadline forward
+static long long timer_wait(long long left) {
+    return idle_ms > 0 && idle_ms < left ? idle_ms : left;
+}
 
-    // cols // verticle
-    for (int c = 0; c < BOARD_N; c++) {
-        int ok = 1;
-        for (int r = 0; r < BOARD_N; r++) {
-            if (b[r][c] != sym) { ok = 0; break; }
+// scheduler thread
+static void conn_timeout_cb(void *arg) {
+    struct Conn *conn = arg;
+    long long deadline = atomic_load_explicit(&conn->deadline, memory_order_relaxed);
+
+    if (deadline && !conn_closed(conn)) {
+        long long left = deadline - now_ms();
+        if (left > 0) {
+            timer_arm(&conn->timer, timer_wait(left), conn_timeout_cb, conn); // keeps the ref
+            // closed meanwhile: conn_shutdown() may have missed the timer
+            if (!conn_closed(conn) || !timer_cancel(&conn->timer)) return;
+        } else {
+            metrics_count(MC_TIMEOUTS, 1);
+            reply(conn, ST_TIMED_OUT, conn->room ? "Timed out: nothing received for too long.\n"
+                                                 : "Timed out: took too long to join.\n");
+            shutdown(conn->fd, SHUT_RDWR); // its reactor closes it like a hang-up
         }
-        if (ok) return 1;
     }
+    conn_unref(conn);
+}
 
-    // main diag
-    {
-        int ok = 1;
-        for (int i = 0; i < BOARD_N; i++) {
-            if (b[i][i] != sym) { ok = 0; break; }
-        }
-        if (ok) return 1;
+void client_connected(struct Conn *conn) {
+    conn->room = NULL;
+    conn->seat = -1;
+
+    // until seated the handshake limit applies, then the idle one
+    int limit = handshake_ms > 0 ? handshake_ms : idle_ms;
+    if (limit > 0) {
+        atomic_store_explicit(&conn->deadline, now_ms() + limit, memory_order_relaxed);
+        timer_arm(&conn->timer, timer_wait(limit), conn_timeout_cb, conn_ref(conn));
     }
 
-    // anti diag
-    {
-        int ok = 1;
-        for (int i = 0; i < BOARD_N; i++) {
-            if (b[i][BOARD_N - 1 - i] != sym) { ok = 0; break; }
-        }
-        if (ok) return 1;
+    // Ask name
+    conn->state = CONN_NAME;
+    send_str(conn, "Enter your name: ");
+}
+
+// connection drops: the seat waits for its player to /resume (or is
+// freed, see room_drop)
+void client_disconnected(struct Conn *conn) {
+    watch_leave(conn);
+    if (conn->state == CONN_QUEUED && !match_leave(conn)) return;
+
+    struct Room *room = conn->room;
+    if (!room) return; // never got seated
+
+    int human_player_number = conn->seat + 1;
+    bool held = room_drop(room, conn->seat, conn);
+
+    if (conn->state == CONN_PLAYING) {
+        //terminal display
+        printf("Room %d: Player %d disconnected%s.\n", room->id, human_player_number, held ? ", seat held" : "");
+
+        //write to game log
+        char logBuf[128];
+        snprintf(logBuf, sizeof(logBuf), "Room %d: Player %d disconnected%s.", room->id, human_player_number,
+                 held ? ", seat held" : "");
+        log_message(logBuf);
     }
+}
 
-    return 0;
+/* ---------- per-state handlers ---------- */
+
+// room, seat and the seat token that takes the seat back after a restart
+static void send_joined(struct Conn *conn, struct Room *room, int seat) {
+    const struct Rules *rules = room->rules;
+
+    pthread_mutex_lock(&room->board_mutex);
+    uint64_t token = room->player_token[seat];
+    pthread_mutex_unlock(&room->board_mutex);
+
+    if (conn->binary) {
+        uint8_t j[16];
+        uint32_t id = htonl((uint32_t)room->id);
+        uint32_t hi = htonl((uint32_t)(token >> 32)), lo = htonl((uint32_t)token);
+        memcpy(j, &id, 4);
+        j[4] = (uint8_t)seat;
+        j[5] = (uint8_t)rules->n;
+        j[6] = (uint8_t)rules->k;
+        j[7] = (uint8_t)rules->players;
+        memcpy(j + 8, &hi, 4);
+        memcpy(j + 12, &lo, 4);
+        send_bin(conn, P_JOINED, j, sizeof(j));
+        return;
+    }
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Your seat token is %016llx. If the server restarts, reconnect and send /resume %016llx\n",
+             (unsigned long long)token, (unsigned long long)token);
+    send_str(conn, msg);
 }
 
-// all tiles is filled in 
-static int check_draw(char b[BOARD_N][BOARD_N]) {
-    for (int r = 0; r < BOARD_N; r++) {
-        for (int c = 0; c < BOARD_N; c++) {
-            if (b[r][c] == EMPTY_CELL) return 0;
-        }
+static void send_symbol_ok(struct Conn *conn, struct Room *room, int seat, char sym) {
+    if (conn->binary) {
+        uint8_t ok[2] = { ST_SYMBOL_OK, (uint8_t)sym };
+        send_bin(conn, P_STATUS, ok, sizeof(ok));
+    } else {
+        char okmsg[80];
+        snprintf(okmsg, sizeof(okmsg), "Your symbol has been assigned: %c\n", sym);
+        send_str(conn, okmsg);
     }
+
+    char logBuf[128];
+    snprintf(logBuf, sizeof(logBuf), "Room %d: Player %d chose symbol %c", room->id, seat + 1, sym);
+    log_message(logBuf);
+
+    // Wait message; the last player to pick a symbol starts the game
+    metrics_time(MO_HANDSHAKE, conn->accepted_ns);
+    reply(conn, ST_WAITING, "Waiting for game to start...\n");
+}
+
+// into the matchmaker's queue for the chosen rule set; the symbol can
+// be picked while it looks for a table
+static int queue_player(struct Conn *conn, const struct Rules *rules) {
+    conn->state = CONN_QUEUED;
+    reply(conn, ST_MATCHING, "Looking for players at your level...\n");
+    send_symbol_prompt(conn, rules);
+    match_enqueue(conn, rules);
     return 1;
 }
 
-/* ---------- main handler ---------- */
+// matchmaker thread: the queued player got a seat (room NULL: the
+// server is full). conn->state etc. belong to its reactor, which takes
+// the seat over in match_adopt(); the symbol picked meanwhile is applied
+// here unless a table mate has it
+void client_seated(struct Conn *conn, struct Room *room, int seat) {
+    if (!room) {
+        reply(conn, ST_SERVER_FULL, "Server full.\n");
+        shutdown(conn->fd, SHUT_RDWR); // its reactor closes it like a hang-up
+        return;
+    }
+
+    int want = atomic_exchange(&conn->match_symbol, MATCH_SYMBOL_CLOSED);
+    char sym = 0;
+    pthread_mutex_lock(&room->board_mutex);
+    if (want > 0 && !symbol_taken(room, (char)want)) {
+        sym = (char)want;
+        room->player_symbol[seat] = sym;
+        wal_record_locked(room, WAL_SYMBOL, seat, sym, 0);
+    }
+    pthread_mutex_unlock(&room->board_mutex);
 
-void handle_client(int client_socket, int player_id, int human_player_number) {
-    printf("Player %d connected (ID: %d).\n", human_player_number, player_id);
+    conn->match_room = room;
+    conn->match_seat = seat;
+    conn->match_playing = sym != 0;
+    atomic_store_explicit(&conn->deadline, idle_ms > 0 ? now_ms() + idle_ms : 0, memory_order_relaxed);
 
-    // store socket for scheduler broadcast
-    pthread_mutex_lock(&gameData->board_mutex);
-    gameData->client_sockets[player_id] = client_socket;
-    pthread_mutex_unlock(&gameData->board_mutex);
+    int human_player_number = seat + 1;
+    printf("Room %d: Player %d connected (ID: %d).\n", room->id, human_player_number, seat);
 
     char logBuf[128];
-    snprintf(logBuf, sizeof(logBuf), "Player %d connected.", human_player_number);
+    snprintf(logBuf, sizeof(logBuf), "Room %d: Player %d connected.", room->id, human_player_number);
     log_message(logBuf);
 
-    // Ask name
-    send_str(client_socket, "Enter your name: ");
-    char buf[BUFFER_SIZE];
+    send_joined(conn, room, seat);
+    if (conn->binary) send_snapshot(conn, room);
 
-    memset(buf, 0, sizeof(buf));
-    int n = (int)recv(client_socket, buf, sizeof(buf) - 1, 0);
-    if (n <= 0) {
-        close(client_socket);
-        exit(0);
+    if (sym) {
+        send_symbol_ok(conn, room, seat, sym);
+    } else {
+        // Ask symbol
+        if (want > 0) reply(conn, ST_SYMBOL_TAKEN, "That symbol is already taken. Choose another.\n");
+        send_symbol_prompt(conn, room->rules);
     }
-    buf[n] = '\0';
-    trim_newline(buf);
+    atomic_store_explicit(&conn->match_state, MATCH_SEATED, memory_order_release);
 
-    // player input thier name, mutex lock to prevent 2 enter at same time 
-    pthread_mutex_lock(&gameData->board_mutex);
-    snprintf(gameData->player_name[player_id],
-             sizeof(gameData->player_name[player_id]),
-             "%.31s", buf); // limit to 31 chars
-    pthread_mutex_unlock(&gameData->board_mutex);
-
-    // Ask symbol
-    while (1) {
-        send_str(client_socket, "Choose your symbol (X/Y/Z): ");
-
-        memset(buf, 0, sizeof(buf));
-
-        // wait for input response
-        n = (int)recv(client_socket, buf, sizeof(buf) - 1, 0);
-        
-        //connections drop, inactive player @ exits
-        if (n <= 0) {
-            
-            pthread_mutex_lock(&gameData->board_mutex);
-            gameData->player_active[player_id] = false;
-            gameData->client_sockets[player_id] = -1;
-            pthread_mutex_unlock(&gameData->board_mutex);
-            close(client_socket);
-            exit(0);
-        }
-        buf[n] = '\0';
-        trim_newline(buf);
-
-        // upper lower case both is acceptable // will only show upper case in board
-        char sym = 0;
-        if (buf[0] == 'X' || buf[0] == 'x') sym = 'X';
-        else if (buf[0] == 'Y' || buf[0] == 'y') sym = 'Y';
-        else if (buf[0] == 'Z' || buf[0] == 'z') sym = 'Z';
-
-        if (!sym) {
-            send_str(client_socket, "Invalid symbol. Please choose X, Y, or Z.\n");
-            continue;
-        }
+    if (sym) {
+        pthread_mutex_lock(&room->board_mutex);
+        room_try_start_locked(room);
+        room_unlock(room);
+    }
+}
 
-        // check if taken 
-        pthread_mutex_lock(&gameData->board_mutex);
-        int taken = symbol_taken(sym);
-        if (!taken) {
-            gameData->player_symbol[player_id] = sym;
-        }
-        pthread_mutex_unlock(&gameData->board_mutex);
+// a recovered seat taken back by its token, instead of a name
+static void on_resume(struct Conn *conn, uint64_t token) {
+    if (conn->state != CONN_NAME) {
+        reply(conn, ST_BAD_TOKEN, "You already have a seat.\n");
+        return;
+    }
+    int seat = -1;
+    struct Room *room = room_reclaim(token, conn, &seat);
+    if (!room) {
+        reply(conn, ST_BAD_TOKEN, "No seat is waiting for that token.\n");
+        return;
+    }
+    conn->room = room;
+    conn->seat = seat;
 
-        if (taken) {
-            send_str(client_socket, "That symbol is already taken. Choose another.\n");
-            continue;
-        }
+    printf("Room %d: Player %d is back.\n", room->id, seat + 1);
+    char logBuf[128];
+    snprintf(logBuf, sizeof(logBuf), "Room %d: Player %d reclaimed their seat.", room->id, seat + 1);
+    log_message(logBuf);
 
-        char okmsg[80];
-        snprintf(okmsg, sizeof(okmsg), "Your symbol has been assigned: %c\n", sym);
-        send_str(client_socket, okmsg);
+    send_joined(conn, room, seat);
 
-        snprintf(logBuf, sizeof(logBuf), "Player %d chose symbol %c", human_player_number, sym);
-        log_message(logBuf);
+    pthread_mutex_lock(&room->board_mutex);
+    char sym = room->player_symbol[seat];
+    if (!sym) {
+        room_unlock(room);
+        conn->state = CONN_SYMBOL;
+        send_symbol_prompt(conn, room->rules);
+        return;
+    }
+    conn->state = CONN_PLAYING;
+    metrics_time(MO_HANDSHAKE, conn->accepted_ns);
+
+    // the board as it stands, then the game goes on
+    if (conn->binary) {
+        outbox_add(conn, render_bin_frame_locked(room), NULL, 0, true);
+    } else {
+        const struct Rules *rules = room->rules;
+        char msg[96];
+        snprintf(msg, sizeof(msg), "Welcome back, %s. You are player %d (%c) in room %d.\n",
+                 conn->name, seat + 1, sym, room->id);
+        send_str(conn, msg);
+        struct Frame *f = render_frame_locked(room, true);
+        conn->seen_labels = true;
+        if (room->round_over || room->current_turn_id < 0) outbox_add(conn, f, NULL, 0, true);
+        else if (room->current_turn_id == seat) outbox_add(conn, f, rules->turn_suffix, rules->turn_suffix_len, true);
+        else outbox_add(conn, f, rules->wait_suffix, rules->wait_suffix_len, true);
+    }
+    room_try_start_locked(room);
+    room_unlock(room);
 
-        break;
+    if (conn->binary) {
+        uint8_t ok[2] = { ST_SYMBOL_OK, (uint8_t)sym };
+        send_bin(conn, P_STATUS, ok, sizeof(ok));
     }
+}
 
-    // Wait message; scheduler will broadcast the big board screens
-    send_str(client_socket, "Waiting for game to start...\n");
+// spectate a room (-1: the first table in play) instead of joining one;
+// again to switch tables
+static void on_watch(struct Conn *conn, int room_id) {
+    if (conn->state == CONN_QUEUED) {
+        reply(conn, ST_NO_ROOM, "You are waiting for a table.\n");
+        return;
+    }
+    if (conn->room) {
+        reply(conn, ST_NO_ROOM, "You have a seat, finish your game first.\n");
+        return;
+    }
+    int rid = watch_find(room_id);
+    if (rid < 0) {
+        reply(conn, ST_NO_ROOM, room_id < 0 ? "No game is being played right now.\n" : "No game in that room.\n");
+        return;
+    }
 
-    // Main loop: receive grid moves
-    while (1) {
-        memset(buf, 0, sizeof(buf));
-        int bytes = (int)recv(client_socket, buf, sizeof(buf) - 1, 0);
+    // before the board, which comes from the fan-out thread
+    if (conn->binary) {
+        uint8_t st[5] = { ST_WATCHING };
+        uint32_t id = htonl((uint32_t)rid);
+        memcpy(st + 1, &id, 4);
+        send_bin(conn, P_STATUS, st, sizeof(st));
+    } else {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "Watching room %d. /watch <room> switches tables.\n", rid);
+        send_str(conn, msg);
+    }
 
-        if (bytes <= 0) {
-            //terminal display
-            printf("Player %d disconnected.\n", human_player_number);
+    conn->state = CONN_WATCHING;
+    atomic_store_explicit(&conn->deadline, 0, memory_order_relaxed); // spectators may sit quietly
+    watch_join(conn, rid);
+}
 
-            pthread_mutex_lock(&gameData->board_mutex);
-            gameData->player_active[player_id] = false;
-            gameData->client_sockets[player_id] = -1;
-            gameData->player_count--;
-            pthread_mutex_unlock(&gameData->board_mutex);
+static void send_game_prompt(struct Conn *conn) {
+    char p[256];
+    size_t start = (size_t)snprintf(p, sizeof(p), "Choose a game (");
+    size_t used = start;
+    for (int i = 0; i < rule_count && used < sizeof(p); i++) {
+        used += (size_t)snprintf(p + used, sizeof(p) - used, i ? "/%s" : "%s", rule_sets[i].name);
+    }
+    if (conn->binary) {
+        if (used >= sizeof(p)) used = sizeof(p) - 1;
+        p[used] = '\0';
+        send_bin_prompt(conn, PROMPT_GAME, p + start);
+        return;
+    }
+    if (used < sizeof(p)) snprintf(p + used, sizeof(p) - used, "): ");
+    send_str(conn, p);
+}
 
-            //write to game log
-            snprintf(logBuf, sizeof(logBuf), "Player %d disconnected.", human_player_number);
-            log_message(logBuf);
-            break;
-        }
+static int on_name(struct Conn *conn, const char *buf) {
+    // player input thier name
+    snprintf(conn->name, sizeof(conn->name), "%.31s", buf); // limit to 31 chars
 
-        buf[bytes] = '\0';
-        trim_newline(buf);
+    // only ask for a game when the server offers more than one
+    if (rule_count > 1) {
+        conn->state = CONN_GAME;
+        send_game_prompt(conn);
+        return 1;
+    }
+    return queue_player(conn, &rule_sets[0]);
+}
 
-        pthread_mutex_lock(&gameData->board_mutex);
+static int on_game(struct Conn *conn, const char *buf) {
+    // empty line picks the default (first) rule set
+    const struct Rules *rules = buf[0] ? rules_find(buf) : &rule_sets[0];
+    if (!rules) {
+        reply(conn, ST_UNKNOWN_GAME, "Unknown game.\n");
+        send_game_prompt(conn);
+        return 1;
+    }
+    return queue_player(conn, rules);
+}
 
-        // If round already ended, ignore moves
-        if (gameData->round_over) {
-            pthread_mutex_unlock(&gameData->board_mutex);
-            send_str(client_socket, "Round already ended. Please wait for reset...\n");
-            continue;
-        }
+// upper lower case both is acceptable // will only show upper case in board
+static bool valid_symbol(struct Conn *conn, const struct Rules *rules, char sym) {
+    if (sym && strchr(rules->symbols, sym)) return true;
+    char msg[80];
+    snprintf(msg, sizeof(msg), "Invalid symbol. Please choose one of %s.\n", rules->symbols);
+    reply(conn, ST_BAD_SYMBOL, msg);
+    send_symbol_prompt(conn, rules);
+    return false;
+}
 
-        // Must be your turn
-        if (gameData->current_turn_id != player_id) {
-            pthread_mutex_unlock(&gameData->board_mutex);
-            send_str(client_socket, "It is not your turn. Please wait...\n");
-            continue;
-        }
+static void on_symbol(struct Conn *conn, const char *buf) {
+    struct Room *room = conn->room;
+    const struct Rules *rules = room->rules;
 
-        // rows and cols init
-        int r, c;
+    char sym = (char)toupper((unsigned char)buf[0]);
+    if (!valid_symbol(conn, rules, sym)) return;
 
-        // limit the number input 0<x<17 (4x4)
-        if (!parse_grid_number(buf, &r, &c)) {
-            pthread_mutex_unlock(&gameData->board_mutex);
-            send_str(client_socket, "Invalid input. Please enter a grid number.\n");
-            send_prompt(client_socket, BOARD_N * BOARD_N);
-            continue;
-        }
+    // check if taken 
+    pthread_mutex_lock(&room->board_mutex);
+    if (room->clients[conn->seat] != conn) { // the seat moved to a newer connection
+        pthread_mutex_unlock(&room->board_mutex);
+        return;
+    }
+    int taken = symbol_taken(room, sym);
+    if (!taken) {
+        room->player_symbol[conn->seat] = sym;
+        wal_record_locked(room, WAL_SYMBOL, conn->seat, sym, 0);
+    }
+    pthread_mutex_unlock(&room->board_mutex);
 
-        // Validate spot 
-        // check if taken -> not '.' anymore
-        if (gameData->board[r][c] != EMPTY_CELL) {
-            pthread_mutex_unlock(&gameData->board_mutex);
-            send_str(client_socket, "Invalid move. Spot taken.\n");
-            //  THIS is where your bug was: it must NOT say 1-9.
-            send_prompt(client_socket, BOARD_N * BOARD_N);
-            continue;
-        }
+    if (taken) {
+        reply(conn, ST_SYMBOL_TAKEN, "That symbol is already taken. Choose another.\n");
+        send_symbol_prompt(conn, rules);
+        return;
+    }
 
-        // Place move
-        char my_sym = gameData->player_symbol[player_id];
-        gameData->board[r][c] = my_sym;
+    conn->state = CONN_PLAYING;
+    send_symbol_ok(conn, room, conn->seat, sym);
 
-        snprintf(logBuf, sizeof(logBuf), "Player %d placed %c at (%d,%d)", human_player_number, my_sym, r, c);
-        log_message(logBuf);
+    pthread_mutex_lock(&room->board_mutex);
+    room_try_start_locked(room);
+    room_unlock(room);
+}
 
-        // each round will check win and draw after place
-        // Win 
-        if (check_win(gameData->board, my_sym)) {
+// a symbol picked while queued: kept for the table, or, when the seat
+// was dealt meanwhile, picked there
+static void on_queued_symbol(struct Conn *conn, const char *buf) {
+    char sym = (char)toupper((unsigned char)buf[0]);
+    if (!valid_symbol(conn, conn->match_rules, sym)) return;
+
+    if (match_prefer(conn, sym)) {
+        char msg[80];
+        snprintf(msg, sizeof(msg), "You will be %c if nobody at your table has it. Still looking...\n", sym);
+        reply(conn, ST_MATCHING, msg);
+        return;
+    }
+    match_adopt(conn, true);
+    if (conn->state == CONN_SYMBOL) on_symbol(conn, buf);
+}
 
-            strcpy(gameData->scores[player_id].name, gameData->player_name[player_id]);
-            gameData->scores[player_id].wins++;
+// receive grid moves; cell is 0-based, -1 if the input didn't parse
+static void play_move(struct Conn *conn, int cell) {
+    struct Room *room = conn->room;
+    int player_id = conn->seat;
 
-            save_scores(); // udpate the scores.txt
+    pthread_mutex_lock(&room->board_mutex);
+
+    // the seat moved to a newer connection (/resume), this one is closing
+    if (room->clients[player_id] != conn) {
+        room_unlock(room);
+        return;
+    }
 
-            gameData->round_over = true;
-            gameData->turn_complete = true; // lets scheduler broadcast update
-            pthread_mutex_unlock(&gameData->board_mutex);
+    // If round already ended, ignore moves
+    if (room->round_over) {
+        room_unlock(room);
+        metrics_count(MC_MOVES_REJECTED, 1);
+        reply(conn, ST_ROUND_OVER, "Round already ended. Please wait for reset...\n");
+        return;
+    }
+
+    // Must be your turn
+    if (room->current_turn_id != player_id) {
+        room_unlock(room);
+        metrics_count(MC_MOVES_REJECTED, 1);
+        reply(conn, ST_NOT_YOUR_TURN, "It is not your turn. Please wait...\n");
+        return;
+    }
+
+    // limit the number input 0<=cell<n*n
+    int n = room->rules->n;
+    if (cell < 0 || cell >= n * n) {
+        room_unlock(room);
+        metrics_count(MC_MOVES_REJECTED, 1);
+        reply(conn, ST_BAD_MOVE, "Invalid input. Please enter a grid number.\n");
+        send_prompt(conn, n * n);
+        return;
+    }
+
+    // Validate spot 
+    // check if taken -> not '.' anymore
+    if (room->board[cell] != EMPTY_CELL) {
+        room_unlock(room);
+        metrics_count(MC_MOVES_REJECTED, 1);
+        reply(conn, ST_CELL_TAKEN, "Invalid move. Spot taken.\n");
+        //  THIS is where your bug was: it must NOT say 1-9.
+        send_prompt(conn, n * n);
+        return;
+    }
+
+    // Place move
+    // each round will check win and draw after place
+    enum MoveResult res = room_place_locked(room, player_id, cell);
+
+    // Win 
+    if (res == MOVE_WIN) {
+        reply(conn, ST_WON, "You won this round!\n");
+        room_move_done_locked(room); // arms the reset
+        room_unlock(room);
+        return;
+    }
 
-            send_str(client_socket, "You won this round!\n");
-            continue;
+    // Draw
+    if (res == MOVE_DRAW) {
+        reply(conn, ST_DRAW, "Draw! No empty spots left.\n");
+        room_move_done_locked(room);
+        room_unlock(room);
+        return;
+    }
+
+    // Normal continue: next board + whose turn goes out right away
+    reply(conn, ST_ACCEPTED, "Move accepted.\n");
+    room_move_done_locked(room);
+    room_unlock(room);
+}
+
+static void on_move(struct Conn *conn, const char *buf) {
+    long long start = metrics_now();
+    int r, c;
+    int n = conn->room->rules->n; // fixed for the room's lifetime
+    play_move(conn, parse_grid_number(buf, n, &r, &c) ? r * n + c : -1);
+    metrics_time(MO_MOVE, start);
+}
+
+/* ---------- leaderboard queries ---------- */
+
+// rows for a query; the name defaults to the asker's own
+static size_t run_query(struct Conn *conn, enum QueryKind kind, size_t count, const char *name,
+                        struct RankEntry *out, uint32_t *total) {
+    *total = 0;
+    if (!name[0]) name = conn->name;
+    switch (kind) {
+    case QUERY_TOP:
+        if (count == 0) count = RANK_TOP_DEFAULT;
+        if (count > RANK_TOP_MAX) count = RANK_TOP_MAX;
+        return scores_top(out, count, total);
+    case QUERY_RANK:   return scores_around(name, 0, out, total);
+    case QUERY_AROUND: return scores_around(name, RANK_AROUND, out, total);
+    }
+    return 0;
+}
+
+// P_RANKS frames, as many rows per frame as fit
+static void send_ranks(struct Conn *conn, const struct RankEntry *rows, size_t cnt, uint32_t total) {
+    uint8_t p[PROTO_MAX_PAYLOAD];
+    uint32_t t = htonl(total);
+    size_t i = 0;
+    do {
+        memcpy(p, &t, 4);
+        size_t len = 4;
+        for (; i < cnt; i++) {
+            size_t nl = strnlen(rows[i].name, NAME_LEN - 1);
+            if (len + 9 + nl > sizeof(p)) break;
+            uint32_t rank = htonl(rows[i].rank), wins = htonl(rows[i].wins);
+            memcpy(p + len, &rank, 4);
+            memcpy(p + len + 4, &wins, 4);
+            p[len + 8] = (uint8_t)nl;
+            memcpy(p + len + 9, rows[i].name, nl);
+            len += 9 + nl;
         }
+        send_bin(conn, P_RANKS, p, len);
+    } while (i < cnt);
+}
+
+// "/top [k]", "/rank [name]", "/around [name]"
+static void on_command(struct Conn *conn, const char *buf) {
+    char cmd[16];
+    int used = 0;
+    if (sscanf(buf, "/%15s %n", cmd, &used) != 1) cmd[0] = '\0';
+    const char *arg = buf + used;
+
+    enum QueryKind kind;
+    if (strcmp(cmd, "top") == 0) kind = QUERY_TOP;
+    else if (strcmp(cmd, "rank") == 0) kind = QUERY_RANK;
+    else if (strcmp(cmd, "around") == 0) kind = QUERY_AROUND;
+    else {
+        send_str(conn, "Commands: /top [count], /rank [name], /around [name], /resume <token>, /watch [room]\n");
+        return;
+    }
+
+    struct RankEntry rows[RANK_TOP_MAX];
+    uint32_t total;
+    size_t cnt = run_query(conn, kind, kind == QUERY_TOP ? (size_t)atoi(arg) : 0,
+                           kind == QUERY_TOP ? "" : arg, rows, &total);
+
+    char out[RANK_TOP_MAX * (NAME_LEN + 32) + 64];
+    size_t len = 0;
+    if (cnt == 0 && kind != QUERY_TOP) {
+        // no record: the asker just hasn't won yet, any other name is unknown
+        const char *who = arg[0] ? arg : conn->name;
+        if (strcmp(who, conn->name) == 0) len = (size_t)snprintf(out, sizeof(out), "%s has no wins yet.\n", who);
+        else len = (size_t)snprintf(out, sizeof(out), "Unknown player: %s.\n", who);
+    }
+    for (size_t i = 0; i < cnt; i++) {
+        len += (size_t)snprintf(out + len, sizeof(out) - len, "#%-8u %-31s %u\n",
+                                rows[i].rank, rows[i].name, rows[i].wins);
+    }
+    len += (size_t)snprintf(out + len, sizeof(out) - len, "(%u players ranked)\n", total);
+    conn_send_text(conn, out, len);
+}
 
-        // Draw
-        if (check_draw(gameData->board)) {
-            gameData->draw = true;
-            gameData->round_over = true;
-            gameData->turn_complete = true;
-            pthread_mutex_unlock(&gameData->board_mutex);
+/* ---------- main handler ---------- */
 
-            send_str(client_socket, "Draw! No empty spots left.\n");
-            continue;
+// one text command
+static int on_text(struct Conn *conn, char *buf) {
+    trim_newline(buf);
+    if (strncmp(buf, "/resume", 7) == 0) {
+        on_resume(conn, strtoull(buf + 7, NULL, 16));
+        return 1;
+    }
+    if (strncmp(buf, "/watch", 6) == 0) {
+        char *end;
+        long id = strtol(buf + 6, &end, 10);
+        on_watch(conn, end == buf + 6 || id < 0 ? -1 : id > MAX_ROOMS ? MAX_ROOMS : (int)id);
+        return 1;
+    }
+    if (buf[0] == '/') {
+        on_command(conn, buf);
+        return 1;
+    }
+
+    switch (conn->state) {
+    case CONN_NAME:     return on_name(conn, buf);
+    case CONN_GAME:     return on_game(conn, buf);
+    case CONN_SYMBOL:   on_symbol(conn, buf); break;
+    case CONN_QUEUED:   on_queued_symbol(conn, buf); break;
+    case CONN_PLAYING:  on_move(conn, buf);   break;
+    case CONN_WATCHING: send_str(conn, "You are watching. /watch <room> switches tables, /top shows the leaderboard.\n"); break;
+    }
+    return 1;
+}
+
+// one binary frame; frames that don't fit the current state are ignored
+static int on_frame(struct Conn *conn, uint8_t type, const char *payload, size_t len) {
+    char text[PROTO_MAX_PAYLOAD + 1];
+    memcpy(text, payload, len);
+    text[len] = '\0';
+
+    switch (type) {
+    case P_NAME:   if (conn->state == CONN_NAME) return on_name(conn, text);   break;
+    case P_GAME:   if (conn->state == CONN_GAME) return on_game(conn, text);   break;
+    case P_SYMBOL:
+        if (conn->state == CONN_SYMBOL) on_symbol(conn, text);
+        else if (conn->state == CONN_QUEUED) on_queued_symbol(conn, text);
+        break;
+    case P_MOVE:
+        if (conn->state == CONN_PLAYING && len >= 1) {
+            long long start = metrics_now();
+            play_move(conn, (uint8_t)payload[0]);
+            metrics_time(MO_MOVE, start);
+        }
+        break;
+    case P_RESYNC:
+        if (conn->room) send_snapshot(conn, conn->room);
+        else watch_resync(conn);
+        break;
+    case P_RESUME:
+        if (len >= 8) {
+            uint32_t hi, lo;
+            memcpy(&hi, payload, 4);
+            memcpy(&lo, payload + 4, 4);
+            on_resume(conn, ((uint64_t)ntohl(hi) << 32) | ntohl(lo));
+        }
+        break;
+    case P_WATCH:
+        if (len >= 4) {
+            uint32_t id;
+            memcpy(&id, payload, 4);
+            id = ntohl(id);
+            on_watch(conn, id == 0xffffffff ? -1 : id > MAX_ROOMS ? MAX_ROOMS : (int)id);
+        }
+        break;
+    case P_QUERY:
+        if (len >= 2) {
+            struct RankEntry rows[RANK_TOP_MAX];
+            uint32_t total;
+            size_t cnt = run_query(conn, (uint8_t)payload[0], (uint8_t)payload[1], text + 2, rows, &total);
+            send_ranks(conn, rows, cnt, total);
         }
+        break;
+    }
+    return 1;
+}
+
+// PROTO_MAGIC + version as the very first bytes switches to binary.
+// returns -1 to close, 0 if still undecided, 1 when settled
+static int negotiate(struct Conn *conn) {
+    size_t n = conn->inlen < PROTO_MAGIC_LEN ? conn->inlen : PROTO_MAGIC_LEN;
+    if (memcmp(conn->inbuf, PROTO_MAGIC, n) != 0) return 1;   // plain text
+    if (conn->inlen < PROTO_MAGIC_LEN + 1) return 0;          // hello still arriving
+
+    uint8_t version = (uint8_t)conn->inbuf[PROTO_MAGIC_LEN];
+    if (version != PROTO_VERSION) {
+        send_str(conn, "Unsupported protocol version.\n");
+        return -1;
+    }
+
+    conn->binary = true;
+    conn->inlen -= PROTO_MAGIC_LEN + 1;
+    memmove(conn->inbuf, conn->inbuf + PROTO_MAGIC_LEN + 1, conn->inlen);
+
+    char hello[PROTO_MAGIC_LEN + 1];
+    memcpy(hello, PROTO_MAGIC, PROTO_MAGIC_LEN);
+    hello[PROTO_MAGIC_LEN] = PROTO_VERSION;
+    conn_send_text(conn, hello, sizeof(hello));
+    send_bin_prompt(conn, PROMPT_NAME, NULL);
+    return 1;
+}
+
+// text: one command per line, so several can arrive in one read and
+// one can span reads. `fresh` bytes at the end of inbuf are new
+static int text_lines(struct Conn *conn, size_t fresh) {
+    size_t start = 0, scan = conn->inlen - fresh; // older bytes hold no '\n'
+    char *nl;
+
+    while ((nl = memchr(conn->inbuf + scan, '\n', conn->inlen - scan)) != NULL) {
+        *nl = '\0';
+        int keep = on_text(conn, conn->inbuf + start);
+        scan = start = (size_t)(nl - conn->inbuf) + 1;
+        if (!keep) return 0;
+    }
+
+    if (start == 0 && conn->inlen == sizeof(conn->inbuf) - 1) {
+        // a full buffer and no newline: take it as one command
+        conn->inbuf[conn->inlen] = '\0';
+        conn->inlen = 0;
+        return on_text(conn, conn->inbuf);
+    }
+
+    // keep a partial line for the next read
+    conn->inlen -= start;
+    memmove(conn->inbuf, conn->inbuf + start, conn->inlen);
+    return 1;
+}
+
+// binary: every complete frame in the buffer
+static int bin_frames(struct Conn *conn) {
+    size_t off = 0;
+    while (conn->inlen - off >= PROTO_HEADER) {
+        const uint8_t *h = (const uint8_t *)conn->inbuf + off;
+        size_t plen = ((size_t)h[1] << 8) | h[2];
+        if (plen > PROTO_MAX_PAYLOAD) return 0; // garbage, drop the client
+        if (conn->inlen - off < PROTO_HEADER + plen) break;
+
+        int keep = on_frame(conn, h[0], (const char *)h + PROTO_HEADER, plen);
+        off += PROTO_HEADER + plen;
+        if (!keep) return 0;
+    }
+
+    // keep a partial frame for the next read
+    conn->inlen -= off;
+    memmove(conn->inbuf, conn->inbuf + off, conn->inlen);
+    return 1;
+}
+
+// `len` new bytes at conn->inbuf + conn->inlen, runs on the connection's
+// reactor thread. returns 0 when the connection should be closed
+int handle_client(struct Conn *conn, size_t len) {
+    conn->inlen += len;
 
-        // Normal continue
-        gameData->turn_complete = true;
-        pthread_mutex_unlock(&gameData->board_mutex);
+    // the matchmaker may have dealt a seat since the last read
+    if (conn->state == CONN_QUEUED) match_adopt(conn, false);
 
-        send_str(client_socket, "Move accepted.\n");
-        // scheduler will show next board + whose turn
+    if (!conn->binary && conn->state == CONN_NAME && conn->room == NULL) {
+        int rc = negotiate(conn);
+        if (rc <= 0) return rc == 0;
     }
 
-    close(client_socket);
-    exit(0);
+    int keep = conn->binary ? bin_frames(conn) : text_lines(conn, len);
+
+    // seated: the idle limit starts over with every read
+    if (conn->room) {
+        atomic_store_explicit(&conn->deadline, idle_ms > 0 ? now_ms() + idle_ms : 0, memory_order_relaxed);
+    }
+    return keep;
 }
@@ -0,0 +1,121 @@
+#include "game.h"
+
+// Bitboard engine: each seat's marks are one bit per cell
+// (cell = row * n + col). Win lines are precomputed masks, so a win
+// check is a few AND/compare ops on the lines through the last move,
+// and a draw is a popcount of the occupied board.
+
+/* ---------- bitboard helpers ---------- */
+
+void bb_clear(bitboard_t *b) {
+    memset(b, 0, sizeof(*b));
+}
+
+void bb_set(bitboard_t *b, int cell) {
+    b->w[cell >> 6] |= 1ULL << (cell & 63);
+}
+
+bool bb_test(const bitboard_t *b, int cell) {
+    return (b->w[cell >> 6] >> (cell & 63)) & 1;
+}
+
+int bb_popcount(const bitboard_t *b) {
+    int n = 0;
+    for (int i = 0; i < BB_WORDS; i++) n += __builtin_popcountll(b->w[i]);
+    return n;
+}
+
+/* ---------- win tables ---------- */
+
+static void add_line(struct WinTable *t, int r, int c, int dr, int dc) {
+    bitboard_t *m = &t->lines[t->line_count];
+    bb_clear(m);
+    for (int i = 0; i < t->k; i++) {
+        bb_set(m, (r + i * dr) * t->n + (c + i * dc));
+    }
+    t->line_count++;
+}
+
+// out of memory halfway through engine_build(): nothing is kept
+static int build_failed(struct WinTable *t) {
+    free(t->cell_start);
+    free(t->lines);
+    t->cell_start = NULL;
+    t->lines = NULL;
+    return -1;
+}
+
+// all k-long runs on an n x n board: rows, columns and both diagonals
+int engine_build(struct WinTable *t, int n, int k) {
+    if (n < 1 || n > MAX_BOARD_N || k < 1 || k > n) return -1;
+
+    memset(t, 0, sizeof(*t));
+    t->n = n;
+    t->k = k;
+    t->cells = n * n;
+
+    int span = n - k + 1;
+    int max_lines = 2 * n * span + 2 * span * span;
+    t->lines = calloc((size_t)max_lines, sizeof(bitboard_t));
+    if (!t->lines) return -1;
+
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) {
+            if (c + k <= n) add_line(t, r, c, 0, 1);                 // horizontal
+            if (r + k <= n) add_line(t, r, c, 1, 0);                 // vertical
+            if (r + k <= n && c + k <= n) add_line(t, r, c, 1, 1);   // main diag
+            if (r + k <= n && c - k + 1 >= 0) add_line(t, r, c, 1, -1); // anti diag
+        }
+    }
+
+    // per-cell index of the lines through it (CSR layout)
+    t->cell_start = calloc((size_t)t->cells + 1, sizeof(int));
+    if (!t->cell_start) return build_failed(t);
+    int total = 0;
+    for (int cell = 0; cell < t->cells; cell++) {
+        t->cell_start[cell] = total;
+        for (int l = 0; l < t->line_count; l++) {
+            if (bb_test(&t->lines[l], cell)) total++;
+        }
+    }
+    t->cell_start[t->cells] = total;
+
+    t->cell_lines = calloc((size_t)total, sizeof(int));
+    if (!t->cell_lines) return build_failed(t);
+    int at = 0;
+    for (int cell = 0; cell < t->cells; cell++) {
+        for (int l = 0; l < t->line_count; l++) {
+            if (bb_test(&t->lines[l], cell)) t->cell_lines[at++] = l;
+        }
+    }
+    return 0;
+}
+
+/* ---------- queries ---------- */
+
+static bool covers(const bitboard_t *marks, const bitboard_t *line) {
+    for (int i = 0; i < BB_WORDS; i++) {
+        if ((marks->w[i] & line->w[i]) != line->w[i]) return false;
+    }
+    return true;
+}
+
+// did the move at `cell` complete a line? only lines through it can be new
+bool engine_wins_at(const struct WinTable *t, const bitboard_t *marks, int cell) {
+    for (int i = t->cell_start[cell]; i < t->cell_start[cell + 1]; i++) {
+        if (covers(marks, &t->lines[t->cell_lines[i]])) return true;
+    }
+    return false;
+}
+
+// any line at all, for callers that don't know the last move
+bool engine_wins(const struct WinTable *t, const bitboard_t *marks) {
+    for (int l = 0; l < t->line_count; l++) {
+        if (covers(marks, &t->lines[l])) return true;
+    }
+    return false;
+}
+
+bool engine_full(const struct WinTable *t, const bitboard_t *occupied) {
+    return bb_popcount(occupied) >= t->cells;
+}
@@ -0,0 +1,283 @@
+#include "game.h"
+#include <sys/uio.h>
+
+// Outgoing side of every connection. Each Conn has a bounded queue of
+// (Frame, suffix) pairs; any thread may queue to it, the bytes go out
+// with non-blocking sendmsg() of up to OUT_IOV iovecs, and whatever the
+// socket doesn't take waits for EPOLLOUT on the owning reactor.
+//
+// Broadcasts made while a room is locked only land in a per-thread
+// outbox; room_unlock() delivers them after the room lock is dropped,
+// so a slow socket never holds up the game.
+//
+// Frames are small (< 8 KB), so MSG_ZEROCOPY would cost more in page
+// pinning and completion handling than the copy it saves.
+
+#define OUT_IOV 64
+#define OUTBOX_CAP (MAX_PLAYERS * 8)
+
+static enum SlowPolicy slow_policy = SLOW_COALESCE;
+
+static _Atomic unsigned long long stat_dropped;
+static _Atomic unsigned long long stat_coalesced;
+static _Atomic unsigned long long stat_kicked;
+
+// deliveries queued under a room lock
+struct Delivery {
+    struct Conn *conn;
+    struct Frame *frame;
+    const char *suffix;
+    size_t suffix_len;
+    bool board;
+};
+
+static __thread struct Delivery outbox[OUTBOX_CAP];
+static __thread int outbox_len;
+
+void fanout_set_policy(enum SlowPolicy policy) {
+    slow_policy = policy;
+}
+
+void fanout_stats(unsigned long long *dropped, unsigned long long *coalesced, unsigned long long *kicked) {
+    *dropped = atomic_load(&stat_dropped);
+    *coalesced = atomic_load(&stat_coalesced);
+    *kicked = atomic_load(&stat_kicked);
+}
+
+/* ---------- connection lifetime ---------- */
+
+struct Conn *conn_new(int fd) {
+    struct Conn *conn = calloc(1, sizeof(*conn));
+    if (!conn) return NULL;
+    conn->fd = fd;
+    conn->seat = -1;
+    conn->watch_room = -1;
+    atomic_init(&conn->refs, 1); // the reactor's
+    pthread_mutex_init(&conn->out_lock, NULL);
+    return conn;
+}
+
+struct Conn *conn_ref(struct Conn *conn) {
+    atomic_fetch_add_explicit(&conn->refs, 1, memory_order_relaxed);
+    return conn;
+}
+
+static void out_clear_locked(struct Conn *conn) {
+    while (conn->out_len > 0) {
+        frame_unref(conn->outq[conn->out_head].frame);
+        conn->out_head = (conn->out_head + 1) % OUTQ_CAP;
+        conn->out_len--;
+    }
+    conn->out_off = 0;
+}
+
+// the fd is closed only here, so a late delivery can never hit a reused fd
+void conn_unref(struct Conn *conn) {
+    if (atomic_fetch_sub_explicit(&conn->refs, 1, memory_order_acq_rel) != 1) return;
+
+    out_clear_locked(conn);
+    pthread_mutex_destroy(&conn->out_lock);
+    close(conn->fd);
+    free(conn);
+    metrics_count(MC_CLOSED, 1);
+}
+
+// reactor is done with it: nothing more gets queued. The handshake/idle
+// timer's ref goes here, unless the timer is firing: its callback sees
+// conn_closed() and drops it
+void conn_shutdown(struct Conn *conn) {
+    pthread_mutex_lock(&conn->out_lock);
+    conn->out_closed = true;
+    out_clear_locked(conn);
+    pthread_mutex_unlock(&conn->out_lock);
+
+    if (timer_cancel(&conn->timer)) conn_unref(conn);
+}
+
+bool conn_closed(struct Conn *conn) {
+    pthread_mutex_lock(&conn->out_lock);
+    bool closed = conn->out_closed;
+    pthread_mutex_unlock(&conn->out_lock);
+    return closed;
+}
+
+/* ---------- queue ---------- */
+
+static size_t msg_len(const struct OutMsg *m) {
+    return (m->frame ? m->frame->len : 0) + m->suffix_len;
+}
+
+// write as much as the socket takes; out_lock held
+static void flush_locked(struct Conn *conn) {
+    while (conn->out_len > 0) {
+        struct iovec iov[OUT_IOV];
+        int cnt = 0;
+        size_t skip = conn->out_off; // only the head can be partly sent
+
+        for (int i = 0; i < conn->out_len && cnt + 2 <= OUT_IOV; i++) {
+            const struct OutMsg *m = &conn->outq[(conn->out_head + i) % OUTQ_CAP];
+            size_t flen = m->frame ? m->frame->len : 0;
+
+            if (skip < flen) {
+                iov[cnt].iov_base = m->frame->data + skip;
+                iov[cnt].iov_len = flen - skip;
+                cnt++;
+                skip = 0;
+            } else {
+                skip -= flen;
+            }
+            if (skip < m->suffix_len) {
+                iov[cnt].iov_base = (char *)m->suffix + skip;
+                iov[cnt].iov_len = m->suffix_len - skip;
+                cnt++;
+            }
+            skip = 0;
+        }
+
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = (size_t)cnt };
+        ssize_t w = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { // EPOLLOUT resumes
+                metrics_count(MC_SEND_BLOCKED, 1);
+                return;
+            }
+            // dead peer, the reactor sees it on the read side
+            conn->out_closed = true;
+            out_clear_locked(conn);
+            return;
+        }
+
+        metrics_count(MC_BYTES_SENT, (unsigned long long)w);
+        conn->out_off += (size_t)w;
+        while (conn->out_len > 0) {
+            struct OutMsg *m = &conn->outq[conn->out_head];
+            size_t len = msg_len(m);
+            if (conn->out_off < len) break;
+            conn->out_off -= len;
+            frame_unref(m->frame);
+            conn->out_head = (conn->out_head + 1) % OUTQ_CAP;
+            conn->out_len--;
+        }
+    }
+}
+
+// queue is full and a new board arrived: queued boards nobody has
+// started reading are stale, the new one is all they need. Statuses
+// and deltas stay. returns slots freed
+static int coalesce_locked(struct Conn *conn) {
+    int kept = 0, freed = 0;
+    for (int i = 0; i < conn->out_len; i++) {
+        struct OutMsg *m = &conn->outq[(conn->out_head + i) % OUTQ_CAP];
+        bool started = (i == 0 && conn->out_off > 0);
+        if (m->board && !started) {
+            frame_unref(m->frame);
+            freed++;
+            continue;
+        }
+        conn->outq[(conn->out_head + kept) % OUTQ_CAP] = *m;
+        kept++;
+    }
+    conn->out_len = kept;
+    return freed;
+}
+
+// queue one message (frame and/or static suffix) and push what we can now.
+// board: a full screen, superseded by the next one
+void conn_send(struct Conn *conn, struct Frame *frame, const char *suffix, size_t suffix_len, bool board) {
+    pthread_mutex_lock(&conn->out_lock);
+    if (conn->out_closed) {
+        pthread_mutex_unlock(&conn->out_lock);
+        return;
+    }
+
+    if (conn->out_len == OUTQ_CAP) {
+        int freed = 0;
+        if (slow_policy == SLOW_COALESCE && board) {
+            freed = coalesce_locked(conn);
+            atomic_fetch_add_explicit(&stat_coalesced, (unsigned long long)freed, memory_order_relaxed);
+        }
+        if (slow_policy == SLOW_DISCONNECT) {
+            // the reactor sees EOF and closes it normally
+            atomic_fetch_add_explicit(&stat_kicked, 1, memory_order_relaxed);
+            conn->out_closed = true;
+            out_clear_locked(conn);
+            shutdown(conn->fd, SHUT_RDWR);
+            pthread_mutex_unlock(&conn->out_lock);
+            return;
+        }
+        if (freed == 0) {
+            atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+            pthread_mutex_unlock(&conn->out_lock);
+            return;
+        }
+    }
+
+    struct OutMsg *m = &conn->outq[(conn->out_head + conn->out_len) % OUTQ_CAP];
+    m->frame = frame ? frame_ref(frame) : NULL;
+    m->suffix = suffix;
+    m->suffix_len = suffix_len;
+    m->board = board;
+    conn->out_len++;
+
+    flush_locked(conn);
+    pthread_mutex_unlock(&conn->out_lock);
+}
+
+// copies `text`, for replies built on the stack
+void conn_send_text(struct Conn *conn, const char *text, size_t len) {
+    struct Frame *f = frame_new(len);
+    memcpy(f->data, text, len);
+    conn_send(conn, f, NULL, 0, false);
+    frame_unref(f);
+}
+
+// EPOLLOUT on the owning reactor
+void conn_flush(struct Conn *conn) {
+    pthread_mutex_lock(&conn->out_lock);
+    flush_locked(conn);
+    pthread_mutex_unlock(&conn->out_lock);
+}
+
+/* ---------- deferred broadcast ---------- */
+
+// called with a room locked; sent once the caller calls room_unlock().
+// board as for conn_send(): full screens and P_BOARDs only
+void outbox_add(struct Conn *conn, struct Frame *frame, const char *suffix, size_t suffix_len, bool board) {
+    if (outbox_len == OUTBOX_CAP) {
+        conn_send(conn, frame, suffix, suffix_len, board); // never expected, still non-blocking
+        return;
+    }
+    struct Delivery *d = &outbox[outbox_len++];
+    d->conn = conn_ref(conn);
+    d->frame = frame_ref(frame);
+    d->suffix = suffix;
+    d->suffix_len = suffix_len;
+    d->board = board;
+}
+
+void outbox_flush(void) {
+    long long start = metrics_now();
+    for (int i = 0; i < outbox_len; i++) {
+        struct Delivery *d = &outbox[i];
+        conn_send(d->conn, d->frame, d->suffix, d->suffix_len, d->board);
+        frame_unref(d->frame);
+        conn_unref(d->conn);
+    }
+    outbox_len = 0;
+    metrics_time(MO_BROADCAST, start);
+}
+
+// hand-over-hand: send_mutex is taken before the room is released, so
+// the next thread to lock the room flushes after us and every client
+// sees the room's broadcasts in the order they were made
+void room_unlock(struct Room *room) {
+    if (outbox_len == 0) {
+        pthread_mutex_unlock(&room->board_mutex);
+        return;
+    }
+    pthread_mutex_lock(&room->send_mutex);
+    pthread_mutex_unlock(&room->board_mutex);
+    outbox_flush();
+    pthread_mutex_unlock(&room->send_mutex);
+}
@@ -0,0 +1,169 @@
+#include "game.h"
+
+// Order-statistic skip list ordered by wins (high first), then name.
+// Every link also stores how many nodes it jumps (span), so the rank of
+// a node is the sum of the spans along its search path and the node at
+// a rank is found the same way; both are O(log n). The span bookkeeping
+// is the one Redis uses for sorted sets: a link to NULL spans to the
+// end of the list.
+//
+// No locking here, the owner (persistence.c) holds score_mutex.
+
+#define LB_P 4      // a node reaches the next level with probability 1/LB_P
+
+static int key_cmp(uint32_t wins, const char *name, const struct RankNode *n) {
+    if (wins != n->wins) return wins > n->wins ? -1 : 1;
+    return strcmp(name, n->name);
+}
+
+static int random_level(struct Leaderboard *lb) {
+    uint64_t x = lb->rng; // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    lb->rng = x;
+
+    int level = 1;
+    while (level < LB_MAX_LEVEL && (x & (LB_P - 1)) == 0) {
+        level++;
+        x >>= 2;
+    }
+    return level;
+}
+
+static struct RankNode *node_alloc(int level) {
+    struct RankNode *n = malloc(sizeof(*n) + (size_t)level * sizeof(n->link[0]));
+    if (!n) { perror("leaderboard"); exit(1); }
+    n->level = (uint8_t)level;
+    n->dirty = false;
+    for (int i = 0; i < level; i++) {
+        n->link[i].next = NULL;
+        n->link[i].span = 0;
+    }
+    return n;
+}
+
+void lb_init(struct Leaderboard *lb) {
+    memset(lb, 0, sizeof(*lb));
+    lb->head = node_alloc(LB_MAX_LEVEL);
+    lb->head->name[0] = '\0';
+    lb->level = 1;
+    lb->rng = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < LB_MAX_LEVEL; i++) lb->tail[i] = lb->head;
+    lb->tail_ok = true;
+}
+
+// not linked yet, lb_insert() it
+struct RankNode *lb_node_new(struct Leaderboard *lb, const char *name, uint32_t wins) {
+    struct RankNode *n = node_alloc(random_level(lb));
+    snprintf(n->name, sizeof(n->name), "%s", name);
+    n->wins = wins;
+    return n;
+}
+
+// x sorts after every node: link it at the end in O(level), no search.
+// This is how a rank-ordered scores.db loads in linear time
+static void append(struct Leaderboard *lb, struct RankNode *x) {
+    uint32_t r = lb->count + 1;
+    if (x->level > lb->level) {
+        for (int i = lb->level; i < x->level; i++) lb->head->link[i].span = lb->count;
+        lb->level = x->level;
+    }
+    for (int i = 0; i < x->level; i++) {
+        lb->tail[i]->link[i].next = x;
+        lb->tail[i]->link[i].span = r - lb->tail_rank[i];
+        lb->tail[i] = x;
+        lb->tail_rank[i] = r;
+    }
+    for (int i = x->level; i < lb->level; i++) lb->tail[i]->link[i].span++;
+    lb->count++;
+}
+
+void lb_insert(struct Leaderboard *lb, struct RankNode *x) {
+    if (lb->tail_ok && (lb->count == 0 || key_cmp(x->wins, x->name, lb->tail[0]) > 0)) {
+        append(lb, x);
+        return;
+    }
+    lb->tail_ok = false; // tails would need fixing up, not worth it after the load
+
+    struct RankNode *update[LB_MAX_LEVEL];
+    uint32_t rank[LB_MAX_LEVEL];
+    struct RankNode *p = lb->head;
+    for (int i = lb->level - 1; i >= 0; i--) {
+        rank[i] = (i == lb->level - 1) ? 0 : rank[i + 1];
+        while (p->link[i].next && key_cmp(x->wins, x->name, p->link[i].next) > 0) {
+            rank[i] += p->link[i].span;
+            p = p->link[i].next;
+        }
+        update[i] = p;
+    }
+
+    if (x->level > lb->level) {
+        for (int i = lb->level; i < x->level; i++) {
+            rank[i] = 0;
+            update[i] = lb->head;
+            lb->head->link[i].span = lb->count;
+        }
+        lb->level = x->level;
+    }
+
+    for (int i = 0; i < x->level; i++) {
+        x->link[i].next = update[i]->link[i].next;
+        update[i]->link[i].next = x;
+        x->link[i].span = update[i]->link[i].span - (rank[0] - rank[i]);
+        update[i]->link[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = x->level; i < lb->level; i++) update[i]->link[i].span++;
+    lb->count++;
+}
+
+// unlinks x; it keeps its level and can be lb_insert()ed again
+void lb_remove(struct Leaderboard *lb, struct RankNode *x) {
+    lb->tail_ok = false;
+
+    struct RankNode *update[LB_MAX_LEVEL];
+    struct RankNode *p = lb->head;
+    for (int i = lb->level - 1; i >= 0; i--) {
+        while (p->link[i].next && key_cmp(x->wins, x->name, p->link[i].next) > 0) p = p->link[i].next;
+        update[i] = p;
+    }
+
+    for (int i = 0; i < lb->level; i++) {
+        if (update[i]->link[i].next == x) {
+            update[i]->link[i].span += x->link[i].span - 1;
+            update[i]->link[i].next = x->link[i].next;
+        } else {
+            update[i]->link[i].span--;
+        }
+    }
+    while (lb->level > 1 && lb->head->link[lb->level - 1].next == NULL) lb->level--;
+    lb->count--;
+}
+
+// 1-based
+uint32_t lb_rank(const struct Leaderboard *lb, const struct RankNode *x) {
+    uint32_t r = 0;
+    const struct RankNode *p = lb->head;
+    for (int i = lb->level - 1; i >= 0; i--) {
+        while (p->link[i].next && key_cmp(x->wins, x->name, p->link[i].next) >= 0) {
+            r += p->link[i].span;
+            p = p->link[i].next;
+        }
+        if (p == x) return r;
+    }
+    return 0; // not in the list
+}
+
+// node at 1-based rank, NULL past the end
+struct RankNode *lb_at(const struct Leaderboard *lb, uint32_t rank) {
+    uint32_t r = 0;
+    struct RankNode *p = lb->head;
+    for (int i = lb->level - 1; i >= 0; i--) {
+        while (p->link[i].next && r + p->link[i].span <= rank) {
+            r += p->link[i].span;
+            p = p->link[i].next;
+        }
+        if (r == rank) return rank ? p : NULL;
+    }
+    return NULL;
+}
@@ -1,38 +1,355 @@
 #include "game.h"
+#include <stdatomic.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <stddef.h>
+
+// Bounded lock-free ring (Vyukov style): every slot carries a sequence
+// number, producers claim slots with one CAS on enq_pos, the logger
+// thread claims them with deq_pos. No lock is shared between game
+// threads and the thread doing file I/O.
+//
+// game.log is binary: LOG_FILE_MAGIC, then struct LogRecord headers each
+// followed by `len` bytes of text. The logger drains the ring in batches
+// and writes each batch with one writev(). Use ./logdump to read it.
+
+#define LOG_BATCH 256       // records per writev (<= IOV_MAX)
+#define LOG_KEEP 5          // rotated files kept: game.log.1 .. game.log.5
+
+_Static_assert(offsetof(struct LogRecord, text) == LOG_RECORD_HEADER, "log header layout");
+
+struct LogSlot {
+    _Atomic size_t seq;
+    struct LogRecord rec;
+};
+
+static struct LogSlot *ring;
+static size_t ring_mask;
+static size_t wake_threshold;   // depth at which a producer wakes the logger
+static enum LogFullPolicy full_policy = LOG_FULL_DROP;
+
+// producer and consumer cursors on separate cache lines
+static _Alignas(64) _Atomic size_t enq_pos;
+static _Alignas(64) _Atomic size_t deq_pos;
+
+static _Alignas(64) _Atomic unsigned long long stat_written;    // by the logger thread, once in game.log
+static _Atomic unsigned long long stat_dropped;
+static _Atomic unsigned long long stat_overwritten;
+static _Atomic unsigned long long stat_high_water;
+
+// consumer sleeps on wake_fd, producers only write it while it sleeps
+static _Alignas(64) _Atomic int consumer_sleeping;
+static int wake_fd = -1;
+
+// LOG_FULL_BLOCK: producers facing a full ring sleep on full_cond, the
+// logger only takes full_mutex when full_waiters says someone does
+static _Alignas(64) _Atomic int full_waiters;
+static pthread_mutex_t full_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t full_cond = PTHREAD_COND_INITIALIZER;
+
+// rotation
+static long long rotate_bytes = LOG_ROTATE_BYTES_DEFAULT;
+static int rotate_secs = 0;
+
+// capacity is rounded up to a power of two
+void logger_init(size_t capacity, enum LogFullPolicy policy) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    ring = calloc(cap, sizeof(*ring));
+    if (!ring) { perror("logger ring"); exit(1); }
+    for (size_t i = 0; i < cap; i++) atomic_init(&ring[i].seq, i);
+
+    ring_mask = cap - 1;
+    wake_threshold = (cap / 2 < LOG_BATCH) ? cap / 2 : LOG_BATCH;
+    full_policy = policy;
+    atomic_init(&enq_pos, 0);
+    atomic_init(&deq_pos, 0);
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) { perror("eventfd"); exit(1); }
+}
+
+// max_bytes <= 0 disables size rotation, max_secs <= 0 disables time rotation
+void logger_set_rotation(long long max_bytes, int max_secs) {
+    rotate_bytes = max_bytes;
+    rotate_secs = max_secs;
+}
+
+void logger_wake(void) {
+    if (atomic_exchange(&consumer_sleeping, 0)) {
+        uint64_t one = 1;
+        ssize_t w = write(wake_fd, &one, sizeof(one));
+        (void)w;
+    }
+}
+
+/* ---------- ring ops ---------- */
+
+// claim the oldest record; safe from the logger thread and from
+// producers evicting under LOG_FULL_OVERWRITE
+static bool ring_pop(struct LogRecord *out) {
+    size_t pos = atomic_load_explicit(&deq_pos, memory_order_relaxed);
+    struct LogSlot *slot;
+    for (;;) {
+        slot = &ring[pos & ring_mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&deq_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            pos = atomic_load_explicit(&deq_pos, memory_order_relaxed);
+        }
+    }
+    if (out) memcpy(out, &slot->rec, LOG_RECORD_HEADER + slot->rec.len);
+    atomic_store_explicit(&slot->seq, pos + ring_mask + 1, memory_order_release);
+    return true;
+}
+
+static bool ring_full(void) {
+    size_t pos = atomic_load_explicit(&enq_pos, memory_order_relaxed);
+    size_t seq = atomic_load_explicit(&ring[pos & ring_mask].seq, memory_order_acquire);
+    return (intptr_t)seq - (intptr_t)pos < 0;
+}
+
+// LOG_FULL_BLOCK: until the logger has drained a batch. The caller
+// usually holds a room lock, so it sleeps rather than spin on a core.
+// The timeout only covers a logger that has already exited
+static void wait_for_space(void) {
+    pthread_mutex_lock(&full_mutex);
+    atomic_fetch_add(&full_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst); // pairs with the logger's, after its pops
+    if (ring_full()) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += LOG_FLUSH_MS * 1000000L;
+        if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+        pthread_cond_timedwait(&full_cond, &full_mutex, &until);
+    }
+    atomic_fetch_sub(&full_waiters, 1);
+    pthread_mutex_unlock(&full_mutex);
+}
+
+static void note_depth(size_t depth) {
+    unsigned long long hw = atomic_load_explicit(&stat_high_water, memory_order_relaxed);
+    while (depth > hw &&
+           !atomic_compare_exchange_weak_explicit(&stat_high_water, &hw, depth,
+                memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+static uint64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// claim a slot, fill it, publish it
+static void log_push(uint8_t type, int room, int seat, char sym, uint16_t arg,
+                     const char *text, size_t len) {
+    if (ring == NULL) return;
+
+    size_t pos = atomic_load_explicit(&enq_pos, memory_order_relaxed);
+    struct LogSlot *slot;
+    for (;;) {
+        slot = &ring[pos & ring_mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enq_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // ring full
+            logger_wake();
+            if (full_policy == LOG_FULL_DROP) {
+                atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+                return;
+            }
+            if (full_policy == LOG_FULL_OVERWRITE) {
+                if (ring_pop(NULL)) {
+                    atomic_fetch_add_explicit(&stat_overwritten, 1, memory_order_relaxed);
+                }
+            } else {
+                wait_for_space(); // LOG_FULL_BLOCK
+            }
+            pos = atomic_load_explicit(&enq_pos, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&enq_pos, memory_order_relaxed);
+        }
+    }
+
+    struct LogRecord *rec = &slot->rec;
+    rec->ts_ns = wall_ns();
+    rec->seq = (uint32_t)pos;
+    rec->room = room;
+    rec->type = type;
+    rec->seat = (int8_t)seat;
+    rec->sym = sym;
+    rec->flags = 0;
+    rec->len = (uint16_t)len;
+    rec->arg = arg;
+    if (len) memcpy(rec->text, text, len);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    // deq_pos may already be past us if the record was consumed/evicted
+    size_t head = atomic_load_explicit(&deq_pos, memory_order_relaxed);
+    if (head <= pos) {
+        size_t depth = pos + 1 - head;
+        note_depth(depth);
+        // a full batch is waiting, don't make it sit out the flush interval
+        if (depth >= wake_threshold) {
+            atomic_thread_fence(memory_order_seq_cst);
+            logger_wake();
+        }
+    }
+}
 
 // Helper function used by other files to add logs
 void log_message(char *msg) {
-    if (gameData == NULL) return;
+    log_push(LOG_TEXT, -1, -1, 0, 0, msg, strnlen(msg, LOG_TEXT_MAX));
+}
+
+// fixed-size game event, the caller does no formatting
+void log_event(uint8_t type, int room, int seat, char sym, uint16_t arg) {
+    log_push(type, room, seat, sym, arg, NULL, 0);
+}
+
+void logger_stats(struct LogStats *out) {
+    out->written = atomic_load(&stat_written);
+    out->dropped = atomic_load(&stat_dropped);
+    out->overwritten = atomic_load(&stat_overwritten);
+    out->high_water = atomic_load(&stat_high_water);
+    size_t head = atomic_load(&deq_pos); // head first: it never passes tail
+    out->depth = atomic_load(&enq_pos) - head;
+    out->capacity = ring_mask + 1;
+}
 
-    pthread_mutex_lock(&gameData->log_mutex);
-    int next_tail = (gameData->log_tail + 1) % MAX_QUEUE_SIZE;
-    if (next_tail != gameData->log_head) { 
-        strncpy(gameData->log_queue[gameData->log_tail], msg, MAX_LOG_LENGTH - 1);
-        gameData->log_queue[gameData->log_tail][MAX_LOG_LENGTH - 1] = '\0';
-        gameData->log_tail = next_tail;
+/* ---------- file output ---------- */
+
+static int log_fd = -1;
+static long long log_bytes;
+static long long log_opened_ms;
+
+// write the whole iovec array, resuming after short writes
+static int writev_all(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t w = writev(fd, iov, cnt);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        log_bytes += w;
+        while (cnt > 0 && (size_t)w >= iov->iov_len) {
+            w -= (ssize_t)iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= (size_t)w;
+        }
     }
-    pthread_mutex_unlock(&gameData->log_mutex);
+    return 0;
+}
+
+static int log_open(void) {
+    log_fd = open("game.log", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (log_fd < 0) { perror("Failed to open game.log"); return -1; }
+    log_bytes = 0;
+    log_opened_ms = now_ms();
+
+    struct iovec iov = { (void *)LOG_FILE_MAGIC, LOG_MAGIC_LEN };
+    return writev_all(log_fd, &iov, 1);
+}
+
+// game.log -> game.log.1 -> ... -> game.log.LOG_KEEP (oldest dropped)
+static void log_rotate(void) {
+    close(log_fd);
+
+    char from[32], to[32];
+    for (int i = LOG_KEEP - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "game.log.%d", i);
+        snprintf(to, sizeof(to), "game.log.%d", i + 1);
+        rename(from, to);
+    }
+    rename("game.log", "game.log.1");
+
+    log_open();
+}
+
+// records written by the logger thread itself, not through the ring
+static void log_direct(const char *text) {
+    struct LogRecord rec;
+    memset(&rec, 0, LOG_RECORD_HEADER);
+    rec.ts_ns = wall_ns();
+    rec.room = -1;
+    rec.seat = -1;
+    rec.type = LOG_TEXT;
+    rec.len = (uint16_t)strnlen(text, LOG_TEXT_MAX);
+    memcpy(rec.text, text, rec.len);
+
+    struct iovec iov = { &rec, LOG_RECORD_HEADER + rec.len };
+    writev_all(log_fd, &iov, 1);
 }
 
 // The Consumer Thread
-// write the move to game.log 
+// write the move to game.log
 void* logger_thread(void* arg) {
+    (void)arg;
     printf("[Logger] Thread started.\n");
-    FILE *fp = fopen("game.log", "w"); 
-    if (!fp) { perror("Failed to open game.log"); return NULL; }
+    if (log_open() < 0) return NULL;
+
+    log_direct("Server Started. Logger Initialized.");
+
+    static struct LogRecord batch[LOG_BATCH];
+    struct iovec iov[LOG_BATCH];
 
-    fprintf(fp, "Server Started. Logger Initialized.\n");
+    while (1) {
+        int n = 0;
+        while (n < LOG_BATCH && ring_pop(&batch[n])) {
+            iov[n].iov_base = &batch[n];
+            iov[n].iov_len = LOG_RECORD_HEADER + batch[n].len;
+            n++;
+        }
+
+        if (n > 0) {
+            // the slots are free already, blocked producers needn't wait for the write
+            atomic_thread_fence(memory_order_seq_cst);
+            if (atomic_load_explicit(&full_waiters, memory_order_relaxed)) {
+                pthread_mutex_lock(&full_mutex);
+                pthread_cond_broadcast(&full_cond);
+                pthread_mutex_unlock(&full_mutex);
+            }
+
+            if (writev_all(log_fd, iov, n) < 0) perror("game.log write");
+            else atomic_fetch_add_explicit(&stat_written, (unsigned long long)n, memory_order_relaxed);
 
-    while (gameData->game_active) {
-        pthread_mutex_lock(&gameData->log_mutex);
-        while (gameData->log_head != gameData->log_tail) {
-            fprintf(fp, "%s\n", gameData->log_queue[gameData->log_head]);
-            gameData->log_head = (gameData->log_head + 1) % MAX_QUEUE_SIZE;
+            if ((rotate_bytes > 0 && log_bytes >= rotate_bytes) ||
+                (rotate_secs > 0 && now_ms() - log_opened_ms >= rotate_secs * 1000LL)) {
+                log_rotate();
+            }
+            if (n == LOG_BATCH) continue; // more waiting, keep draining
         }
-        fflush(fp); 
-        pthread_mutex_unlock(&gameData->log_mutex);
-        usleep(100000); 
+
+        if (!gameData->game_active) break;
+
+        // sleep for the flush interval unless a producer crosses wake_threshold
+        atomic_store(&consumer_sleeping, 1);
+        size_t head = atomic_load(&deq_pos);
+        if (atomic_load(&enq_pos) - head < wake_threshold) {
+            struct pollfd pfd = { wake_fd, POLLIN, 0 };
+            poll(&pfd, 1, LOG_FLUSH_MS);
+        }
+        atomic_store(&consumer_sleeping, 0);
+
+        uint64_t drain;
+        ssize_t r = read(wake_fd, &drain, sizeof(drain));
+        (void)r;
     }
-    fclose(fp);
+
+    close(log_fd);
     return NULL;
-}
\ No newline at end of file
+}
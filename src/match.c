@@ -0,0 +1,327 @@
+#include "game.h"
+#include <poll.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+// Matchmaking. A named player is queued by rule set and rating bucket
+// (its wins in scores.db, see bucket_of) instead of taking the first
+// free seat. Reactors only append to a sharded inbox and go back to
+// their sockets; the matchmaker thread drains the inboxes and deals
+// whole tables:
+//   1. players of one bucket, oldest first
+//   2. what is left, across buckets: a player accepts one bucket
+//      further for every MATCH_WIDEN_MS waited
+//   3. a player waiting wait_ms takes any open table of the rule set,
+//      as before matchmaking; the AI fills it if nobody else comes
+// Tables are seated MATCH_BATCH at a time under one lobby lock
+// (room_open_tables), then handed to each player's reactor through
+// conn->match_state, see match_adopt().
+//
+// A player may pick a symbol while queued (match_prefer); client_seated
+// applies it when the seat is dealt, so a full table usually starts
+// without another round trip.
+
+#define MATCH_TICK_MS 100       // while anyone waits: widening and the fallback
+#define MATCH_POLL_MS 1000      // an empty queue
+
+// reactors -> matchmaker, one per rule set and bucket
+struct MatchInbox {
+    _Alignas(64) pthread_mutex_t lock;
+    struct Conn **conns;        // refs
+    int len, cap;
+};
+
+// matchmaker only, oldest first
+struct MatchQueue {
+    struct Conn **conns;        // refs
+    int len, cap;
+};
+
+static struct MatchInbox inbox[MAX_RULES][MATCH_BUCKETS];
+static struct MatchQueue queue[MAX_RULES][MATCH_BUCKETS];
+
+static _Alignas(64) _Atomic int inbox_count;   // enqueued since the last drain
+static _Alignas(64) _Atomic int sleeping;      // enqueue only writes wake_fd while it sleeps
+static int wake_fd = -1;
+static long long wait_ns = MATCH_WAIT_MS_DEFAULT * 1000000LL;
+
+// the batch being dealt: tables * players conns, seat order
+static struct Conn *batch[MATCH_BATCH * MAX_PLAYERS];
+static struct Room *batch_rooms[MATCH_BATCH];
+static int batch_tables;
+
+// 0 wins -> 0, then one bucket per doubling
+static int bucket_of(uint32_t wins) {
+    int b = 0;
+    while (wins && b < MATCH_BUCKETS - 1) {
+        wins >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void push(struct Conn ***conns, int *len, int *cap, struct Conn *conn) {
+    if (*len == *cap) {
+        int ncap = *cap ? *cap * 2 : 64;
+        struct Conn **n = realloc(*conns, (size_t)ncap * sizeof(*n));
+        if (!n) { perror("match"); exit(1); }
+        *conns = n;
+        *cap = ncap;
+    }
+    (*conns)[(*len)++] = conn;
+}
+
+/* ---------- dealing (matchmaker thread) ---------- */
+
+static bool claim(struct Conn *conn) {
+    int expect = MATCH_QUEUED;
+    return atomic_compare_exchange_strong(&conn->match_state, &expect, MATCH_CLAIMED);
+}
+
+static void unclaim(struct Conn *conn) {
+    atomic_store(&conn->match_state, MATCH_QUEUED);
+}
+
+static bool queued(struct Conn *conn) {
+    return atomic_load_explicit(&conn->match_state, memory_order_relaxed) == MATCH_QUEUED;
+}
+
+// seat the batch; tables the pool had no room for go back to waiting
+static void flush(const struct Rules *rules) {
+    if (batch_tables == 0) return;
+    int players = rules->players;
+    int seated = room_open_tables(rules, batch, batch_tables, batch_rooms);
+
+    for (int t = 0; t < batch_tables; t++) {
+        for (int i = 0; i < players; i++) {
+            struct Conn *c = batch[t * players + i];
+            if (t >= seated) {
+                unclaim(c);
+                continue;
+            }
+            metrics_time(MO_MATCH_WAIT, c->match_since);
+            client_seated(c, batch_rooms[t], i);
+        }
+    }
+    if (seated) metrics_count(MC_TABLES_MATCHED, (unsigned long long)seated);
+    batch_tables = 0;
+}
+
+// claim `players` conns as the next table of the batch; false (nothing
+// claimed) if one of them hung up meanwhile
+static bool deal(const struct Rules *rules, struct Conn **group) {
+    int players = rules->players;
+    for (int i = 0; i < players; i++) {
+        if (claim(group[i])) continue;
+        while (i-- > 0) unclaim(group[i]);
+        return false;
+    }
+    memcpy(&batch[batch_tables * players], group, (size_t)players * sizeof(*group));
+    if (++batch_tables == MATCH_BATCH) flush(rules);
+    return true;
+}
+
+// 1. full tables within each bucket
+static void deal_buckets(int ri) {
+    const struct Rules *rules = &rule_sets[ri];
+    int players = rules->players;
+    struct Conn *group[MAX_PLAYERS];
+
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        struct MatchQueue *q = &queue[ri][b];
+        int n = 0;
+        for (int i = 0; i < q->len; i++) {
+            if (!queued(q->conns[i])) continue;
+            group[n++] = q->conns[i];
+            if (n < players) continue;
+            deal(rules, group);
+            n = 0;
+        }
+    }
+}
+
+// 2. the leftovers (under a table per bucket), lowest bucket first: a
+// window of `players` neighbours makes a table when every one of them
+// has waited long enough to accept its spread
+static void deal_widened(int ri, long long now) {
+    const struct Rules *rules = &rule_sets[ri];
+    int players = rules->players;
+    struct Conn *left[MATCH_BUCKETS * MAX_PLAYERS];
+    int n = 0;
+
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        struct MatchQueue *q = &queue[ri][b];
+        for (int i = 0; i < q->len && n < (int)(sizeof(left) / sizeof(left[0])); i++) {
+            if (queued(q->conns[i])) left[n++] = q->conns[i];
+        }
+    }
+
+    for (int i = 0; i + players <= n;) {
+        int spread = left[i + players - 1]->match_bucket - left[i]->match_bucket;
+        bool ok = true;
+        for (int j = i; j < i + players && ok; j++) {
+            ok = (now - left[j]->match_since) / 1000000 >= (long long)spread * MATCH_WIDEN_MS;
+        }
+        if (ok && deal(rules, &left[i])) i += players;
+        else i++;
+    }
+}
+
+// 3. waited too long: the first open table, AI seats included
+static void deal_fallback(int ri, long long now) {
+    const struct Rules *rules = &rule_sets[ri];
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        struct MatchQueue *q = &queue[ri][b];
+        for (int i = 0; i < q->len; i++) {
+            struct Conn *c = q->conns[i];
+            if (now - c->match_since < wait_ns) break; // oldest first
+            if (!claim(c)) continue;
+
+            int seat = -1;
+            struct Room *room = room_join(rules, c, c->name, &seat);
+            if (room) metrics_time(MO_MATCH_WAIT, c->match_since);
+            client_seated(c, room, seat);
+            if (!room) atomic_store(&c->match_state, MATCH_CANCELLED);
+        }
+    }
+}
+
+// keep who is still waiting; drop the queue's ref of the others
+static void compact(struct MatchQueue *q) {
+    int kept = 0;
+    for (int i = 0; i < q->len; i++) {
+        struct Conn *c = q->conns[i];
+        if (queued(c)) q->conns[kept++] = c;
+        else conn_unref(c);
+    }
+    q->len = kept;
+}
+
+// returns the players still waiting
+static int pass(void) {
+    atomic_store(&inbox_count, 0);
+    long long now = metrics_now();
+    int waiting = 0;
+
+    for (int ri = 0; ri < rule_count; ri++) {
+        for (int b = 0; b < MATCH_BUCKETS; b++) {
+            struct MatchInbox *in = &inbox[ri][b];
+            struct MatchQueue *q = &queue[ri][b];
+            pthread_mutex_lock(&in->lock);
+            for (int i = 0; i < in->len; i++) push(&q->conns, &q->len, &q->cap, in->conns[i]);
+            in->len = 0;
+            pthread_mutex_unlock(&in->lock);
+        }
+
+        deal_buckets(ri);
+        deal_widened(ri, now);
+        flush(&rule_sets[ri]);
+        deal_fallback(ri, now);
+
+        for (int b = 0; b < MATCH_BUCKETS; b++) {
+            compact(&queue[ri][b]);
+            waiting += queue[ri][b].len;
+        }
+    }
+    return waiting;
+}
+
+static void *match_thread(void *arg) {
+    (void)arg;
+    while (gameData->game_active) {
+        int waiting = pass();
+
+        // sleep until a player is queued, or the next widening step
+        atomic_store(&sleeping, 1);
+        if (atomic_load(&inbox_count) == 0) {
+            struct pollfd pfd = { wake_fd, POLLIN, 0 };
+            poll(&pfd, 1, waiting ? MATCH_TICK_MS : MATCH_POLL_MS);
+        }
+        atomic_store(&sleeping, 0);
+
+        uint64_t drain;
+        ssize_t r = read(wake_fd, &drain, sizeof(drain));
+        (void)r;
+    }
+    return NULL;
+}
+
+/* ---------- reactor side ---------- */
+
+// wait_ms: how long a player holds out for a table at their level
+void match_init(int wait_ms) {
+    if (wait_ms >= 0) wait_ns = wait_ms * 1000000LL;
+    for (int ri = 0; ri < MAX_RULES; ri++) {
+        for (int b = 0; b < MATCH_BUCKETS; b++) pthread_mutex_init(&inbox[ri][b].lock, NULL);
+    }
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) { perror("eventfd"); exit(1); }
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, match_thread, NULL) != 0) {
+        perror("pthread_create");
+        exit(1);
+    }
+    pthread_detach(t);
+    printf("[Match] Matchmaker started, a table at any level after %d ms.\n", (int)(wait_ns / 1000000));
+}
+
+// conn->name is set; the seat arrives through client_seated()
+void match_enqueue(struct Conn *conn, const struct Rules *rules) {
+    int ri = rules_index(rules);
+    conn->match_rules = rules;
+    conn->match_bucket = bucket_of(scores_wins(conn->name));
+    conn->match_since = metrics_now();
+    atomic_store(&conn->match_symbol, 0);
+    atomic_store(&conn->match_state, MATCH_QUEUED);
+
+    struct MatchInbox *in = &inbox[ri][conn->match_bucket];
+    pthread_mutex_lock(&in->lock);
+    push(&in->conns, &in->len, &in->cap, conn_ref(conn));
+    pthread_mutex_unlock(&in->lock);
+
+    atomic_fetch_add(&inbox_count, 1);
+    if (atomic_exchange(&sleeping, 0)) {
+        uint64_t one = 1;
+        ssize_t w = write(wake_fd, &one, sizeof(one));
+        (void)w;
+    }
+}
+
+// the symbol to ask for once seated; false when the seat is already
+// being dealt (match_adopt() then waits for it)
+bool match_prefer(struct Conn *conn, char sym) {
+    int cur = atomic_load(&conn->match_symbol);
+    while (cur != MATCH_SYMBOL_CLOSED) {
+        if (atomic_compare_exchange_weak(&conn->match_symbol, &cur, (unsigned char)sym)) return true;
+    }
+    return false;
+}
+
+// on the conn's reactor: take over the seat the matchmaker dealt. With
+// `wait`, a seat being dealt right now is waited for (a few µs)
+bool match_adopt(struct Conn *conn, bool wait) {
+    int st;
+    while ((st = atomic_load_explicit(&conn->match_state, memory_order_acquire)) == MATCH_CLAIMED && wait) {
+        sched_yield();
+    }
+    if (st != MATCH_SEATED) return false;
+
+    conn->room = conn->match_room;
+    conn->seat = conn->match_seat;
+    conn->state = conn->match_playing ? CONN_PLAYING : CONN_SYMBOL;
+    atomic_store_explicit(&conn->match_state, MATCH_NONE, memory_order_relaxed);
+    return true;
+}
+
+// hung up while queued: true if a seat was dealt anyway (adopted, the
+// caller leaves it as usual), false if the player just leaves the queue
+bool match_leave(struct Conn *conn) {
+    while (1) {
+        int st = MATCH_QUEUED;
+        if (atomic_compare_exchange_strong(&conn->match_state, &st, MATCH_CANCELLED)) return false;
+        if (st == MATCH_SEATED) return match_adopt(conn, false);
+        if (st != MATCH_CLAIMED) return false;
+        sched_yield(); // being dealt right now
+    }
+}
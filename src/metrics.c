@@ -0,0 +1,319 @@
+#define _GNU_SOURCE // accept4
+#include "game.h"
+#include <stdarg.h>
+#include <time.h>
+
+// Runtime metrics. Every thread that records something gets its own
+// shard, so the hot paths only ever touch their own cache lines: a
+// counter bump is a relaxed load + store (one writer, no lock prefix),
+// a timing is two vDSO clock reads and a histogram bucket. The
+// metrics thread sums the shards when it is scraped and serves them as
+// Prometheus text on 127.0.0.1:port.
+//
+// Histograms are log-linear (HDR style): METRIC_SUB linear buckets per
+// power of two of nanoseconds, so any value lands in a bucket at most
+// 1/METRIC_SUB wider than itself.
+
+#define METRIC_SUB_BITS 4
+#define METRIC_SUB (1 << METRIC_SUB_BITS)
+#define METRIC_GROUPS 40            // up to 2^40 ns, about 18 minutes
+#define METRIC_BUCKETS (METRIC_GROUPS * METRIC_SUB)
+
+// exported le bounds: 2^10 ns (~1 us) .. 2^30 ns (~1 s), exact bucket edges
+#define METRIC_LE_MIN 10
+#define METRIC_LE_MAX 30
+
+struct OpHist {
+    _Atomic unsigned long long sum_ns;
+    _Atomic unsigned long long bucket[METRIC_BUCKETS];
+};
+
+struct MetricShard {
+    struct MetricShard *next;
+    _Atomic unsigned long long counter[MC_COUNT];
+    struct OpHist op[MO_COUNT];
+};
+
+static const char *counter_name[MC_COUNT] = {
+    [MC_ACCEPTED]       = "connections_accepted",
+    [MC_CLOSED]         = "connections_closed",
+    [MC_MOVES]          = "moves",
+    [MC_MOVES_REJECTED] = "moves_rejected",
+    [MC_BYTES_SENT]     = "bytes_sent",
+    [MC_SEND_BLOCKED]   = "sends_blocked",
+    [MC_TIMEOUTS]       = "timeouts",
+    [MC_TABLES_MATCHED] = "tables_matched",
+};
+
+static const char *counter_help[MC_COUNT] = {
+    [MC_ACCEPTED]       = "Connections accepted.",
+    [MC_CLOSED]         = "Connections closed.",
+    [MC_MOVES]          = "Moves placed on a board.",
+    [MC_MOVES_REJECTED] = "Moves refused (not your turn, spot taken, bad input).",
+    [MC_BYTES_SENT]     = "Bytes written to client sockets.",
+    [MC_SEND_BLOCKED]   = "sendmsg() calls that hit a full socket buffer.",
+    [MC_TIMEOUTS]       = "Connections cut by the handshake or idle limit.",
+    [MC_TABLES_MATCHED] = "Full tables dealt by the matchmaker.",
+};
+
+static const char *op_name[MO_COUNT] = {
+    [MO_ACCEPT]      = "accept",
+    [MO_HANDSHAKE]   = "handshake",
+    [MO_MOVE]        = "move",
+    [MO_CHECK_WIN]   = "check_win",
+    [MO_RENDER]      = "render",
+    [MO_BROADCAST]   = "broadcast",
+    [MO_SAVE_SCORES] = "save_scores",
+    [MO_WATCH]       = "watch",
+    [MO_MATCH_WAIT]  = "match_wait",
+};
+
+static struct MetricShard *shards;
+static pthread_mutex_t shards_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct MetricShard *my_shard;
+static long long started_ns;
+
+/* ---------- recording ---------- */
+
+long long metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// first use on a thread: a shard of its own, kept for the process lifetime
+static struct MetricShard *shard(void) {
+    if (my_shard) return my_shard;
+    struct MetricShard *s = calloc(1, sizeof(*s));
+    if (!s) { perror("metrics"); exit(1); }
+    pthread_mutex_lock(&shards_mutex);
+    s->next = shards;
+    shards = s;
+    pthread_mutex_unlock(&shards_mutex);
+    return my_shard = s;
+}
+
+// only this thread writes its shard, the scraper only reads
+static inline void bump(_Atomic unsigned long long *c, unsigned long long v) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static int bucket_of(unsigned long long ns) {
+    if (ns < METRIC_SUB) return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    int group = msb - METRIC_SUB_BITS + 1;
+    if (group >= METRIC_GROUPS) return METRIC_BUCKETS - 1;
+    return group * METRIC_SUB + (int)((ns >> (msb - METRIC_SUB_BITS)) & (METRIC_SUB - 1));
+}
+
+// first value past bucket i
+static unsigned long long bucket_end(int i) {
+    int group = i / METRIC_SUB, sub = i % METRIC_SUB;
+    if (group == 0) return (unsigned long long)sub + 1;
+    return (unsigned long long)(METRIC_SUB + sub + 1) << (group - 1);
+}
+
+void metrics_count(enum MetricCounter c, unsigned long long n) {
+    bump(&shard()->counter[c], n);
+}
+
+// start: metrics_now() when the operation began
+void metrics_time(enum MetricOp op, long long start) {
+    long long ns = metrics_now() - start;
+    if (ns < 0) ns = 0;
+    struct OpHist *h = &shard()->op[op];
+    bump(&h->sum_ns, (unsigned long long)ns);
+    bump(&h->bucket[bucket_of((unsigned long long)ns)], 1);
+}
+
+/* ---------- exposition ---------- */
+
+struct Out {
+    char *buf;
+    size_t len, cap;
+};
+
+static void out_printf(struct Out *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void out_printf(struct Out *o, const char *fmt, ...) {
+    while (1) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(o->buf + o->len, o->cap - o->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < o->cap - o->len) { o->len += (size_t)n; return; }
+        o->cap = (o->cap + (size_t)n) * 2;
+        o->buf = realloc(o->buf, o->cap);
+        if (!o->buf) { perror("metrics"); exit(1); }
+    }
+}
+
+// value below which a fraction q of the samples fall, bucket upper edge
+static double quantile(const unsigned long long *b, unsigned long long count, double q) {
+    unsigned long long want = (unsigned long long)(q * (double)count);
+    if (want >= count) want = count - 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++) {
+        seen += b[i];
+        if (seen > want) return bucket_end(i) / 1e9;
+    }
+    return bucket_end(METRIC_BUCKETS - 1) / 1e9;
+}
+
+static void render_metrics(struct Out *o) {
+    unsigned long long counter[MC_COUNT] = {0};
+    static unsigned long long bucket[MO_COUNT][METRIC_BUCKETS]; // metrics thread only
+    unsigned long long total[MO_COUNT] = {0}, sum[MO_COUNT] = {0};
+    memset(bucket, 0, sizeof(bucket));
+
+    pthread_mutex_lock(&shards_mutex);
+    for (struct MetricShard *s = shards; s; s = s->next) {
+        for (int c = 0; c < MC_COUNT; c++) counter[c] += atomic_load_explicit(&s->counter[c], memory_order_relaxed);
+        for (int op = 0; op < MO_COUNT; op++) {
+            struct OpHist *h = &s->op[op];
+            sum[op] += atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+            for (int i = 0; i < METRIC_BUCKETS; i++) {
+                unsigned long long n = atomic_load_explicit(&h->bucket[i], memory_order_relaxed);
+                bucket[op][i] += n;
+                total[op] += n;
+            }
+        }
+    }
+    pthread_mutex_unlock(&shards_mutex);
+
+    for (int c = 0; c < MC_COUNT; c++) {
+        out_printf(o, "# HELP ttt_%s_total %s\n# TYPE ttt_%s_total counter\nttt_%s_total %llu\n",
+                   counter_name[c], counter_help[c], counter_name[c], counter_name[c], counter[c]);
+    }
+    out_printf(o, "# HELP ttt_connections_open Connections not closed yet.\n"
+                  "# TYPE ttt_connections_open gauge\nttt_connections_open %lld\n",
+               (long long)(counter[MC_ACCEPTED] - counter[MC_CLOSED]));
+
+    // _count comes from the buckets, so it always matches +Inf
+    out_printf(o, "# HELP ttt_op_duration_seconds Time spent on hot-path operations.\n"
+                  "# TYPE ttt_op_duration_seconds histogram\n");
+    for (int op = 0; op < MO_COUNT; op++) {
+        unsigned long long cum = 0;
+        int i = 0;
+        for (int p = METRIC_LE_MIN; p <= METRIC_LE_MAX; p++) {
+            unsigned long long edge = 1ULL << p;
+            while (i < METRIC_BUCKETS && bucket_end(i) <= edge) cum += bucket[op][i++];
+            out_printf(o, "ttt_op_duration_seconds_bucket{op=\"%s\",le=\"%.10g\"} %llu\n",
+                       op_name[op], edge / 1e9, cum);
+        }
+        out_printf(o, "ttt_op_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", op_name[op], total[op]);
+        out_printf(o, "ttt_op_duration_seconds_sum{op=\"%s\"} %.9f\n", op_name[op], sum[op] / 1e9);
+        out_printf(o, "ttt_op_duration_seconds_count{op=\"%s\"} %llu\n", op_name[op], total[op]);
+    }
+
+    // the HDR buckets are finer than the le bounds above
+    out_printf(o, "# HELP ttt_op_duration_quantile_seconds Quantiles from the full-resolution histogram.\n"
+                  "# TYPE ttt_op_duration_quantile_seconds gauge\n");
+    static const double qs[] = { 0.5, 0.9, 0.99, 0.999 };
+    for (int op = 0; op < MO_COUNT; op++) {
+        if (total[op] == 0) continue;
+        for (size_t q = 0; q < sizeof(qs) / sizeof(qs[0]); q++) {
+            out_printf(o, "ttt_op_duration_quantile_seconds{op=\"%s\",quantile=\"%g\"} %.9g\n",
+                       op_name[op], qs[q], quantile(bucket[op], total[op], qs[q]));
+        }
+    }
+
+    struct LogStats ls;
+    logger_stats(&ls);
+    out_printf(o, "# HELP ttt_log_queue_depth Records waiting in the logger ring.\n"
+                  "# TYPE ttt_log_queue_depth gauge\nttt_log_queue_depth %llu\n"
+                  "# HELP ttt_log_queue_high_water Deepest the logger ring has been.\n"
+                  "# TYPE ttt_log_queue_high_water gauge\nttt_log_queue_high_water %llu\n"
+                  "# HELP ttt_log_queue_capacity Logger ring slots.\n"
+                  "# TYPE ttt_log_queue_capacity gauge\nttt_log_queue_capacity %llu\n"
+                  "# HELP ttt_log_records_written_total Records written to game.log.\n"
+                  "# TYPE ttt_log_records_written_total counter\nttt_log_records_written_total %llu\n"
+                  "# HELP ttt_log_records_dropped_total Records lost to a full ring (dropped or overwritten).\n"
+                  "# TYPE ttt_log_records_dropped_total counter\nttt_log_records_dropped_total %llu\n",
+               ls.depth, ls.high_water, ls.capacity, ls.written, ls.dropped + ls.overwritten);
+
+    unsigned long long dropped, coalesced, kicked;
+    fanout_stats(&dropped, &coalesced, &kicked);
+    out_printf(o, "# HELP ttt_slow_client_total Slow-client policy actions.\n"
+                  "# TYPE ttt_slow_client_total counter\n"
+                  "ttt_slow_client_total{action=\"dropped\"} %llu\n"
+                  "ttt_slow_client_total{action=\"coalesced\"} %llu\n"
+                  "ttt_slow_client_total{action=\"disconnected\"} %llu\n",
+               dropped, coalesced, kicked);
+
+    out_printf(o, "# HELP ttt_uptime_seconds Seconds since the server started.\n"
+                  "# TYPE ttt_uptime_seconds gauge\nttt_uptime_seconds %.3f\n",
+               (metrics_now() - started_ns) / 1e9);
+}
+
+/* ---------- endpoint ---------- */
+
+// HTTP/1.0, one request per connection, any path gets the metrics
+static void serve(int fd) {
+    // the request itself doesn't matter; read what came so close() doesn't RST it
+    char req[1024];
+    struct timeval tv = { .tv_sec = 1 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    recv(fd, req, sizeof(req), 0);
+
+    struct Out body = {0};
+    render_metrics(&body);
+
+    char head[128];
+    int hlen = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\n"
+                        "Content-Type: text/plain; version=0.0.4\r\n"
+                        "Content-Length: %zu\r\n\r\n", body.len);
+    send(fd, head, (size_t)hlen, MSG_NOSIGNAL);
+    for (size_t off = 0; off < body.len; ) {
+        ssize_t w = send(fd, body.buf + off, body.len - off, MSG_NOSIGNAL);
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+    free(body.buf);
+}
+
+static void *metrics_thread(void *arg) {
+    int listen_fd = (int)(intptr_t)arg;
+    while (gameData->game_active) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        serve(fd);
+        close(fd);
+    }
+    close(listen_fd);
+    return NULL;
+}
+
+// once game_active is set; port 0 keeps the counters but serves nothing
+void metrics_start(int port) {
+    started_ns = metrics_now();
+    if (port <= 0) return;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("metrics socket"); return; }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local scrapers only
+
+    // the game runs without it
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        perror("metrics");
+        close(fd);
+        return;
+    }
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, metrics_thread, (void *)(intptr_t)fd) != 0) {
+        perror("metrics thread");
+        close(fd);
+        return;
+    }
+    pthread_detach(t);
+    printf("Metrics on http://127.0.0.1:%d/metrics\n", port);
+}
@@ -1,33 +1,428 @@
 #include "game.h"
 
-void load_scores() {
-    FILE *fp = fopen("scores.txt", "r");
-    if (!fp) {
-        printf("No previous scores found. Starting fresh.\n");
-        return;
+// Player scores. In memory every player is a RankNode in the leaderboard
+// (leaderboard.c, ordered by wins), found by name through an
+// open-addressed hash table of node pointers that doubles when it gets
+// 3/4 full. A win is one probe plus an O(log n) re-rank under
+// score_mutex and never touches a file.
+//
+// On disk, scores.db is SCORE_MAGIC followed by fixed-size
+// ScoreRecords (name, wins), appended as they change. The newest record
+// for a name wins on replay. Compaction writes the records in rank
+// order, so the compacted file is also a snapshot of the leaderboard and
+// loads by appending each node at the end of the list. The score writer thread group-commits:
+// whatever changed in the last SCORE_FLUSH_MS goes out in one write()
+// and one fdatasync(). Once the log holds more than twice the live
+// records it is rewritten to scores.db.tmp, fsynced and renamed over
+// scores.db, so a crash leaves the old file or the new one, never half
+// of each. A record torn by a crash fails its checksum and is cut off at
+// load.
+
+#define SCORE_DB "scores.db"
+#define SCORE_TMP "scores.db.tmp"
+#define SCORE_LEGACY "scores.txt"   // pre-scores.db format, imported once
+#define SCORE_MAGIC "TTTSCOR1"
+#define SCORE_MAGIC_LEN 8
+#define SCORE_FLUSH_MS 200          // longest a win waits to be on disk
+#define SCORE_COMPACT_MIN 65536     // records in the log before compaction is considered
+#define SCORE_CHUNK 4096            // players copied per score_mutex hold while compacting
+
+struct ScoreRecord {
+    uint32_t check;                 // score_check() of the rest
+    uint32_t wins;
+    char name[NAME_LEN];            // NUL padded
+};
+
+static pthread_mutex_t score_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t score_cond = PTHREAD_COND_INITIALIZER;
+
+static struct Leaderboard board;
+static struct RankNode **table;     // by name, NULL = free slot
+static size_t table_cap;            // power of two
+static size_t table_count;
+
+static struct RankNode **dirty;     // players waiting for the writer
+static size_t dirty_len, dirty_cap;
+
+static unsigned long long games_recorded;
+static bool writer_stop;
+static pthread_t writer;
+
+static int db_fd = -1;
+static size_t db_records;           // records in scores.db, live or stale
+
+/* ---------- table ---------- */
+
+static uint64_t name_hash(const char *name) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    for (; *name; name++) h = (h ^ (uint8_t)*name) * 1099511628211ULL;
+    return h;
+}
+
+static uint32_t score_check(const struct ScoreRecord *r) {
+    uint64_t h = 1469598103934665603ULL ^ r->wins;
+    for (size_t i = 0; i < NAME_LEN; i++) h = (h ^ (uint8_t)r->name[i]) * 1099511628211ULL;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static void mark_dirty_locked(struct RankNode *n) {
+    if (n->dirty) return;
+    n->dirty = true;
+    if (dirty_len == dirty_cap) {
+        dirty_cap = dirty_cap ? dirty_cap * 2 : 1024;
+        dirty = realloc(dirty, dirty_cap * sizeof(*dirty));
+        if (!dirty) { perror("scores"); exit(1); }
+    }
+    dirty[dirty_len++] = n;
+}
+
+static struct RankNode **slot_for(struct RankNode **t, size_t cap, const char *name) {
+    size_t i = name_hash(name) & (cap - 1);
+    while (t[i] && strcmp(t[i]->name, name) != 0) i = (i + 1) & (cap - 1);
+    return &t[i];
+}
+
+static void grow_locked(void) {
+    size_t cap = table_cap ? table_cap * 2 : 1024;
+    struct RankNode **t = calloc(cap, sizeof(*t));
+    if (!t) { perror("scores"); exit(1); }
+
+    for (size_t i = 0; i < table_cap; i++) {
+        if (table[i]) *slot_for(t, cap, table[i]->name) = table[i];
     }
-    // Simple format: Name Wins
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (fscanf(fp, "%s %d", gameData->scores[i].name, &gameData->scores[i].wins) != 2) {
-            break;
+    free(table);
+    table = t;
+    table_cap = cap;
+}
+
+static struct RankNode *find_locked(const char *name) {
+    return table_cap ? *slot_for(table, table_cap, name) : NULL;
+}
+
+// set a player's wins, adding them if new, and move them to their rank
+static struct RankNode *set_wins_locked(const char *name, uint32_t wins) {
+    struct RankNode *n = find_locked(name);
+    if (n) {
+        if (n->wins == wins) return n;
+        lb_remove(&board, n);
+        n->wins = wins;
+        lb_insert(&board, n);
+        return n;
+    }
+
+    if ((table_count + 1) * 4 > table_cap * 3) grow_locked();
+    n = lb_node_new(&board, name, wins);
+    *slot_for(table, table_cap, n->name) = n;
+    table_count++;
+    lb_insert(&board, n);
+    return n;
+}
+
+/* ---------- file ---------- */
+
+static void fill_record(struct ScoreRecord *r, const struct RankNode *n) {
+    memset(r->name, 0, sizeof(r->name));
+    memcpy(r->name, n->name, strnlen(n->name, NAME_LEN - 1));
+    r->wins = n->wins;
+    r->check = score_check(r);
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
         }
+        p += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+// the rename itself has to reach the disk too
+static void sync_dir(void) {
+    int fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+static int open_db(const char *path, int flags) {
+    int fd = open(path, flags | O_CLOEXEC, 0644);
+    if (fd < 0) perror(path);
+    return fd;
+}
+
+// replay scores.db into the table; a torn tail is cut off
+static bool replay_db(void) {
+    int fd = open(SCORE_DB, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    char magic[SCORE_MAGIC_LEN];
+    if (read(fd, magic, sizeof(magic)) != (ssize_t)sizeof(magic) ||
+        memcmp(magic, SCORE_MAGIC, SCORE_MAGIC_LEN) != 0) {
+        fprintf(stderr, "%s: not a score file, ignoring it\n", SCORE_DB);
+        close(fd);
+        return false;
+    }
+
+    struct ScoreRecord buf[1024];
+    off_t good = SCORE_MAGIC_LEN;
+    bool torn = false;
+    ssize_t n;
+    while (!torn && (n = read(fd, buf, sizeof(buf))) > 0) {
+        size_t count = (size_t)n / sizeof(buf[0]);
+        for (size_t i = 0; i < count; i++) {
+            struct ScoreRecord *r = &buf[i];
+            if (r->check != score_check(r) || r->name[0] == '\0' || r->name[NAME_LEN - 1] != '\0') {
+                torn = true;
+                break;
+            }
+            set_wins_locked(r->name, r->wins);
+            good += (off_t)sizeof(*r);
+            db_records++;
+        }
+        if ((size_t)n % sizeof(buf[0]) != 0) torn = true;
+    }
+
+    if (torn) {
+        fprintf(stderr, "%s: dropping a torn record at offset %lld\n", SCORE_DB, (long long)good);
+        if (ftruncate(fd, good) < 0) perror("ftruncate");
+    }
+    lseek(fd, good, SEEK_SET);
+    db_fd = fd;
+    return true;
+}
+
+// old "name wins" text file, read once and then superseded by scores.db
+static void import_legacy(void) {
+    FILE *fp = fopen(SCORE_LEGACY, "r");
+    if (!fp) return;
+
+    char name[NAME_LEN];
+    int wins;
+    while (fscanf(fp, "%31s %d", name, &wins) == 2) {
+        mark_dirty_locked(set_wins_locked(name, wins > 0 ? (uint32_t)wins : 0));
     }
     fclose(fp);
-    printf("Scores loaded.\n");
+    printf("Imported %zu players from %s.\n", table_count, SCORE_LEGACY);
 }
 
-void save_scores() {
-    FILE *fp = fopen("scores.txt", "w");
-    if (!fp) {
-        perror("Failed to save scores");
+// writes every player, best first, to scores.db.tmp and renames it over
+// scores.db. score_mutex is taken per SCORE_CHUNK players, so wins keep
+// landing meanwhile. Wins only move a player up, so the ones not yet
+// copied can be pushed down (copied twice, harmless), or jump above
+// next_rank and be skipped; those are dirty, so whoever is dirty once
+// the scan is done is written again at the end (the newest record wins
+// on load) and the new file misses nobody
+static void compact(void) {
+    int fd = open_db(SCORE_TMP, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) return;
+
+    struct ScoreRecord *out = malloc(SCORE_CHUNK * sizeof(*out));
+    if (!out) { perror("scores"); exit(1); }
+    bool ok = write_all(fd, SCORE_MAGIC, SCORE_MAGIC_LEN);
+    size_t written = 0;
+    uint32_t next_rank = 1;
+
+    while (ok) {
+        size_t cnt = 0;
+        pthread_mutex_lock(&score_mutex);
+        for (struct RankNode *n = lb_at(&board, next_rank); n && cnt < SCORE_CHUNK; n = n->link[0].next) {
+            fill_record(&out[cnt++], n);
+        }
+        pthread_mutex_unlock(&score_mutex);
+        if (cnt == 0) break;
+
+        ok = write_all(fd, out, cnt * sizeof(*out));
+        next_rank += (uint32_t)cnt;
+        written += cnt;
+    }
+    free(out);
+
+    if (ok) {
+        pthread_mutex_lock(&score_mutex);
+        size_t cnt = dirty_len;
+        out = cnt ? malloc(cnt * sizeof(*out)) : NULL;
+        if (cnt && !out) { perror("scores"); exit(1); }
+        for (size_t i = 0; i < cnt; i++) fill_record(&out[i], dirty[i]);
+        pthread_mutex_unlock(&score_mutex);
+
+        ok = write_all(fd, out, cnt * sizeof(*out));
+        written += cnt;
+        free(out);
+    }
+
+    if (ok && fsync(fd) == 0 && rename(SCORE_TMP, SCORE_DB) == 0) {
+        sync_dir();
+        close(db_fd);
+        db_fd = fd;
+        db_records = written;
         return;
     }
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        // Only save if name is set
-        if (gameData->scores[i].name[0] != '\0') {
-            fprintf(fp, "%s %d\n", gameData->scores[i].name, gameData->scores[i].wins);
+    close(fd);
+    unlink(SCORE_TMP);
+}
+
+// one group commit: the dirty entries' current values, one write +
+// fdatasync. returns the number of players
+static size_t commit(void) {
+    pthread_mutex_lock(&score_mutex);
+    size_t live = table_count;
+    size_t cnt = dirty_len;
+    struct ScoreRecord *out = cnt ? malloc(cnt * sizeof(*out)) : NULL;
+    struct RankNode **nodes = cnt ? malloc(cnt * sizeof(*nodes)) : NULL;
+    if (cnt && (!out || !nodes)) { perror("scores"); exit(1); }
+    for (size_t i = 0; i < cnt; i++) {
+        fill_record(&out[i], dirty[i]);
+        nodes[i] = dirty[i];
+        dirty[i]->dirty = false;
+    }
+    dirty_len = 0;
+    pthread_mutex_unlock(&score_mutex);
+
+    if (cnt == 0) return live;
+    long long start = metrics_now();
+    off_t end = lseek(db_fd, 0, SEEK_CUR);
+    if (write_all(db_fd, out, cnt * sizeof(*out)) && fdatasync(db_fd) == 0) {
+        db_records += cnt;
+    } else {
+        // none of it counts: cut off what did get written (anything
+        // appended after a torn record is lost at load) and try these
+        // players again with the next commit
+        perror("Failed to save scores");
+        if (end >= 0 && ftruncate(db_fd, end) == 0) lseek(db_fd, end, SEEK_SET);
+        pthread_mutex_lock(&score_mutex);
+        for (size_t i = 0; i < cnt; i++) mark_dirty_locked(nodes[i]);
+        pthread_mutex_unlock(&score_mutex);
+    }
+    metrics_time(MO_SAVE_SCORES, start);
+    free(nodes);
+    free(out);
+    return live;
+}
+
+static void *score_writer(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&score_mutex);
+    while (!writer_stop) {
+        if (dirty_len == 0) {
+            pthread_cond_wait(&score_cond, &score_mutex);
+            continue;
         }
+        // first change of a batch: give the others SCORE_FLUSH_MS to join it
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += SCORE_FLUSH_MS * 1000000L;
+        if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+        while (!writer_stop && pthread_cond_timedwait(&score_cond, &score_mutex, &until) == 0) {}
+        pthread_mutex_unlock(&score_mutex);
+
+        size_t live = commit();
+        if (db_records > SCORE_COMPACT_MIN && db_records > 2 * live) compact();
+
+        pthread_mutex_lock(&score_mutex);
     }
-    fclose(fp);
-    printf("Scores saved to scores.txt.\n");
-}
\ No newline at end of file
+    pthread_mutex_unlock(&score_mutex);
+    return NULL;
+}
+
+/* ---------- API ---------- */
+
+// startup, before any thread: load scores.db (or import scores.txt)
+// and start the writer
+void load_scores(void) {
+    lb_init(&board);
+    if (replay_db()) {
+        printf("Scores loaded: %zu players.\n", table_count);
+    } else {
+        db_fd = open_db(SCORE_TMP, O_WRONLY | O_CREAT | O_TRUNC);
+        if (db_fd < 0 || !write_all(db_fd, SCORE_MAGIC, SCORE_MAGIC_LEN) ||
+            fsync(db_fd) < 0 || rename(SCORE_TMP, SCORE_DB) < 0) {
+            perror(SCORE_DB);
+            exit(1);
+        }
+        sync_dir();
+        import_legacy();
+        if (table_count == 0) printf("No previous scores found. Starting fresh.\n");
+    }
+
+    if (pthread_create(&writer, NULL, score_writer, NULL) != 0) {
+        perror("score writer");
+        exit(1);
+    }
+}
+
+// shutdown: last commit, compacted
+void save_scores(void) {
+    pthread_mutex_lock(&score_mutex);
+    writer_stop = true;
+    pthread_cond_signal(&score_cond);
+    pthread_mutex_unlock(&score_mutex);
+    pthread_join(writer, NULL);
+
+    if (db_records > commit()) compact();
+    printf("Scores saved to %s (%zu players, %llu wins this run).\n", SCORE_DB, table_count, games_recorded);
+}
+
+// called on the move path (room locked): memory only, the writer persists it
+void record_win(const char *name) {
+    if (!name || name[0] == '\0') name = "anonymous";
+
+    pthread_mutex_lock(&score_mutex);
+    struct RankNode *n = find_locked(name);
+    mark_dirty_locked(set_wins_locked(name, n ? n->wins + 1 : 1));
+    if (dirty_len == 1) pthread_cond_signal(&score_cond);
+    games_recorded++;
+    pthread_mutex_unlock(&score_mutex);
+}
+
+/* ---------- ranked queries ---------- */
+
+// a player's wins, 0 for a new name (the matchmaker's rating)
+uint32_t scores_wins(const char *name) {
+    pthread_mutex_lock(&score_mutex);
+    struct RankNode *n = find_locked(name);
+    uint32_t wins = n ? n->wins : 0;
+    pthread_mutex_unlock(&score_mutex);
+    return wins;
+}
+
+static size_t copy_ranks_locked(struct RankEntry *out, uint32_t rank, size_t max) {
+    size_t cnt = 0;
+    for (struct RankNode *n = lb_at(&board, rank); n && cnt < max; n = n->link[0].next) {
+        out[cnt].rank = rank + (uint32_t)cnt;
+        out[cnt].wins = n->wins;
+        memcpy(out[cnt].name, n->name, NAME_LEN);
+        cnt++;
+    }
+    return cnt;
+}
+
+// the best k players; *total = every player in scores.db, which
+// includes any imported from scores.txt with 0 wins
+size_t scores_top(struct RankEntry *out, size_t k, uint32_t *total) {
+    pthread_mutex_lock(&score_mutex);
+    size_t cnt = copy_ranks_locked(out, 1, k);
+    *total = board.count;
+    pthread_mutex_unlock(&score_mutex);
+    return cnt;
+}
+
+// `name` and up to `radius` players either side of them (out holds
+// 2 * radius + 1); 0 if scores.db has no record of them
+size_t scores_around(const char *name, size_t radius, struct RankEntry *out, uint32_t *total) {
+    size_t cnt = 0;
+    pthread_mutex_lock(&score_mutex);
+    struct RankNode *n = find_locked(name);
+    if (n) {
+        uint32_t r = lb_rank(&board, n);
+        uint32_t first = r > radius ? r - (uint32_t)radius : 1;
+        cnt = copy_ranks_locked(out, first, (r - first) + radius + 1);
+    }
+    *total = board.count;
+    pthread_mutex_unlock(&score_mutex);
+    return cnt;
+}
@@ -0,0 +1,159 @@
+#define _GNU_SOURCE // accept4
+#include "game.h"
+
+// one reactor per thread, each with its own SO_REUSEPORT listener and
+// edge-triggered epoll set; the kernel spreads accepts across them
+
+#define MAX_EVENTS 256
+
+/* ---------- helpers ---------- */
+
+// non-blocking listening socket shared by port with the other reactors
+int reactor_listen(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_PORT);
+    addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, SOMAXCONN) < 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void conn_close(int epfd, struct Conn *conn) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    // seat is freed first; the fd itself closes with the last reference
+    client_disconnected(conn);
+    conn_shutdown(conn);
+    conn_unref(conn);
+}
+
+/* ---------- event handlers ---------- */
+
+static void on_accept(int epfd, int listen_fd) {
+    while (1) {
+        long long start = metrics_now();
+        struct sockaddr_in caddr;
+        socklen_t clen = sizeof(caddr);
+        int client_fd = accept4(listen_fd, (struct sockaddr*)&caddr, &clen,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            // EAGAIN: backlog drained. EMFILE etc: retry on next edge
+            return;
+        }
+
+        int one = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        // seat is assigned after the handshake, once the player picked a game
+        struct Conn *conn = conn_new(client_fd);
+        if (!conn) {
+            close(client_fd);
+            continue;
+        }
+        conn->accepted_ns = start;
+        metrics_count(MC_ACCEPTED, 1);
+
+        // EPOLLOUT edges resume a send queue the socket couldn't take
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            perror("epoll_ctl");
+            conn_unref(conn);
+            continue;
+        }
+
+        client_connected(conn);
+        metrics_time(MO_ACCEPT, start);
+    }
+}
+
+// edge-triggered: drain the socket. A short read means the socket is
+// empty (anything arriving later is a new edge), so the usual extra
+// recv() that only returns EAGAIN is skipped, unless the peer already
+// hung up and the EOF is still to be read. returns false once closed
+static bool on_readable(int epfd, struct Conn *conn, bool hup) {
+    while (1) {
+        size_t space = sizeof(conn->inbuf) - 1 - conn->inlen;
+        ssize_t n = recv(conn->fd, conn->inbuf + conn->inlen, space, 0);
+        if (n > 0) {
+            if (handle_client(conn, (size_t)n)) {
+                if ((size_t)n < space && !hup) return true;
+                continue;
+            }
+            // e.g. server full: reply is already queued, then close
+            conn_close(epfd, conn);
+            return false;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+
+        // n == 0 (peer closed) or hard error
+        conn_close(epfd, conn);
+        return false;
+    }
+}
+
+/* ---------- main loop ---------- */
+
+void* reactor_thread(void* arg) {
+    int listen_fd = (int)(intptr_t)arg;
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) { perror("epoll_create1"); return NULL; }
+
+    // NULL data.ptr marks the listener
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        perror("epoll_ctl");
+        close(epfd);
+        return NULL;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (gameData->game_active) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct Conn *conn = events[i].data.ptr;
+            if (conn == NULL) {
+                on_accept(epfd, listen_fd);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                bool hup = events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+                if (!on_readable(epfd, conn, hup)) continue;
+            }
+            if (events[i].events & EPOLLOUT) conn_flush(conn);
+        }
+    }
+
+    close(epfd);
+    return NULL;
+}
@@ -0,0 +1,150 @@
+#include "game.h"
+
+// Render cache: each room keeps its screen as a Frame matching the
+// board (with and without the labels block, and the binary snapshot).
+// A move patches one byte, a reset drops the frames and the next
+// broadcast copies the rule set's template back in. Every recipient is
+// sent the same Frame; if it is still referenced when the board changes
+// the room copies it first, so a shared Frame never changes under a
+// reader.
+
+struct Frame *frame_new(size_t len) {
+    struct Frame *f = malloc(sizeof(*f) + len + 1);
+    if (!f) { perror("frame"); exit(1); }
+    atomic_init(&f->refs, 1);
+    f->len = len;
+    f->data[len] = '\0';
+    return f;
+}
+
+struct Frame *frame_ref(struct Frame *f) {
+    atomic_fetch_add_explicit(&f->refs, 1, memory_order_relaxed);
+    return f;
+}
+
+void frame_unref(struct Frame *f) {
+    if (f && atomic_fetch_sub_explicit(&f->refs, 1, memory_order_acq_rel) == 1) free(f);
+}
+
+// one binary protocol frame
+struct Frame *frame_proto(uint8_t type, const void *payload, size_t len) {
+    struct Frame *f = frame_new(PROTO_HEADER + len);
+    f->data[0] = (char)type;
+    f->data[1] = (char)(len >> 8);
+    f->data[2] = (char)(len & 0xff);
+    if (len) memcpy(f->data + PROTO_HEADER, payload, len);
+    return f;
+}
+
+// never write to a Frame someone else still holds
+static struct Frame *own_frame(struct Frame **slot) {
+    struct Frame *f = *slot;
+    if (atomic_load_explicit(&f->refs, memory_order_acquire) > 1) {
+        struct Frame *copy = frame_new(f->len);
+        memcpy(copy->data, f->data, f->len);
+        frame_unref(f);
+        *slot = f = copy;
+    }
+    return f;
+}
+
+#define BIN_TURN 0                     // P_BOARD payload offsets
+#define BIN_SEQ 1
+#define BIN_CELLS 5
+
+static uint8_t turn_byte(const struct Room *room) {
+    if (room->round_over || room->current_turn_id < 0) return 0xff;
+    return (uint8_t)room->current_turn_id;
+}
+
+// full render of `cells` from the template, only after a reset (and by
+// the spectator fan-out, which has no room). new frame
+struct Frame *render_board(const struct Rules *rules, const char *cells, bool labels) {
+    long long start = metrics_now();
+    size_t skip = labels ? 0 : rules->labels_len; // template bytes left out
+    struct Frame *f = frame_new(rules->screen_len - skip);
+    memcpy(f->data, rules->screen + skip, rules->screen_len - skip);
+
+    int count = rules->n * rules->n;
+    for (int i = 0; i < count; i++) {
+        char cell = cells[i];
+        if (cell != 0 && cell != EMPTY_CELL) f->data[rules->cell_offset[i] - skip] = cell;
+    }
+    metrics_time(MO_RENDER, start);
+    return f;
+}
+
+// the room's current screen, with or without the labels block;
+// borrowed, frame_ref() it to keep it
+struct Frame *render_frame_locked(struct Room *room, bool labels) {
+    struct Frame **slot = labels ? &room->frame : &room->board_frame;
+    if (!*slot) *slot = render_board(room->rules, room->board, labels);
+    return *slot;
+}
+
+// P_BOARD snapshot. turn and seq are patched here, so call it after
+// current_turn_id/seq are set
+struct Frame *render_bin_frame_locked(struct Room *room) {
+    int cells = room->rules->n * room->rules->n;
+    uint8_t turn = turn_byte(room);
+    uint32_t seq = htonl(room->seq);
+
+    if (!room->bin_frame) {
+        long long start = metrics_now();
+        uint8_t payload[1 + BIN_CELLS + MAX_CELLS];
+        payload[0] = (uint8_t)room->rules->n;
+        for (int i = 0; i < cells; i++) {
+            char cell = room->board[i];
+            payload[1 + BIN_CELLS + i] = (cell == 0 || cell == EMPTY_CELL) ? 0 : (uint8_t)cell;
+        }
+        room->bin_frame = frame_proto(P_BOARD, payload, 1 + BIN_CELLS + (size_t)cells);
+        metrics_time(MO_RENDER, start);
+    }
+
+    char *p = room->bin_frame->data + PROTO_HEADER + 1;
+    if ((uint8_t)p[BIN_TURN] != turn || memcmp(p + BIN_SEQ, &seq, 4) != 0) {
+        p = own_frame(&room->bin_frame)->data + PROTO_HEADER + 1;
+        p[BIN_TURN] = (char)turn;
+        memcpy(p + BIN_SEQ, &seq, 4);
+    }
+    return room->bin_frame;
+}
+
+// P_DELTA for the move since the last broadcast (if any) and the seat
+// to move now. new frame, the caller unrefs it
+struct Frame *render_delta_locked(struct Room *room) {
+    uint8_t d[7];
+    uint32_t seq = htonl(room->seq);
+    memcpy(d, &seq, 4);
+    d[4] = room->last_cell < 0 ? 0xff : (uint8_t)room->last_cell;
+    d[5] = room->last_cell < 0 ? 0 : (uint8_t)room->board[room->last_cell];
+    d[6] = turn_byte(room);
+    return frame_proto(P_DELTA, d, sizeof(d));
+}
+
+// board[cell] changed; someone still holding the old screen gets it
+// copied first
+void render_cell_locked(struct Room *room, int cell) {
+    const struct Rules *rules = room->rules;
+    long long start = metrics_now();
+    if (room->frame) {
+        own_frame(&room->frame)->data[rules->cell_offset[cell]] = room->board[cell];
+    }
+    if (room->board_frame) {
+        own_frame(&room->board_frame)->data[rules->cell_offset[cell] - rules->labels_len] = room->board[cell];
+    }
+    if (room->bin_frame) {
+        own_frame(&room->bin_frame)->data[PROTO_HEADER + 1 + BIN_CELLS + cell] = room->board[cell];
+    }
+    metrics_time(MO_RENDER, start);
+}
+
+// board cleared or rule set changed
+void render_reset_locked(struct Room *room) {
+    frame_unref(room->frame);
+    room->frame = NULL;
+    frame_unref(room->board_frame);
+    room->board_frame = NULL;
+    frame_unref(room->bin_frame);
+    room->bin_frame = NULL;
+}
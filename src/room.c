@@ -0,0 +1,423 @@
+#include "game.h"
+#include <sys/random.h>
+
+static int grace_ms = SEAT_GRACE_MS_DEFAULT;
+
+/* ---------- room pool ---------- */
+
+// clear board + seats, room must be locked (or not yet shared)
+void room_reset_locked(struct Room *room) {
+    memset(room->board, EMPTY_CELL, sizeof(room->board));
+    for (int i = 0; i < MAX_PLAYERS; i++) bb_clear(&room->marks[i]);
+    bb_clear(&room->occupied);
+    room->round_over = false;
+    room->draw = false;
+    room->current_turn_id = -1;
+    room->move_gen++;
+    room->last_cell = -1;
+    render_reset_locked(room);
+    room->seq++;
+    watch_publish_locked(room, true);
+    timer_cancel(&room->reset_timer);
+    timer_cancel(&room->fill_timer);
+    timer_cancel(&room->ai_timer);
+    timer_cancel(&room->reclaim_timer);
+    timer_cancel(&room->turn_timer);
+    room->turn_deadline = 0;
+
+    room->player_count = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        room->player_active[i] = false;
+        if (room->clients[i]) conn_unref(room->clients[i]);
+        room->clients[i] = NULL;
+        room->player_ai[i] = false;
+        room->player_symbol[i] = 0;
+        room->player_name[i][0] = '\0';
+        room->player_token[i] = 0;
+        room->seat_deadline[i] = 0;
+        room->turn_misses[i] = 0;
+    }
+}
+
+static int humans_locked(struct Room *room) {
+    int n = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (room->player_active[i] && !room->player_ai[i]) n++;
+    }
+    return n;
+}
+
+// unguessable, and names its room and seat
+static uint64_t new_token(const struct Room *room, int seat) {
+    uint64_t r;
+    if (getrandom(&r, sizeof(r), 0) != (ssize_t)sizeof(r)) r = ((uint64_t)rand() << 32) ^ (uint64_t)now_ms();
+    r &= ~(uint64_t)0 << (TOKEN_SEAT_BITS + TOKEN_ROOM_BITS);
+    if (!r) r = 1ULL << 63;
+    return r | ((uint64_t)room->id << TOKEN_SEAT_BITS) | (uint64_t)seat;
+}
+
+/* ---------- moves ---------- */
+
+// put seat's mark on an empty cell and score it; the caller reports
+// the result and then calls room_move_done_locked
+enum MoveResult room_place_locked(struct Room *room, int seat, int cell) {
+    const struct Rules *rules = room->rules;
+    char sym = room->player_symbol[seat];
+
+    metrics_count(MC_MOVES, 1);
+    room->board[cell] = sym;
+    bb_set(&room->marks[seat], cell);
+    bb_set(&room->occupied, cell);
+    room->move_gen++;
+    room->last_cell = cell;
+    room->turn_misses[seat] = 0;
+    render_cell_locked(room, cell);
+
+    log_event(LOG_MOVE, room->id, seat, sym, (uint16_t)(((cell / rules->n) << 8) | (cell % rules->n)));
+
+    enum MoveResult res = MOVE_OK;
+
+    // win: any k-in-a-row through the cell just played (bitboard lookup)
+    long long start = metrics_now();
+    bool won = engine_wins_at(&rules->lines, &room->marks[seat], cell);
+    metrics_time(MO_CHECK_WIN, start);
+    if (won) {
+        if (!room->player_ai[seat]) record_win(room->player_name[seat]); // in memory, scores.db catches up
+        room->round_over = true;
+        res = MOVE_WIN;
+    }
+
+    // all tiles is filled in 
+    else if (engine_full(&rules->lines, &room->occupied)) {
+        room->draw = true;
+        room->round_over = true;
+        res = MOVE_DRAW;
+    }
+
+    wal_record_locked(room, WAL_MOVE, seat, cell, res);
+    return res;
+}
+
+void rooms_init(int grace) {
+    grace_ms = grace;
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        struct Room *room = &gameData->rooms[i];
+        room->id = i;
+        room->in_use = false;
+        room->rules = &rule_sets[0];
+        pthread_mutex_init(&room->board_mutex, NULL);
+        pthread_mutex_init(&room->send_mutex, NULL);
+        room_reset_locked(room);
+    }
+
+    // push in reverse so room 0 is handed out first
+    gameData->free_top = 0;
+    for (int i = MAX_ROOMS - 1; i >= 0; i--) {
+        gameData->free_rooms[gameData->free_top++] = i;
+    }
+    for (int i = 0; i < MAX_RULES; i++) gameData->open_room[i] = -1;
+    gameData->room_high_water = 0;
+}
+
+/* ---------- lobby ---------- */
+
+// seat a player: fill the open room for their rule set first,
+// otherwise open a fresh one. returns NULL when every room is taken
+// room locked, seat free
+static void seat_locked(struct Room *room, int seat, struct Conn *conn, const char *name) {
+    room->player_active[seat] = true;
+    room->clients[seat] = conn_ref(conn);
+    snprintf(room->player_name[seat], sizeof(room->player_name[seat]), "%s", name);
+    room->player_token[seat] = new_token(room, seat);
+    room->player_count++;
+    wal_seat_locked(room, seat);
+}
+
+struct Room *room_join(const struct Rules *rules, struct Conn *conn, const char *name, int *out_seat) {
+    int ri = rules_index(rules);
+
+    pthread_mutex_lock(&gameData->lobby_mutex);
+
+    int rid = gameData->open_room[ri];
+    if (rid < 0) {
+        if (gameData->free_top == 0) {
+            pthread_mutex_unlock(&gameData->lobby_mutex);
+            return NULL;
+        }
+        rid = gameData->free_rooms[--gameData->free_top];
+        gameData->open_room[ri] = rid;
+        gameData->rooms[rid].rules = rules;
+        if (rid + 1 > gameData->room_high_water) gameData->room_high_water = rid + 1;
+    }
+
+    struct Room *room = &gameData->rooms[rid];
+
+    pthread_mutex_lock(&room->board_mutex);
+    int seat = -1;
+    for (int i = 0; i < rules->players; i++) {
+        if (!room->player_active[i]) {
+            seat = i;
+            seat_locked(room, i, conn, name);
+            break;
+        }
+    }
+    room->in_use = true;
+    bool full = (room->player_count >= rules->players);
+    pthread_mutex_unlock(&room->board_mutex);
+
+    // table is complete, next player opens a new room
+    if (full) gameData->open_room[ri] = -1;
+
+    pthread_mutex_unlock(&gameData->lobby_mutex);
+
+    *out_seat = seat;
+    return room;
+}
+
+// the matchmaker's batch: `tables` full tables from fresh rooms, one
+// lobby lock for all of them. conns holds rules->players per table, in
+// seat order. Returns how many were seated (fewer when the pool runs out)
+int room_open_tables(const struct Rules *rules, struct Conn **conns, int tables, struct Room **out) {
+    int players = rules->players;
+
+    pthread_mutex_lock(&gameData->lobby_mutex);
+    int t = 0;
+    for (; t < tables && gameData->free_top > 0; t++) {
+        int rid = gameData->free_rooms[--gameData->free_top];
+        if (rid + 1 > gameData->room_high_water) gameData->room_high_water = rid + 1;
+
+        struct Room *room = &gameData->rooms[rid];
+        pthread_mutex_lock(&room->board_mutex);
+        room->rules = rules;
+        for (int i = 0; i < players; i++) {
+            struct Conn *c = conns[t * players + i];
+            seat_locked(room, i, c, c->name);
+        }
+        room->in_use = true;
+        pthread_mutex_unlock(&room->board_mutex);
+        out[t] = room;
+    }
+    pthread_mutex_unlock(&gameData->lobby_mutex);
+    return t;
+}
+
+// lobby + room locked
+static void leave_locked(struct Room *room, int seat) {
+    if (!room->player_active[seat]) return;
+    room->player_active[seat] = false;
+    if (room->clients[seat]) conn_unref(room->clients[seat]);
+    room->clients[seat] = NULL;
+    room->player_symbol[seat] = 0;
+    room->player_token[seat] = 0;
+    room->seat_deadline[seat] = 0;
+    room->turn_misses[seat] = 0;
+    room->player_count--;
+    wal_record_locked(room, WAL_LEAVE, seat, 0, 0);
+}
+
+// after seats were freed: an empty room goes back to the pool,
+// a half-empty one is offered to the next player
+static void settle_locked(struct Room *room) {
+    int ri = rules_index(room->rules);
+
+    // AI seats only keep humans company
+    if (humans_locked(room) <= 0) {
+        room_reset_locked(room);
+        room->in_use = false;
+        if (gameData->open_room[ri] == room->id) gameData->open_room[ri] = -1;
+        gameData->free_rooms[gameData->free_top++] = room->id;
+    } else if (gameData->open_room[ri] < 0) {
+        gameData->open_room[ri] = room->id;
+    }
+}
+
+// the seat to move is gone: play goes on with the next one
+static void leave_turn_locked(struct Room *room, int seat) {
+    if (room->in_use && room->current_turn_id == seat) room_pass_turn_locked(room);
+}
+
+// free a seat
+void room_leave(struct Room *room, int seat) {
+    pthread_mutex_lock(&gameData->lobby_mutex);
+    pthread_mutex_lock(&room->board_mutex);
+
+    leave_locked(room, seat);
+    settle_locked(room);
+
+    pthread_mutex_unlock(&gameData->lobby_mutex);
+    leave_turn_locked(room, seat);
+    room_unlock(room);
+}
+
+/* ---------- held seats ---------- */
+
+static void reclaim_cb(void *arg);
+
+// reclaim_timer follows the earliest held seat; room locked
+static void arm_reclaim_locked(struct Room *room) {
+    long long first = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        long long d = room->seat_deadline[i];
+        if (d && (!first || d < first)) first = d;
+    }
+    if (!first) {
+        timer_cancel(&room->reclaim_timer);
+        return;
+    }
+    long long wait = first - now_ms();
+    timer_arm(&room->reclaim_timer, wait > 0 ? wait : 0, reclaim_cb, room);
+}
+
+static void hold_seat_locked(struct Room *room, int seat, long long ms) {
+    room->seat_deadline[seat] = now_ms() + ms;
+    arm_reclaim_locked(room);
+}
+
+// held seats whose player didn't make it back in time are freed
+static void reclaim_cb(void *arg) {
+    struct Room *room = arg;
+
+    pthread_mutex_lock(&gameData->lobby_mutex);
+    pthread_mutex_lock(&room->board_mutex);
+
+    int turn_left = -1;
+    if (room->in_use) {
+        long long now = now_ms();
+        bool freed = false;
+        for (int i = 0; i < room->rules->players; i++) {
+            if (!room->seat_deadline[i] || room->seat_deadline[i] > now) continue;
+            printf("Room %d: Player %d did not come back.\n", room->id, i + 1);
+            if (room->current_turn_id == i) turn_left = i;
+            leave_locked(room, i);
+            freed = true;
+        }
+        if (freed) settle_locked(room);
+        if (room->in_use) arm_reclaim_locked(room);
+    }
+
+    pthread_mutex_unlock(&gameData->lobby_mutex);
+    if (turn_left >= 0) leave_turn_locked(room, turn_left);
+    room_unlock(room);
+}
+
+// the seat's connection closed. The seat is held for grace_ms so its
+// player can come back with the seat token (-G 0: freed right away).
+// returns true if held
+bool room_drop(struct Room *room, int seat, struct Conn *conn) {
+    pthread_mutex_lock(&room->board_mutex);
+    bool owner = room->clients[seat] == conn; // false: a /resume took the seat over
+    if (owner && grace_ms > 0) {
+        conn_unref(conn);
+        room->clients[seat] = NULL;
+        hold_seat_locked(room, seat, grace_ms);
+    }
+    pthread_mutex_unlock(&room->board_mutex);
+
+    if (owner && grace_ms <= 0) room_leave(room, seat);
+    return owner && grace_ms > 0;
+}
+
+// the player kept letting the move clock run out: the connection is
+// closed and the seat expires like a hold nobody came back for (the
+// token no longer works). room locked
+void room_forfeit_locked(struct Room *room, int seat) {
+    struct Conn *c = room->clients[seat];
+    if (c) {
+        shutdown(c->fd, SHUT_RDWR); // its reactor closes it, room_drop() leaves the seat alone
+        conn_unref(c);
+        room->clients[seat] = NULL;
+    }
+    room->player_token[seat] = 0;
+    hold_seat_locked(room, seat, 0);
+}
+
+// after wal_recover(): rooms pick up where they were. Human seats have
+// no connection until their player comes back with the seat token
+void rooms_resume(void) {
+    for (int i = 0; i < gameData->room_high_water; i++) {
+        struct Room *room = &gameData->rooms[i];
+        pthread_mutex_lock(&room->board_mutex);
+        if (room->in_use) {
+            for (int s = 0; s < room->rules->players; s++) {
+                if (room->player_active[s] && !room->player_ai[s]) hold_seat_locked(room, s, RECLAIM_MS);
+            }
+            room_resume_locked(room);
+        }
+        room_unlock(room);
+    }
+}
+
+// hand a seat to the connection holding its token and copy the seat's
+// name into conn. A connection still on the seat (half-open, the player
+// already reconnected) is shut down. NULL if the token matches no seat
+struct Room *room_reclaim(uint64_t token, struct Conn *conn, int *out_seat) {
+    int seat = (int)(token & ((1u << TOKEN_SEAT_BITS) - 1));
+    int rid = (int)((token >> TOKEN_SEAT_BITS) & ((1u << TOKEN_ROOM_BITS) - 1));
+    if (token == 0 || rid >= MAX_ROOMS) return NULL;
+
+    struct Room *room = &gameData->rooms[rid];
+    pthread_mutex_lock(&room->board_mutex);
+    bool ok = room->in_use && room->player_active[seat] && !room->player_ai[seat] &&
+              room->player_token[seat] == token;
+    if (ok) {
+        struct Conn *old = room->clients[seat];
+        if (old) {
+            shutdown(old->fd, SHUT_RDWR); // its reactor closes it, room_drop() leaves the seat alone
+            conn_unref(old);
+        }
+        room->clients[seat] = conn_ref(conn);
+        room->seat_deadline[seat] = 0;
+        arm_reclaim_locked(room);
+        snprintf(conn->name, sizeof(conn->name), "%s", room->player_name[seat]);
+    }
+    pthread_mutex_unlock(&room->board_mutex);
+
+    if (!ok) return NULL;
+    *out_seat = seat;
+    return room;
+}
+
+// fill timer fired: give every empty seat to the AI and close the
+// table to new players, then start if the humans have their symbols
+void room_fill_ai(struct Room *room) {
+    pthread_mutex_lock(&gameData->lobby_mutex);
+    pthread_mutex_lock(&room->board_mutex);
+
+    const struct Rules *rules = room->rules;
+    int ri = rules_index(rules);
+
+    if (room->in_use && humans_locked(room) > 0 && !room->round_over && room->current_turn_id < 0) {
+        for (int i = 0; i < rules->players; i++) {
+            if (room->player_active[i]) continue;
+
+            // first symbol nobody holds yet
+            char sym = 0;
+            for (const char *c = rules->symbols; *c && !sym; c++) {
+                bool taken = false;
+                for (int j = 0; j < rules->players; j++) {
+                    if (room->player_active[j] && room->player_symbol[j] == *c) taken = true;
+                }
+                if (!taken) sym = *c;
+            }
+
+            room->player_active[i] = true;
+            room->player_ai[i] = true;
+            room->clients[i] = NULL;
+            room->player_symbol[i] = sym;
+            snprintf(room->player_name[i], sizeof(room->player_name[i]), "AI");
+            room->player_count++;
+            wal_seat_locked(room, i);
+
+            printf("Room %d: AI took seat %d (%c).\n", room->id, i + 1, sym);
+            char logBuf[96];
+            snprintf(logBuf, sizeof(logBuf), "Room %d: AI took seat %d.", room->id, i + 1);
+            log_message(logBuf);
+        }
+        if (gameData->open_room[ri] == room->id) gameData->open_room[ri] = -1;
+    }
+
+    pthread_mutex_unlock(&gameData->lobby_mutex);
+
+    room_try_start_locked(room);
+    room_unlock(room);
+}
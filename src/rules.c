@@ -0,0 +1,227 @@
+#include "game.h"
+#include <strings.h>
+
+// Rule sets: board size, win length and player count per room.
+// Everything that depends on them (win-line masks, the screen layout)
+// is generated once here at startup; rooms just point at a Rules.
+
+struct Rules rule_sets[MAX_RULES];
+int rule_count;
+
+// every rule set the server knows about
+static const struct {
+    const char *name;
+    int n, k, players;
+} known_rules[] = {
+    { "classic",    4, 4, 3 },  // 4x4, a full line wins, 3 players
+    { "three",      4, 3, 3 },  // 4x4, 3 in a row, 3 players
+    { "tictactoe",  3, 3, 2 },
+    { "gomoku",    15, 5, 2 },
+};
+
+#define KNOWN_RULES ((int)(sizeof(known_rules) / sizeof(known_rules[0])))
+
+/* ---------- screen template ---------- */
+
+struct Buf {
+    char *p;
+    size_t len, cap;
+};
+
+static void buf_putc(struct Buf *b, char ch) {
+    if (b->len + 1 >= b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 1024;
+        b->p = realloc(b->p, b->cap);
+        if (!b->p) { perror("realloc"); exit(1); }
+    }
+    b->p[b->len++] = ch;
+    b->p[b->len] = '\0';
+}
+
+static void buf_puts(struct Buf *b, const char *s) {
+    while (*s) buf_putc(b, *s++);
+}
+
+static void buf_repeat(struct Buf *b, char ch, int count) {
+    for (int i = 0; i < count; i++) buf_putc(b, ch);
+}
+
+static int digits(int v) {
+    int d = 1;
+    while (v >= 10) { v /= 10; d++; }
+    return d;
+}
+
+// Labels grid + board, the same "big" layout the 4x4 game always used.
+// Boards wider than 8 drop the padding lines and use 3-wide cells.
+static void build_screen(struct Rules *r) {
+    struct Buf b = { 0 };
+    int n = r->n;
+    int w = digits(n * n) + 1;          // label width
+    if (w < 3) w = 3;
+    bool big = (n <= 8);
+    int cw = big ? 5 : 3;               // board cell width
+
+    r->cell_offset = calloc((size_t)(n * n), sizeof(int));
+    if (!r->cell_offset) { perror("calloc"); exit(1); }
+
+    buf_puts(&b, "\n======= GRID LABELS =======\n\n");
+    for (int row = 0; row < n; row++) {
+        char num[16];
+        for (int c = 0; c < n; c++) {
+            // right-aligned label, the first column gets one extra space
+            int label = row * n + c + 1;
+            if (c) buf_puts(&b, " |");
+            buf_repeat(&b, ' ', w - digits(label) + (c == 0));
+            snprintf(num, sizeof(num), "%d", label);
+            buf_puts(&b, num);
+        }
+        buf_putc(&b, '\n');
+        if (row + 1 < n) {
+            buf_putc(&b, ' ');
+            for (int c = 0; c < n; c++) {
+                if (c) buf_putc(&b, '+');
+                buf_repeat(&b, '-', w + 1);
+            }
+            buf_putc(&b, '\n');
+        }
+    }
+
+    r->labels_len = b.len;
+    buf_puts(&b, "\n======= GAME BOARD =======\n\n");
+    for (int row = 0; row < n; row++) {
+        if (big) {
+            for (int c = 0; c < n; c++) {
+                if (c) buf_putc(&b, '|');
+                buf_repeat(&b, ' ', cw);
+            }
+            buf_putc(&b, '\n');
+        }
+
+        for (int c = 0; c < n; c++) {
+            if (c) buf_putc(&b, '|');
+            buf_repeat(&b, ' ', cw / 2);
+            r->cell_offset[row * n + c] = (int)b.len;
+            buf_putc(&b, EMPTY_CELL);
+            buf_repeat(&b, ' ', cw / 2);
+        }
+        buf_putc(&b, '\n');
+
+        if (row + 1 < n || big) {
+            // last row of the big layout closes with a padding line
+            char fill = (row + 1 < n) ? (big ? '_' : '-') : ' ';
+            for (int c = 0; c < n; c++) {
+                if (c) buf_putc(&b, (row + 1 < n && !big) ? '+' : '|');
+                buf_repeat(&b, fill, cw);
+            }
+            buf_putc(&b, '\n');
+        }
+    }
+    buf_putc(&b, '\n');
+
+    r->screen = b.p;
+    r->screen_len = b.len;
+}
+
+// small board for build_board_string: column numbers on top, row numbers down the side
+static void build_compact(struct Rules *r) {
+    struct Buf b = { 0 };
+    int n = r->n;
+    char num[16];
+
+    r->compact_offset = calloc((size_t)(n * n), sizeof(int));
+    if (!r->compact_offset) { perror("calloc"); exit(1); }
+
+    buf_puts(&b, "\n    ");
+    for (int c = 0; c < n; c++) {
+        snprintf(num, sizeof(num), "%d ", c);
+        buf_puts(&b, num);
+    }
+    buf_putc(&b, '\n');
+    for (int row = 0; row < n; row++) {
+        snprintf(num, sizeof(num), "%d | ", row);
+        buf_puts(&b, num);
+        for (int c = 0; c < n; c++) {
+            r->compact_offset[row * n + c] = (int)b.len;
+            buf_putc(&b, EMPTY_CELL);
+            buf_putc(&b, ' ');
+        }
+        buf_putc(&b, '\n');
+    }
+    buf_putc(&b, '\n');
+
+    r->compact = b.p;
+    r->compact_len = b.len;
+}
+
+/* ---------- registry ---------- */
+
+static int add_rules(const char *name) {
+    for (int i = 0; i < rule_count; i++) {
+        if (strcmp(rule_sets[i].name, name) == 0) return 0; // already on
+    }
+    if (rule_count >= MAX_RULES) return -1;
+
+    for (int i = 0; i < KNOWN_RULES; i++) {
+        if (strcmp(known_rules[i].name, name) != 0) continue;
+
+        struct Rules *r = &rule_sets[rule_count];
+        memset(r, 0, sizeof(*r));
+        r->name = known_rules[i].name;
+        r->n = known_rules[i].n;
+        r->k = known_rules[i].k;
+        r->players = known_rules[i].players;
+
+        // X, Y, Z, then W for a fourth seat
+        memcpy(r->symbols, "XYZW", (size_t)r->players);
+        r->symbols[r->players] = '\0';
+
+        size_t used = (size_t)snprintf(r->symbol_prompt, sizeof(r->symbol_prompt), "Choose your symbol (");
+        for (int p = 0; p < r->players; p++) {
+            used += (size_t)snprintf(r->symbol_prompt + used, sizeof(r->symbol_prompt) - used,
+                                     p ? "/%c" : "%c", r->symbols[p]);
+        }
+        snprintf(r->symbol_prompt + used, sizeof(r->symbol_prompt) - used, "): ");
+
+        r->turn_suffix_len = (size_t)snprintf(r->turn_suffix, sizeof(r->turn_suffix),
+                                              ">>> YOUR TURN! <<<\nInput next grid number (1-%d): ", r->n * r->n);
+        r->wait_suffix_len = (size_t)snprintf(r->wait_suffix, sizeof(r->wait_suffix),
+                                              ">>> Waiting for opponent's move... <<<\n");
+
+        if (engine_build(&r->lines, r->n, r->k) < 0) return -1;
+        build_screen(r);
+        build_compact(r);
+
+        rule_count++;
+        return 0;
+    }
+    return -1;
+}
+
+// comma separated, e.g. "classic,gomoku"; the first one is the default
+int rules_enable(const char *list) {
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s", list);
+
+    char *save = NULL;
+    for (char *tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (add_rules(tok) < 0) {
+            fprintf(stderr, "Unknown rule set: %s (known:", tok);
+            for (int i = 0; i < KNOWN_RULES; i++) fprintf(stderr, " %s", known_rules[i].name);
+            fprintf(stderr, ")\n");
+            return -1;
+        }
+    }
+    return rule_count > 0 ? 0 : -1;
+}
+
+const struct Rules *rules_find(const char *name) {
+    for (int i = 0; i < rule_count; i++) {
+        if (strcasecmp(rule_sets[i].name, name) == 0) return &rule_sets[i];
+    }
+    return NULL;
+}
+
+int rules_index(const struct Rules *rules) {
+    return (int)(rules - rule_sets);
+}
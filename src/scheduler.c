@@ -1,184 +1,252 @@
 #include "game.h"
 
-void reset_board() {
+static int turn_ms = TURN_MS_DEFAULT;
+
+void turns_init(int ms) {
+    turn_ms = ms;
+}
+
+void reset_board(struct Room *room) {
     // Clear board
-    for (int r = 0; r < BOARD_N; r++) {
-        for (int c = 0; c < BOARD_N; c++) gameData->board[r][c] = EMPTY_CELL;
-    }
-    gameData->turn_complete = false;
-    gameData->draw = false;
+    memset(room->board, EMPTY_CELL, sizeof(room->board));
+    for (int i = 0; i < MAX_PLAYERS; i++) bb_clear(&room->marks[i]);
+    bb_clear(&room->occupied);
+    room->draw = false;
+    room->move_gen++;
+    room->last_cell = -1;
+    render_reset_locked(room);
 
     // Log it
-    log_message("Game Reset. New Round starting.");
+    char logBuf[96];
+    snprintf(logBuf, sizeof(logBuf), "Room %d: Game Reset. New Round starting.", room->id);
+    log_message(logBuf);
 }
 
 
-static void build_big_board(char *out, size_t out_sz) {
-    // Replace empty cells with '.' for display
-    char d[BOARD_N][BOARD_N];
-    for (int r = 0; r < BOARD_N; r++) {
-        for (int c = 0; c < BOARD_N; c++) {
-            char cell = gameData->board[r][c];
-            d[r][c] = (cell == 0 || cell == EMPTY_CELL) ? '.' : cell;
+// last move + whose turn to everyone: binary clients get a P_DELTA,
+// text clients the board (labels only the first time) and only the
+// current player sees "YOUR TURN". queued on the outbox, sent by
+// room_unlock()
+static void broadcast_turn_locked(struct Room *room) {
+    const struct Rules *rules = room->rules;
+    struct Frame *delta = NULL; // built on first use
+
+    room->seq++;
+    watch_publish_locked(room, false);
+    for (int p = 0; p < rules->players; p++) {
+        struct Conn *c = room->clients[p];
+        if (!room->player_active[p] || !c) continue;
+
+        if (c->binary) {
+            if (!delta) delta = render_delta_locked(room);
+            outbox_add(c, delta, NULL, 0, false);
+            continue;
         }
-    }
 
-    // 4x4 grid labels + big 4x4 board
-    // This prints the board in a "bigger" style (multi-line cells).
-    snprintf(out, out_sz,
-        "\n======= GRID LABELS =======\n\n"
-        "   1 |  2 |  3 |  4\n"
-        " ----+----+----+----\n"
-        "   5 |  6 |  7 |  8\n"
-        " ----+----+----+----\n"
-        "   9 | 10 | 11 | 12\n"
-        " ----+----+----+----\n"
-        "  13 | 14 | 15 | 16\n"
-        "\n"
-        "======= GAME BOARD =======\n\n"
-        "     |     |     |     \n"
-        "  %c  |  %c  |  %c  |  %c  \n"
-        "_____|_____|_____|_____\n"
-        "     |     |     |     \n"
-        "  %c  |  %c  |  %c  |  %c  \n"
-        "_____|_____|_____|_____\n"
-        "     |     |     |     \n"
-        "  %c  |  %c  |  %c  |  %c  \n"
-        "_____|_____|_____|_____\n"
-        "     |     |     |     \n"
-        "  %c  |  %c  |  %c  |  %c  \n"
-        "     |     |     |     \n"
-        "\n",
-        d[0][0], d[0][1], d[0][2], d[0][3],
-        d[1][0], d[1][1], d[1][2], d[1][3],
-        d[2][0], d[2][1], d[2][2], d[2][3],
-        d[3][0], d[3][1], d[3][2], d[3][3]
-    );
+        if (room->round_over) continue; // text players get the result as a reply
+        struct Frame *f = render_frame_locked(room, !c->seen_labels);
+        c->seen_labels = true;
+        if (p == room->current_turn_id) outbox_add(c, f, rules->turn_suffix, rules->turn_suffix_len, true);
+        else outbox_add(c, f, rules->wait_suffix, rules->wait_suffix_len, true);
+    }
+    frame_unref(delta);
+    room->last_cell = -1;
 }
 
-// server send msg to all player 
-static void broadcast_all_locked(const char *msg) {
-    for (int p = 0; p < MAX_PLAYERS; p++) {
-        if (!gameData->player_active[p]) continue;
-        int s = gameData->client_sockets[p];
-        if (s >= 0) send(s, msg, strlen(msg), 0);
+// a status for c: the code for binary clients, the sentence for humans
+static struct Frame *status_frame(struct Conn *c, enum ProtoStatus code, const char *text) {
+    if (c->binary) {
+        uint8_t b = (uint8_t)code;
+        return frame_proto(P_STATUS, &b, 1);
     }
+    struct Frame *f = frame_new(strlen(text));
+    memcpy(f->data, text, f->len);
+    return f;
 }
 
-void* scheduler_thread(void* arg) {
-    (void)arg;
-    printf("[Scheduler] Thread started. Waiting for players...\n");
+// a status for one seat, queued with the room's broadcasts
+static void notify_locked(struct Room *room, int seat, enum ProtoStatus code, const char *text) {
+    struct Conn *c = room->clients[seat];
+    if (!c) return;
+    struct Frame *f = status_frame(c, code, text);
+    outbox_add(c, f, NULL, 0, false);
+    frame_unref(f);
+}
 
-    while (1) {
-        pthread_mutex_lock(&gameData->board_mutex);
+/* ---------- move clock ---------- */
 
-        if (!gameData->game_active) {
-            pthread_mutex_unlock(&gameData->board_mutex);
-            break;
+static void advance_turn_locked(struct Room *room);
+static void turn_timeout_cb(void *arg);
+
+// a human to move gets turn_ms for it (AI seats have their own budget)
+static void arm_turn_locked(struct Room *room) {
+    int seat = room->current_turn_id;
+    if (turn_ms <= 0 || room->round_over || seat < 0 || room->player_ai[seat]) {
+        room->turn_deadline = 0;
+        timer_cancel(&room->turn_timer);
+        return;
+    }
+    room->turn_deadline = now_ms() + turn_ms;
+    timer_arm(&room->turn_timer, turn_ms, turn_timeout_cb, room);
+}
+
+// the clock ran out: skip the turn, or give up the seat of a player
+// who keeps letting it run out
+static void turn_timeout_cb(void *arg) {
+    struct Room *room = arg;
+
+    pthread_mutex_lock(&room->board_mutex);
+    int seat = room->current_turn_id;
+
+    // a move may have beaten us here; the next turn has its own deadline
+    if (room->in_use && !room->round_over && seat >= 0 && room->turn_deadline &&
+        room->turn_deadline <= now_ms()) {
+        room->turn_deadline = 0;
+
+        if (++room->turn_misses[seat] >= TURN_MISSES_FORFEIT) {
+            printf("Room %d: Player %d ran out of time again, seat given up.\n", room->id, seat + 1);
+            struct Conn *c = room->clients[seat];
+            if (c) {
+                // straight out: the connection closes before the outbox would flush
+                struct Frame *f = status_frame(c, ST_TIMED_OUT, "Timed out: you let your turn run out again and lost your seat.\n");
+                conn_send(c, f, NULL, 0, false);
+                frame_unref(f);
+            }
+            room_forfeit_locked(room, seat); // freed on the wheel's next tick, the turn passes then
+        } else {
+            printf("Room %d: Player %d ran out of time, turn skipped.\n", room->id, seat + 1);
+            notify_locked(room, seat, ST_TURN_SKIPPED, "Time is up, your turn was skipped.\n");
+            advance_turn_locked(room);
         }
+    }
+    room_unlock(room);
+}
 
-        // If round ended (someone won / draw)
-        if (gameData->round_over) {
-            pthread_mutex_unlock(&gameData->board_mutex);
+// timer callback: 5s after a round ended
+static void round_reset_cb(void *arg) {
+    struct Room *room = arg;
+
+    pthread_mutex_lock(&room->board_mutex);
+    // room may have emptied (and been reset) since the timer was armed
+    if (room->in_use && room->round_over) {
+        reset_board(room);
+        room->round_over = false;
+        room->current_turn_id = -1;
+        room->seq++;
+        watch_publish_locked(room, true);
+        wal_record_locked(room, WAL_RESET, -1, 0, 0);
+
+        // Broadcast new empty board to everyone, a fresh snapshot for binary clients
+        for (int p = 0; p < room->rules->players; p++) {
+            struct Conn *c = room->clients[p];
+            if (!room->player_active[p] || !c) continue;
+            struct Frame *f = c->binary ? render_bin_frame_locked(room) : render_frame_locked(room, !c->seen_labels);
+            c->seen_labels = true;
+            outbox_add(c, f, NULL, 0, true);
+        }
 
-            log_message("Round Over. Resetting in 5s...");
-            sleep(5);
+        room_try_start_locked(room);
+    }
+    room_unlock(room);
+}
 
-            pthread_mutex_lock(&gameData->board_mutex);
-            reset_board();
-            gameData->round_over = false;
-            gameData->current_turn_id = -1;
+// Start when the rule set's seats are full AND all chosen symbols
+void room_try_start_locked(struct Room *room) {
+    int players = room->rules->players;
+    if (room->round_over || room->current_turn_id >= 0) return;
+    if (room->player_count < players) {
+        ai_fill_later_locked(room); // nobody else showing up -> AI seats
+        return;
+    }
 
-            // Broadcast new empty board to everyone
-            char screen[2048];
-            build_big_board(screen, sizeof(screen));
-            broadcast_all_locked(screen);
+    int chosen = 0;
+    for (int i = 0; i < players; i++) {
+        if (room->player_active[i] && room->player_symbol[i] != 0) chosen++;
+    }
+    if (chosen < players) return;
 
-            pthread_mutex_unlock(&gameData->board_mutex);
-            continue;
+    // First start broadcast
+    for (int i = 0; i < players; i++) {
+        if (room->player_active[i]) {
+            room->current_turn_id = i;
+            break;
         }
+    }
+    wal_record_locked(room, WAL_TURN, -1, room->current_turn_id, 0);
+    arm_turn_locked(room);
+    broadcast_turn_locked(room);
+    if (room->player_ai[room->current_turn_id]) ai_request_move_locked(room);
+}
 
-        // Start when >= MIN_PLAYERS AND all chosen symbols
-        bool ready = (gameData->player_count >= MIN_PLAYERS);
-        if (ready) {
-            int chosen = 0;
-            for (int i = 0; i < MAX_PLAYERS; i++) {
-                if (gameData->player_active[i] && gameData->player_symbol[i] != 0) chosen++;
-            }
-            if (chosen < MIN_PLAYERS) ready = false;
-        }
+// next occupied seat after the one to move, at most one lap; -1 if
+// every seat is empty
+static int next_seat_locked(struct Room *room) {
+    int players = room->rules->players;
+    for (int i = 1; i <= players; i++) {
+        int seat = (room->current_turn_id + i) % players;
+        if (room->player_active[seat]) return seat;
+    }
+    return -1;
+}
 
-        // First start broadcast
-        if (ready && gameData->current_turn_id < 0) {
-            for (int i = 0; i < MAX_PLAYERS; i++) {
-                if (gameData->player_active[i]) {
-                    gameData->current_turn_id = i;
-                    break;
-                }
-            }
+// rotate turn and broadcast updated board
+static void advance_turn_locked(struct Room *room) {
+    int next = next_seat_locked(room);
+    room->current_turn_id = next;
+    wal_record_locked(room, WAL_TURN, -1, next, 0);
+    arm_turn_locked(room);
+    if (next < 0) return;
 
-            char screen[2048];
-            build_big_board(screen, sizeof(screen));
-
-            // Only current player sees "YOUR TURN"
-            for (int p = 0; p < MAX_PLAYERS; p++) {
-                if (!gameData->player_active[p]) continue;
-                int s = gameData->client_sockets[p];
-                if (s < 0) continue;
-
-                if (p == gameData->current_turn_id) {
-                    char msg[2600];
-                    snprintf(msg, sizeof(msg),
-                             "%s>>> YOUR TURN! <<<\nInput next grid number (1-16): ",
-                             screen);
-                    send(s, msg, strlen(msg), 0);
-                } else {
-                    char waitmsg[2600];
-                    snprintf(waitmsg, sizeof(waitmsg),
-                             "%s>>> Waiting for opponent's move... <<<\n",
-                             screen);
-                    send(s, waitmsg, strlen(waitmsg), 0);
-                }
-            }
-        }
+    broadcast_turn_locked(room);
+    if (room->player_ai[next]) ai_request_move_locked(room);
+}
 
-        // After a move, rotate turn and broadcast updated board
-        if (gameData->turn_complete && gameData->current_turn_id >= 0) {
-            int next = gameData->current_turn_id;
-            do {
-                next = (next + 1) % MAX_PLAYERS;
-            } while (!gameData->player_active[next]);
-
-            gameData->current_turn_id = next;
-            gameData->turn_complete = false;
-
-            char screen[2048];
-            build_big_board(screen, sizeof(screen));
-
-            for (int p = 0; p < MAX_PLAYERS; p++) {
-                if (!gameData->player_active[p]) continue;
-                int s = gameData->client_sockets[p];
-                if (s < 0) continue;
-
-                if (p == gameData->current_turn_id) {
-                    char turnmsg[2600];
-                    snprintf(turnmsg, sizeof(turnmsg),
-                             "%s>>> YOUR TURN! <<<\nInput next grid number (1-16): ",
-                             screen);
-                    send(s, turnmsg, strlen(turnmsg), 0);
-                } else {
-                    char waitmsg[2600];
-                    snprintf(waitmsg, sizeof(waitmsg),
-                             "%s>>> Waiting for opponent's move... <<<\n",
-                             screen);
-                    send(s, waitmsg, strlen(waitmsg), 0);
-                }
-            }
-        }
+// called by the mover right after a placed piece, no polling in between
+void room_move_done_locked(struct Room *room) {
+    // If round ended (someone won / draw)
+    if (room->round_over) {
+        char logBuf[96];
+        snprintf(logBuf, sizeof(logBuf), "Room %d: Round Over. Resetting in 5s...", room->id);
+        log_message(logBuf);
+
+        arm_turn_locked(room);       // stops the clock
+        broadcast_turn_locked(room); // final move, binary clients only
+        timer_arm(&room->reset_timer, 5000, round_reset_cb, room);
+        return;
+    }
+
+    advance_turn_locked(room);
+}
+
+// the player to move left for good: the turn goes on without them
+void room_pass_turn_locked(struct Room *room) {
+    if (room->round_over || room->current_turn_id < 0 || room->player_active[room->current_turn_id]) return;
+    advance_turn_locked(room);
+}
 
-        pthread_mutex_unlock(&gameData->board_mutex);
-        usleep(100000);
+// a room recovered from the journal: arm what was pending when the
+// server went down (reset after a finished round, the AI's move, the
+// start or the AI fill of a table still filling up)
+void room_resume_locked(struct Room *room) {
+    room->seq++;
+    watch_publish_locked(room, true); // the board as the journal left it
+    if (room->round_over) {
+        timer_arm(&room->reset_timer, 5000, round_reset_cb, room);
+    } else if (room->current_turn_id >= 0) {
+        arm_turn_locked(room);
+        if (room->player_ai[room->current_turn_id]) ai_request_move_locked(room);
+    } else {
+        room_try_start_locked(room);
     }
+}
+
+// drives the timer wheel: the move clocks, AI fill, round resets, held
+// seats and connection limits. turns themselves are dispatched by the mover
+void* scheduler_thread(void* arg) {
+    (void)arg;
+    printf("[Scheduler] Thread started. Waiting for players...\n");
+
+    timer_run();
 
     return NULL;
 }
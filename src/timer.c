@@ -0,0 +1,192 @@
+#include "game.h"
+
+// Hierarchical timer wheel driven by the scheduler thread.
+// WHEEL_LEVELS wheels of WHEEL_SLOTS slots: a level 0 slot is one
+// TICK_MS tick, every level up is WHEEL_SLOTS times coarser. A timer
+// sits in the lowest level that reaches its tick and drops a level
+// (cascades) when its slot comes round, so arm and cancel are O(1) and
+// a timer is moved at most WHEEL_LEVELS - 1 times before it fires.
+//   level 0: 2.56 s   level 1: 11 min   level 2: 46 h   level 3: 497 days
+// A due slot is moved to FIRE_SLOT and fired one timer at a time; until
+// its callback starts a timer there is still armed, so cancel/arm take
+// it out like from any other slot.
+
+#define WHEEL_BITS 8
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1LL << (WHEEL_BITS * WHEEL_LEVELS)) // ticks, longer delays are clamped
+#define TICK_MS 10
+#define FIRE_SLOT (WHEEL_LEVELS * WHEEL_SLOTS)  // due now, callbacks not run yet
+
+static struct Timer *wheel[WHEEL_LEVELS * WHEEL_SLOTS + 1];
+static long long cur_tick;      // last tick already processed
+static int pending;             // armed timers
+static int near;                // armed timers in level 0
+static pthread_mutex_t wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wheel_cond;
+
+long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void timer_init(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wheel_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    cur_tick = now_ms() / TICK_MS;
+}
+
+/* ---------- list helpers (wheel_mutex held) ---------- */
+
+// into the slot for t->tick as seen from cur_tick (t->tick >= cur_tick)
+static void place_locked(struct Timer *t) {
+    long long delta = t->tick - cur_tick;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= 1LL << (WHEEL_BITS * (level + 1))) level++;
+
+    int slot = level * WHEEL_SLOTS + (int)((t->tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    t->slot = slot;
+    t->prev = NULL;
+    t->next = wheel[slot];
+    if (wheel[slot]) wheel[slot]->prev = t;
+    wheel[slot] = t;
+    if (level == 0) near++;
+}
+
+static void unlink_locked(struct Timer *t) {
+    if (t->prev) t->prev->next = t->next;
+    else wheel[t->slot] = t->next;
+    if (t->next) t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+    if (t->slot < WHEEL_SLOTS) near--;
+}
+
+// cur_tick reached the start of `level`'s current slot: everything in
+// it is due within one slot of the level below, move it down.
+// returns the slot index so the caller knows whether to go up a level
+static int cascade_locked(int level) {
+    int idx = (int)((cur_tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    struct Timer *t = wheel[level * WHEEL_SLOTS + idx];
+    wheel[level * WHEEL_SLOTS + idx] = NULL;
+    while (t) {
+        struct Timer *next = t->next;
+        place_locked(t);
+        t = next;
+    }
+    return idx;
+}
+
+/* ---------- public api ---------- */
+
+// (re)arm t to call fn(arg) after delay_ms, from the scheduler thread
+void timer_arm(struct Timer *t, long long delay_ms, void (*fn)(void *arg), void *arg) {
+    pthread_mutex_lock(&wheel_mutex);
+
+    if (t->armed) {
+        unlink_locked(t);
+        pending--;
+    }
+
+    // wheel was idle: skip the ticks nobody was waiting on
+    if (pending == 0) cur_tick = now_ms() / TICK_MS;
+
+    long long tick = (now_ms() + delay_ms + TICK_MS - 1) / TICK_MS;
+    if (tick <= cur_tick) tick = cur_tick + 1;
+    if (tick - cur_tick >= WHEEL_SPAN) tick = cur_tick + WHEEL_SPAN - 1;
+
+    t->fn = fn;
+    t->arg = arg;
+    t->tick = tick;
+    t->armed = true;
+
+    // the scheduler sleeps to the next cascade while level 0 is empty
+    int was_near = near;
+    place_locked(t);
+    if (pending++ == 0 || (was_near == 0 && near > 0)) pthread_cond_signal(&wheel_cond);
+    pthread_mutex_unlock(&wheel_mutex);
+}
+
+// true if t was armed (it won't fire, even if it was due); false if it
+// had already fired or its callback is running right now
+bool timer_cancel(struct Timer *t) {
+    pthread_mutex_lock(&wheel_mutex);
+    bool armed = t->armed;
+    if (armed) {
+        unlink_locked(t);
+        t->armed = false;
+        pending--;
+    }
+    pthread_mutex_unlock(&wheel_mutex);
+    return armed;
+}
+
+bool timer_pending(struct Timer *t) {
+    pthread_mutex_lock(&wheel_mutex);
+    bool armed = t->armed;
+    pthread_mutex_unlock(&wheel_mutex);
+    return armed;
+}
+
+// Scheduler loop: sleeps while nothing is armed, wakes once per tick
+// while level 0 has timers and only for cascades otherwise.
+// Callbacks run without wheel_mutex so they can arm/cancel timers themselves.
+void timer_run(void) {
+    pthread_mutex_lock(&wheel_mutex);
+
+    while (gameData->game_active) {
+        if (pending == 0) {
+            pthread_cond_wait(&wheel_cond, &wheel_mutex);
+            continue;
+        }
+
+        long long target = near ? cur_tick + 1 : (cur_tick | WHEEL_MASK) + 1;
+        long long next_ms = target * TICK_MS;
+        if (now_ms() < next_ms) {
+            struct timespec ts;
+            ts.tv_sec = next_ms / 1000;
+            ts.tv_nsec = (next_ms % 1000) * 1000000;
+            pthread_cond_timedwait(&wheel_cond, &wheel_mutex, &ts);
+            continue;
+        }
+
+        // nothing in level 0 fires before target
+        cur_tick = target;
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if (cur_tick & ((1LL << (WHEEL_BITS * level)) - 1)) break;
+            if (cascade_locked(level) != 0) break;
+        }
+
+        // everything in this level 0 slot is due now
+        int slot = (int)(cur_tick & WHEEL_MASK);
+        if (!wheel[slot]) continue;
+        for (struct Timer *t = wheel[slot]; t; t = t->next) {
+            t->slot = FIRE_SLOT;
+            near--;
+        }
+        wheel[FIRE_SLOT] = wheel[slot];
+        wheel[slot] = NULL;
+
+        // one at a time: a callback may cancel or re-arm (or free) the
+        // timers still waiting behind it
+        struct Timer *t;
+        while ((t = wheel[FIRE_SLOT])) {
+            unlink_locked(t);
+            t->armed = false;
+            pending--;
+            void (*fn)(void *arg) = t->fn;
+            void *arg = t->arg;
+
+            pthread_mutex_unlock(&wheel_mutex);
+            fn(arg);
+            pthread_mutex_lock(&wheel_mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&wheel_mutex);
+}
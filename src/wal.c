@@ -0,0 +1,595 @@
+#include "game.h"
+
+// Game journal. Every change to a room (seat taken, symbol, turn, move,
+// reset, seat freed) is appended here by whoever changes it, with the
+// room locked, and numbered by the room's own wal_seq. The journal
+// writer thread group-commits: whatever piled up while the previous
+// fdatasync() ran goes out in one write() and one fdatasync().
+//
+// Every WAL_SNAPSHOT_SECS (or WAL_SNAPSHOT_BYTES of journal) the writer
+// moves game.wal aside to game.wal.old, starts a new one and copies
+// every room, one room lock at a time, into game.snap.tmp, which is
+// fsynced and renamed over game.snap; then game.wal.old goes. Rooms keep
+// changing while they are copied, so a record can be both in the
+// snapshot and in the new journal: replay skips any record whose seq
+// the room already has. A crash at any point leaves a snapshot plus
+// journals that cover everything after it; a torn record at the end
+// fails its checksum and is where replay stops.
+//
+// Connections are not recovered: seated humans come back as empty
+// seats that keep their name, symbol and token until RECLAIM_MS runs
+// out (rooms_resume).
+
+#define WAL_FILE "game.wal"
+#define WAL_OLD "game.wal.old"
+#define SNAP_FILE "game.snap"
+#define SNAP_TMP "game.snap.tmp"
+#define WAL_MAGIC "TTTWAL01"
+#define SNAP_MAGIC "TTTSNAP1"
+#define MAGIC_LEN 8
+#define GAME_NAME_LEN 16
+
+struct WalRecord {
+    uint32_t check;                 // wal_check() of the rest, payload included
+    uint32_t room;
+    uint32_t seq;                   // room->wal_seq after this change
+    uint8_t type;                   // enum WalType
+    uint8_t seat;
+    uint8_t a, b;
+};
+
+struct WalSeat {
+    uint64_t token;
+    char name[NAME_LEN];
+    char game[GAME_NAME_LEN];       // rule set, by name: -g may list them in another order next time
+    uint8_t ai;
+    uint8_t symbol;
+    uint8_t pad[6];
+};
+
+// game.snap: SNAP_MAGIC, a SnapHeader, `rooms` u32 wal_seqs (room 0 up),
+// then `in_use` SnapRooms
+struct SnapHeader {
+    uint32_t rooms;
+    uint32_t in_use;
+};
+
+struct SnapRoom {
+    uint32_t check;
+    uint32_t id;
+    char game[GAME_NAME_LEN];
+    int8_t turn;
+    uint8_t round_over, draw;
+    uint8_t active[MAX_PLAYERS];
+    uint8_t ai[MAX_PLAYERS];
+    char symbol[MAX_PLAYERS];
+    uint8_t pad[1];
+    uint64_t token[MAX_PLAYERS];
+    char name[MAX_PLAYERS][NAME_LEN];
+    char board[MAX_CELLS];
+};
+
+struct WalBuf {
+    char *data;
+    size_t len, cap;
+};
+
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wal_cond;     // writer: records pending
+static pthread_cond_t synced_cond;  // wal_sync(): durable moved on
+static struct WalBuf pending;       // appended to under wal_mutex
+static struct WalBuf writing;       // owned by the writer thread
+static unsigned long long appended, durable;   // bytes, under wal_mutex
+static bool writer_stop;
+static pthread_t writer;
+
+static int wal_fd = -1;
+static size_t wal_bytes;            // in game.wal since the last snapshot
+static bool old_pending;            // game.wal.old is not covered by a snapshot yet
+static bool frozen;                 // wal_close() holds the lobby and every room until exit
+
+/* ---------- helpers ---------- */
+
+static uint32_t wal_check(const void *p, size_t len) {
+    const uint8_t *b = p;
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = sizeof(uint32_t); i < len; i++) h = (h ^ b[i]) * 16777619u;
+    return h ? h : 1;
+}
+
+static size_t record_len(uint8_t type) {
+    return sizeof(struct WalRecord) + (type == WAL_SEAT ? sizeof(struct WalSeat) : 0);
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+static void sync_dir(void) {
+    int fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+// whole file into memory, NULL if it isn't there or doesn't start with magic
+static char *read_file(const char *path, const char *magic, size_t *out_len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    char *data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size >= MAGIC_LEN) data = malloc((size_t)st.st_size);
+    size_t len = 0;
+    while (data && len < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + len, (size_t)st.st_size - len);
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    close(fd);
+
+    if (data && len >= MAGIC_LEN && memcmp(data, magic, MAGIC_LEN) == 0) {
+        *out_len = len;
+        return data;
+    }
+    if (data || len) fprintf(stderr, "%s: unreadable, ignoring it\n", path);
+    free(data);
+    return NULL;
+}
+
+// fresh game.wal with just the magic
+static void open_wal(void) {
+    wal_fd = open(WAL_FILE, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (wal_fd < 0 || !write_all(wal_fd, WAL_MAGIC, MAGIC_LEN) || fdatasync(wal_fd) < 0) {
+        perror(WAL_FILE);
+        exit(1);
+    }
+    sync_dir();
+    wal_bytes = 0;
+}
+
+/* ---------- snapshot ---------- */
+
+static void capture_room_locked(struct Room *room, struct SnapRoom *s) {
+    memset(s, 0, sizeof(*s));
+    s->id = (uint32_t)room->id;
+    snprintf(s->game, sizeof(s->game), "%s", room->rules->name);
+    s->turn = (int8_t)room->current_turn_id;
+    s->round_over = room->round_over;
+    s->draw = room->draw;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        s->active[i] = room->player_active[i];
+        s->ai[i] = room->player_ai[i];
+        s->symbol[i] = room->player_symbol[i];
+        s->token[i] = room->player_token[i];
+        memcpy(s->name[i], room->player_name[i], NAME_LEN);
+    }
+    memcpy(s->board, room->board, sizeof(s->board));
+    s->check = wal_check(s, sizeof(*s));
+}
+
+// every room into game.snap; rooms are locked one at a time (already
+// are, once frozen)
+static bool snapshot(void) {
+    if (!frozen) pthread_mutex_lock(&gameData->lobby_mutex);
+    uint32_t rooms = (uint32_t)gameData->room_high_water;
+    if (!frozen) pthread_mutex_unlock(&gameData->lobby_mutex);
+
+    uint32_t *seqs = malloc((rooms + 1) * sizeof(*seqs));
+    struct SnapRoom *out = malloc((rooms + 1) * sizeof(*out));
+    if (!seqs || !out) { perror("snapshot"); exit(1); }
+
+    struct SnapHeader h = { rooms, 0 };
+    for (uint32_t i = 0; i < rooms; i++) {
+        struct Room *room = &gameData->rooms[i];
+        if (!frozen) pthread_mutex_lock(&room->board_mutex);
+        seqs[i] = room->wal_seq;
+        if (room->in_use) capture_room_locked(room, &out[h.in_use++]);
+        if (!frozen) pthread_mutex_unlock(&room->board_mutex);
+    }
+
+    int fd = open(SNAP_TMP, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 &&
+              write_all(fd, SNAP_MAGIC, MAGIC_LEN) &&
+              write_all(fd, &h, sizeof(h)) &&
+              write_all(fd, seqs, rooms * sizeof(*seqs)) &&
+              write_all(fd, out, h.in_use * sizeof(*out)) &&
+              fsync(fd) == 0 &&
+              rename(SNAP_TMP, SNAP_FILE) == 0;
+    if (fd >= 0) close(fd);
+    free(seqs);
+    free(out);
+
+    if (!ok) {
+        perror(SNAP_FILE);
+        unlink(SNAP_TMP);
+        return false; // the journals still cover everything
+    }
+    sync_dir();
+    unlink(WAL_OLD);
+    return true;
+}
+
+// new game.wal, the old one stays until a snapshot covers it. If the
+// last snapshot failed game.wal.old is still needed, so keep appending
+// to the current journal instead
+static void checkpoint(void) {
+    if (!old_pending) {
+        close(wal_fd);
+        if (rename(WAL_FILE, WAL_OLD) < 0) perror(WAL_OLD);
+        open_wal();
+    }
+    old_pending = !snapshot();
+}
+
+/* ---------- recovery ---------- */
+
+// the room a record applies to, NULL if out of range or already in the snapshot
+static struct Room *replay_room(const struct WalRecord *r) {
+    if (r->room >= MAX_ROOMS || r->seat >= MAX_PLAYERS) return NULL;
+    struct Room *room = &gameData->rooms[r->room];
+    if ((int32_t)(r->seq - room->wal_seq) <= 0) return NULL;
+    room->wal_seq = r->seq;
+    if (!room->in_use && r->type != WAL_SEAT) return NULL;
+    return room;
+}
+
+static int human_seats(const struct Room *room) {
+    int n = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (room->player_active[i] && !room->player_ai[i]) n++;
+    }
+    return n;
+}
+
+// same changes the live code made, without the sends and logs
+static void apply(const struct WalRecord *r) {
+    struct Room *room = replay_room(r);
+    if (!room) return;
+    int seat = r->seat;
+
+    switch (r->type) {
+    case WAL_SEAT: {
+        const struct WalSeat *s = (const struct WalSeat *)(r + 1);
+        char game[GAME_NAME_LEN];
+        snprintf(game, sizeof(game), "%.*s", GAME_NAME_LEN - 1, s->game);
+        const struct Rules *rules = rules_find(game);
+        if (!rules || seat >= rules->players) break;       // rule set no longer enabled
+        if (room->in_use && rules != room->rules) break;
+        if (!room->in_use) {
+            room->rules = rules;
+            room->in_use = true;
+        }
+        if (!room->player_active[seat]) room->player_count++;
+        room->player_active[seat] = true;
+        room->player_ai[seat] = s->ai;
+        room->player_symbol[seat] = (char)s->symbol;
+        room->player_token[seat] = s->token;
+        snprintf(room->player_name[seat], NAME_LEN, "%.*s", NAME_LEN - 1, s->name);
+        break;
+    }
+    case WAL_SYMBOL:
+        if (room->player_active[seat]) room->player_symbol[seat] = (char)r->a;
+        break;
+    case WAL_TURN:
+        room->current_turn_id = (r->a < room->rules->players) ? r->a : -1;
+        break;
+    case WAL_MOVE:
+        if (!room->player_active[seat] || r->a >= room->rules->n * room->rules->n) break;
+        room->board[r->a] = room->player_symbol[seat];
+        bb_set(&room->marks[seat], r->a);
+        bb_set(&room->occupied, r->a);
+        if (r->b == MOVE_WIN || r->b == MOVE_DRAW) room->round_over = true;
+        if (r->b == MOVE_DRAW) room->draw = true;
+        break;
+    case WAL_RESET:
+        memset(room->board, EMPTY_CELL, sizeof(room->board));
+        for (int i = 0; i < MAX_PLAYERS; i++) bb_clear(&room->marks[i]);
+        bb_clear(&room->occupied);
+        room->round_over = false;
+        room->draw = false;
+        room->current_turn_id = -1;
+        break;
+    case WAL_LEAVE:
+        if (room->player_active[seat]) {
+            room->player_active[seat] = false;
+            room->player_symbol[seat] = 0;
+            room->player_token[seat] = 0;
+            room->player_count--;
+        }
+        if (human_seats(room) == 0) {
+            room_reset_locked(room);
+            room->in_use = false;
+        }
+        break;
+    }
+}
+
+// returns the records applied
+static size_t replay_wal(const char *path) {
+    size_t len, off = MAGIC_LEN, applied = 0;
+    char *data = read_file(path, WAL_MAGIC, &len);
+    if (!data) return 0;
+
+    while (off + sizeof(struct WalRecord) <= len) {
+        struct WalRecord r;
+        memcpy(&r, data + off, sizeof(r));
+        size_t rl = record_len(r.type);
+        if (off + rl > len || r.check != wal_check(data + off, rl)) {
+            fprintf(stderr, "%s: stopping at a torn record at offset %zu\n", path, off);
+            break;
+        }
+        // payload follows the record, keep it aligned for apply()
+        union { struct WalRecord r; char raw[sizeof(struct WalRecord) + sizeof(struct WalSeat)]; } rec;
+        memcpy(rec.raw, data + off, rl);
+        apply(&rec.r);
+        off += rl;
+        applied++;
+    }
+    free(data);
+    return applied;
+}
+
+static void restore_room(const struct SnapRoom *s) {
+    char game[GAME_NAME_LEN];
+    snprintf(game, sizeof(game), "%.*s", GAME_NAME_LEN - 1, s->game);
+    const struct Rules *rules = rules_find(game);
+    if (s->id >= MAX_ROOMS || !rules) return;
+
+    struct Room *room = &gameData->rooms[s->id];
+    room->rules = rules;
+    room->in_use = true;
+    room->current_turn_id = (s->turn >= 0 && s->turn < rules->players) ? s->turn : -1;
+    room->round_over = s->round_over;
+    room->draw = s->draw;
+    room->player_count = 0;
+    for (int i = 0; i < rules->players; i++) {
+        room->player_active[i] = s->active[i];
+        room->player_ai[i] = s->ai[i];
+        room->player_symbol[i] = s->symbol[i];
+        room->player_token[i] = s->token[i];
+        snprintf(room->player_name[i], NAME_LEN, "%.*s", NAME_LEN - 1, s->name[i]);
+        if (s->active[i]) room->player_count++;
+    }
+
+    // bitboards from the board, symbols are unique within a room
+    int cells = rules->n * rules->n;
+    for (int c = 0; c < cells; c++) {
+        char cell = s->board[c];
+        for (int i = 0; i < rules->players && cell != EMPTY_CELL; i++) {
+            if (!room->player_active[i] || room->player_symbol[i] != cell) continue;
+            room->board[c] = cell;
+            bb_set(&room->marks[i], c);
+            bb_set(&room->occupied, c);
+        }
+    }
+}
+
+// returns the rooms in it
+static size_t load_snapshot(void) {
+    size_t len, restored = 0;
+    char *data = read_file(SNAP_FILE, SNAP_MAGIC, &len);
+    if (!data) return 0;
+
+    struct SnapHeader h;
+    size_t off = MAGIC_LEN + sizeof(h);
+    if (len >= off) memcpy(&h, data + MAGIC_LEN, sizeof(h));
+    if (len < off || h.rooms > MAX_ROOMS ||
+        len < off + h.rooms * sizeof(uint32_t) + (size_t)h.in_use * sizeof(struct SnapRoom)) {
+        fprintf(stderr, "%s: truncated, ignoring it\n", SNAP_FILE);
+        free(data);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < h.rooms; i++) {
+        memcpy(&gameData->rooms[i].wal_seq, data + off, sizeof(uint32_t));
+        off += sizeof(uint32_t);
+    }
+    for (uint32_t i = 0; i < h.in_use; i++, off += sizeof(struct SnapRoom)) {
+        struct SnapRoom s;
+        memcpy(&s, data + off, sizeof(s));
+        if (s.check != wal_check(&s, sizeof(s))) continue;
+        restore_room(&s);
+        restored++;
+    }
+    free(data);
+    return restored;
+}
+
+// free stack, open tables and high water from the recovered rooms
+static void rebuild_lobby(void) {
+    gameData->free_top = 0;
+    gameData->room_high_water = 0;
+    for (int i = MAX_ROOMS - 1; i >= 0; i--) {
+        struct Room *room = &gameData->rooms[i];
+        if (!room->in_use) {
+            gameData->free_rooms[gameData->free_top++] = i;
+            continue;
+        }
+        if (i + 1 > gameData->room_high_water) gameData->room_high_water = i + 1;
+
+        // a table still filling up (no AI seated yet) takes new players
+        bool ai = false;
+        for (int s = 0; s < MAX_PLAYERS; s++) ai |= room->player_ai[s];
+        int ri = rules_index(room->rules);
+        if (!ai && room->current_turn_id < 0 && !room->round_over &&
+            room->player_count < room->rules->players) {
+            gameData->open_room[ri] = i;
+        }
+    }
+}
+
+/* ---------- writer thread ---------- */
+
+// pending -> game.wal, one write + fdatasync
+static void flush_batch(void) {
+    pthread_mutex_lock(&wal_mutex);
+    struct WalBuf t = writing;
+    writing = pending;
+    pending = t;
+    pending.len = 0;
+    pthread_mutex_unlock(&wal_mutex);
+
+    if (writing.len == 0) return;
+    if (!write_all(wal_fd, writing.data, writing.len) || fdatasync(wal_fd) < 0) perror(WAL_FILE);
+    wal_bytes += writing.len;
+
+    pthread_mutex_lock(&wal_mutex);
+    durable += writing.len;
+    pthread_cond_broadcast(&synced_cond);
+    pthread_mutex_unlock(&wal_mutex);
+    writing.len = 0;
+}
+
+static void *wal_writer(void *arg) {
+    (void)arg;
+    long long next_snapshot = now_ms() + WAL_SNAPSHOT_SECS * 1000LL;
+
+    pthread_mutex_lock(&wal_mutex);
+    while (!writer_stop) {
+        if (pending.len == 0) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += 1;
+            pthread_cond_timedwait(&wal_cond, &wal_mutex, &until);
+        }
+        pthread_mutex_unlock(&wal_mutex);
+
+        flush_batch();
+        if (wal_bytes >= WAL_SNAPSHOT_BYTES || (wal_bytes > 0 && now_ms() >= next_snapshot)) {
+            checkpoint();
+            next_snapshot = now_ms() + WAL_SNAPSHOT_SECS * 1000LL;
+        }
+
+        pthread_mutex_lock(&wal_mutex);
+    }
+    pthread_mutex_unlock(&wal_mutex);
+    return NULL;
+}
+
+/* ---------- API ---------- */
+
+// startup, after rooms_init() and before any thread touches a room:
+// game.snap, then the journals on top; writes a fresh snapshot so the
+// next start doesn't replay the same records again
+void wal_recover(void) {
+    long long t0 = now_ms();
+    pthread_cond_init(&wal_cond, NULL);
+    pthread_cond_init(&synced_cond, NULL);
+
+    size_t rooms = load_snapshot();
+    size_t records = replay_wal(WAL_OLD);
+    records += replay_wal(WAL_FILE);
+    rebuild_lobby();
+
+    size_t live = 0, seats = 0;
+    for (int i = 0; i < gameData->room_high_water; i++) {
+        struct Room *room = &gameData->rooms[i];
+        if (!room->in_use) continue;
+        live++;
+        seats += (size_t)human_seats(room);
+    }
+
+    // snapshot first: the journals are only dropped once it is down
+    if (!snapshot()) exit(1);
+    open_wal();
+
+    if (rooms || records) {
+        printf("Recovered %zu game(s) with %zu seat(s) to reclaim (%zu from %s, %zu journal records) in %lld ms.\n",
+               live, seats, rooms, SNAP_FILE, records, now_ms() - t0);
+    }
+
+    if (pthread_create(&writer, NULL, wal_writer, NULL) != 0) {
+        perror("journal writer");
+        exit(1);
+    }
+}
+
+// wait until everything journaled so far is on disk
+void wal_sync(void) {
+    pthread_mutex_lock(&wal_mutex);
+    unsigned long long target = appended;
+    pthread_cond_signal(&wal_cond);
+    while (durable < target) pthread_cond_wait(&synced_cond, &wal_mutex);
+    pthread_mutex_unlock(&wal_mutex);
+}
+
+// shutdown: last batch, then a snapshot so the next start replays
+// nothing. The lobby and every room stay locked from here until exit,
+// so reactors, timers and AI workers can't change a room after it was
+// copied (their threads just block on it). The writer goes first: its
+// own checkpoint may be waiting for a room lock
+void wal_close(void) {
+    pthread_mutex_lock(&wal_mutex);
+    writer_stop = true;
+    pthread_cond_signal(&wal_cond);
+    pthread_mutex_unlock(&wal_mutex);
+    pthread_join(writer, NULL);
+
+    pthread_mutex_lock(&gameData->lobby_mutex);
+    for (int i = 0; i < MAX_ROOMS; i++) pthread_mutex_lock(&gameData->rooms[i].board_mutex);
+    frozen = true;
+
+    flush_batch();
+    checkpoint();
+}
+
+// room locked: the change is journaled in memory, the writer makes it durable
+static void append_locked(struct Room *room, struct WalRecord *r, const void *payload, size_t plen) {
+    r->room = (uint32_t)room->id;
+    r->seq = ++room->wal_seq;
+
+    char buf[sizeof(*r) + sizeof(struct WalSeat)];
+    memcpy(buf, r, sizeof(*r));
+    if (plen) memcpy(buf + sizeof(*r), payload, plen);
+    uint32_t check = wal_check(buf, sizeof(*r) + plen);
+    memcpy(buf, &check, sizeof(check));
+
+    pthread_mutex_lock(&wal_mutex);
+    if (pending.len + sizeof(buf) > pending.cap) {
+        size_t cap = pending.cap ? pending.cap * 2 : 64 * 1024;
+        char *p = realloc(pending.data, cap);
+        if (!p) { perror("journal"); exit(1); }
+        pending.data = p;
+        pending.cap = cap;
+    }
+    memcpy(pending.data + pending.len, buf, sizeof(*r) + plen);
+    if (pending.len == 0) pthread_cond_signal(&wal_cond);
+    pending.len += sizeof(*r) + plen;
+    appended += sizeof(*r) + plen;
+    pthread_mutex_unlock(&wal_mutex);
+}
+
+void wal_record_locked(struct Room *room, enum WalType type, int seat, int a, int b) {
+    struct WalRecord r = { 0 };
+    r.type = (uint8_t)type;
+    r.seat = (uint8_t)(seat < 0 ? 0 : seat);
+    r.a = (uint8_t)a;
+    r.b = (uint8_t)b;
+    append_locked(room, &r, NULL, 0);
+}
+
+// a seat was taken; everything a recovered seat needs
+void wal_seat_locked(struct Room *room, int seat) {
+    struct WalRecord r = { 0 };
+    struct WalSeat s;
+    memset(&s, 0, sizeof(s));
+    r.type = WAL_SEAT;
+    r.seat = (uint8_t)seat;
+    s.token = room->player_token[seat];
+    memcpy(s.name, room->player_name[seat], strnlen(room->player_name[seat], NAME_LEN - 1));
+    memcpy(s.game, room->rules->name, strnlen(room->rules->name, GAME_NAME_LEN - 1));
+    s.ai = room->player_ai[seat];
+    s.symbol = (uint8_t)room->player_symbol[seat];
+    append_locked(room, &r, &s, sizeof(s));
+}
@@ -0,0 +1,440 @@
+#include "game.h"
+#include <poll.h>
+#include <sys/eventfd.h>
+
+// Spectators. A room publishes every change once, with the room locked,
+// into its WatchChannel: the delta into a ring slot, and patched into a
+// snapshot under a seqlock. That is all the players' side pays: no
+// watcher list, no sends, no extra lock. It only writes an eventfd when
+// somebody watches the room and a fan-out thread is asleep.
+//
+// The fan-out threads own the watchers. A connection always lands on
+// the same thread (fd % threads), so the watchers of one hot table are
+// spread over all of them. Each thread follows the channels of the
+// rooms its watchers watch without taking any lock: it replays the ring
+// from where it was, or copies the snapshot when it fell more than
+// WATCH_RING behind or the board was cleared. Binary watchers get the
+// room's P_DELTAs, text watchers one screen per pass however many moves
+// it covered; every frame is built once per thread and room, and shared.
+
+#define WATCH_POLL_MS 1000      // a wakeup lost to a race costs at most this
+
+enum WatchOp { WATCH_JOIN, WATCH_LEAVE, WATCH_RESYNC };
+
+// from the connection's reactor to its fan-out thread
+struct WatchReq {
+    enum WatchOp op;
+    struct Conn *conn;          // a ref
+    int room;
+};
+
+struct Watcher {
+    struct Conn *conn;          // a ref
+    bool fresh;                 // owes a full board (joined, P_RESYNC)
+};
+
+// a room as one fan-out thread follows it
+struct WatchRoom {
+    struct Room *room;
+    const struct Rules *rules;
+    uint32_t seq;               // the mirror is the channel as of this seq
+    uint8_t turn;
+    char cells[MAX_CELLS];
+    bool fresh;                 // some watcher owes a full board
+    int listed;                 // index in the thread's list
+    struct Watcher *watchers;
+    int count, cap;
+};
+
+struct WatchThread {
+    _Alignas(64) _Atomic int sleeping;  // rooms only write wake_fd while it sleeps
+    int wake_fd;
+    pthread_t thread;
+
+    _Alignas(64) pthread_mutex_t lock;
+    struct WatchReq *reqs;
+    int req_len, req_cap;
+
+    // thread only
+    struct WatchRoom **by_room;         // MAX_ROOMS, NULL = nobody here watches it
+    struct WatchRoom **list;
+    int list_len;
+};
+
+static struct WatchThread *threads;
+static int thread_count;
+
+// the text status line under a spectator's screen
+static const char *const turn_line[MAX_PLAYERS] = {
+    "Player 1 to move.\n", "Player 2 to move.\n", "Player 3 to move.\n", "Player 4 to move.\n",
+};
+static const char idle_line[] = "Waiting for the next turn...\n";
+
+static void wake(struct WatchThread *t) {
+    if (atomic_exchange(&t->sleeping, 0)) {
+        uint64_t one = 1;
+        ssize_t w = write(t->wake_fd, &one, sizeof(one));
+        (void)w;
+    }
+}
+
+/* ---------- publishing (room locked) ---------- */
+
+static uint8_t turn_of(const struct Room *room) {
+    if (room->round_over || room->current_turn_id < 0) return 0xff;
+    return (uint8_t)room->current_turn_id;
+}
+
+// after room->seq was bumped: the move since the last broadcast (if
+// any) and the seat to move, or with `reset` the whole board
+void watch_publish_locked(struct Room *room, bool reset) {
+    struct WatchChannel *ch = &room->watch;
+    uint32_t seq = room->seq;
+    int cell = room->last_cell;
+    uint8_t turn = turn_of(room);
+    if (ch->rules != room->rules) reset = true; // the room was dealt to another rule set
+
+    uint32_t l = atomic_load_explicit(&ch->lock, memory_order_relaxed);
+    atomic_store_explicit(&ch->lock, l + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    ch->seq = seq;
+    ch->turn = turn;
+    if (reset) {
+        ch->rules = room->rules;
+        memcpy(ch->cells, room->board, sizeof(ch->cells));
+    } else if (cell >= 0) {
+        ch->cells[cell] = room->board[cell];
+    }
+    atomic_store_explicit(&ch->lock, l + 2, memory_order_release);
+
+    // a slot being rewritten reads as seq 0, never as its old or new seq
+    struct WatchDelta *d = &ch->ring[seq % WATCH_RING];
+    atomic_store_explicit(&d->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    d->cell = cell < 0 ? 0xff : (uint8_t)cell;
+    d->sym = cell < 0 ? 0 : (uint8_t)room->board[cell];
+    d->turn = turn;
+    d->reset = reset;
+    atomic_store_explicit(&d->seq, seq, memory_order_release);
+
+    // seq_cst: a thread adding the first watcher either sees this head
+    // or is seen here
+    atomic_store(&ch->head, seq);
+    if (atomic_load(&ch->watchers) == 0) return;
+    for (int i = 0; i < thread_count; i++) wake(&threads[i]);
+}
+
+/* ---------- following a channel (fan-out thread) ---------- */
+
+static void take_snapshot(struct WatchRoom *wr) {
+    struct WatchChannel *ch = &wr->room->watch;
+    const struct Rules *rules;
+    uint32_t l;
+    do {
+        while ((l = atomic_load_explicit(&ch->lock, memory_order_acquire)) & 1) {
+            // a publish is a few stores, just wait it out
+        }
+        rules = ch->rules;
+        wr->seq = ch->seq;
+        wr->turn = ch->turn;
+        memcpy(wr->cells, ch->cells, sizeof(wr->cells));
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&ch->lock, memory_order_relaxed) != l);
+    wr->rules = rules;
+}
+
+enum CatchUp { CAUGHT_NONE, CAUGHT_DELTAS, CAUGHT_SNAPSHOT };
+
+// bring the mirror up to the channel's head; the P_DELTAs it replayed
+// go to `deltas`
+static enum CatchUp catch_up(struct WatchRoom *wr, struct Frame **deltas, int *count) {
+    struct WatchChannel *ch = &wr->room->watch;
+    uint32_t head = atomic_load(&ch->head);
+    *count = 0;
+    if ((int32_t)(head - wr->seq) <= 0) return CAUGHT_NONE; // a snapshot can be ahead of head
+
+    if (head - wr->seq <= WATCH_RING) {
+        int cells = wr->rules->n * wr->rules->n;
+        for (uint32_t s = wr->seq + 1; s != head + 1; s++) {
+            struct WatchDelta *d = &ch->ring[s % WATCH_RING];
+            uint32_t s1 = atomic_load_explicit(&d->seq, memory_order_acquire);
+            uint8_t cell = d->cell, sym = d->sym, turn = d->turn;
+            bool reset = d->reset;
+            atomic_thread_fence(memory_order_acquire);
+            if (s1 != s || atomic_load_explicit(&d->seq, memory_order_relaxed) != s || reset) break;
+
+            if (cell != 0xff && cell < cells) wr->cells[cell] = (char)sym;
+            wr->turn = turn;
+            wr->seq = s;
+
+            uint8_t p[7];
+            uint32_t nseq = htonl(s);
+            memcpy(p, &nseq, 4);
+            p[4] = cell;
+            p[5] = sym;
+            p[6] = turn;
+            deltas[(*count)++] = frame_proto(P_DELTA, p, sizeof(p));
+        }
+        if (wr->seq == head) return CAUGHT_DELTAS;
+    }
+
+    // overrun, a slot already reused, or a reset
+    for (int i = 0; i < *count; i++) frame_unref(deltas[i]);
+    *count = 0;
+    take_snapshot(wr);
+    return CAUGHT_SNAPSHOT;
+}
+
+// P_BOARD of the mirror
+static struct Frame *mirror_bin(const struct WatchRoom *wr) {
+    int cells = wr->rules->n * wr->rules->n;
+    uint8_t p[6 + MAX_CELLS];
+    uint32_t seq = htonl(wr->seq);
+    p[0] = (uint8_t)wr->rules->n;
+    p[1] = wr->turn;
+    memcpy(p + 2, &seq, 4);
+    for (int i = 0; i < cells; i++) {
+        char cell = wr->cells[i];
+        p[6 + i] = (cell == 0 || cell == EMPTY_CELL) ? 0 : (uint8_t)cell;
+    }
+    return frame_proto(P_BOARD, p, 6 + (size_t)cells);
+}
+
+// whatever changed since the last pass, to everyone watching
+static void deliver(struct WatchRoom *wr) {
+    struct Frame *deltas[WATCH_RING];
+    int nd;
+    enum CatchUp got = catch_up(wr, deltas, &nd);
+    if (got == CAUGHT_NONE && !wr->fresh) return;
+
+    long long start = metrics_now();
+    struct Frame *bin = NULL, *screen[2] = { NULL, NULL }; // built on first use
+    const char *line = wr->turn < MAX_PLAYERS ? turn_line[wr->turn] : idle_line;
+
+    for (int i = 0; i < wr->count; i++) {
+        struct Watcher *w = &wr->watchers[i];
+        struct Conn *c = w->conn;
+        bool full = w->fresh || got == CAUGHT_SNAPSHOT;
+        if (!full && got == CAUGHT_NONE) continue;
+        w->fresh = false;
+
+        if (c->binary) {
+            if (full) {
+                if (!bin) bin = mirror_bin(wr);
+                conn_send(c, bin, NULL, 0, true);
+            } else {
+                for (int k = 0; k < nd; k++) conn_send(c, deltas[k], NULL, 0, false);
+            }
+            continue;
+        }
+
+        int labels = !c->seen_labels;
+        if (!screen[labels]) screen[labels] = render_board(wr->rules, wr->cells, labels);
+        c->seen_labels = true;
+        conn_send(c, screen[labels], line, strlen(line), true);
+    }
+    wr->fresh = false;
+
+    for (int k = 0; k < nd; k++) frame_unref(deltas[k]);
+    frame_unref(bin);
+    frame_unref(screen[0]);
+    frame_unref(screen[1]);
+    metrics_time(MO_WATCH, start);
+}
+
+/* ---------- watchers (fan-out thread) ---------- */
+
+static struct WatchRoom *follow(struct WatchThread *t, int id) {
+    struct WatchRoom *wr = calloc(1, sizeof(*wr));
+    if (!wr) { perror("watch"); exit(1); }
+    wr->room = &gameData->rooms[id];
+    wr->listed = t->list_len;
+    t->list[t->list_len++] = wr;
+    t->by_room[id] = wr;
+    return wr;
+}
+
+static void unfollow(struct WatchThread *t, struct WatchRoom *wr) {
+    struct WatchRoom *last = t->list[--t->list_len];
+    t->list[wr->listed] = last;
+    last->listed = wr->listed;
+    t->by_room[wr->room->id] = NULL;
+    free(wr->watchers);
+    free(wr);
+}
+
+static int find_watcher(struct WatchRoom *wr, struct Conn *conn) {
+    for (int i = 0; i < wr->count; i++) {
+        if (wr->watchers[i].conn == conn) return i;
+    }
+    return -1;
+}
+
+// takes over the request's ref
+static void add_watcher(struct WatchThread *t, struct Conn *conn, int id) {
+    struct WatchRoom *wr = t->by_room[id];
+    bool first = !wr;
+    if (first) wr = follow(t, id);
+
+    if (wr->count == wr->cap) {
+        int cap = wr->cap ? wr->cap * 2 : 8;
+        struct Watcher *w = realloc(wr->watchers, (size_t)cap * sizeof(*w));
+        if (!w) { perror("watch"); exit(1); }
+        wr->watchers = w;
+        wr->cap = cap;
+    }
+    wr->watchers[wr->count++] = (struct Watcher){ conn, true };
+    wr->fresh = true;
+
+    // counted before the snapshot is read, so nothing published after
+    // it goes by without a wakeup
+    atomic_fetch_add(&wr->room->watch.watchers, 1);
+    if (first) take_snapshot(wr);
+}
+
+static void remove_watcher(struct WatchThread *t, struct Conn *conn, int id) {
+    struct WatchRoom *wr = t->by_room[id];
+    int i = wr ? find_watcher(wr, conn) : -1;
+    if (i < 0) return;
+
+    conn_unref(wr->watchers[i].conn);
+    wr->watchers[i] = wr->watchers[--wr->count];
+    atomic_fetch_sub(&wr->room->watch.watchers, 1);
+    if (wr->count == 0) unfollow(t, wr);
+}
+
+static void apply(struct WatchThread *t, struct WatchReq *r) {
+    switch (r->op) {
+    case WATCH_JOIN:
+        add_watcher(t, r->conn, r->room);
+        return; // the ref went to the room's watcher list
+    case WATCH_LEAVE:
+        remove_watcher(t, r->conn, r->room);
+        break;
+    case WATCH_RESYNC: {
+        struct WatchRoom *wr = t->by_room[r->room];
+        int i = wr ? find_watcher(wr, r->conn) : -1;
+        if (i >= 0) wr->watchers[i].fresh = wr->fresh = true;
+        break;
+    }
+    }
+    conn_unref(r->conn);
+}
+
+// something to do right away: a request, or a room ahead of us
+static bool pending(struct WatchThread *t) {
+    pthread_mutex_lock(&t->lock);
+    bool reqs = t->req_len > 0;
+    pthread_mutex_unlock(&t->lock);
+    if (reqs) return true;
+
+    for (int i = 0; i < t->list_len; i++) {
+        struct WatchRoom *wr = t->list[i];
+        if (wr->fresh || (int32_t)(atomic_load(&wr->room->watch.head) - wr->seq) > 0) return true;
+    }
+    return false;
+}
+
+static void *watch_thread(void *arg) {
+    struct WatchThread *t = arg;
+
+    while (gameData->game_active) {
+        pthread_mutex_lock(&t->lock);
+        for (int i = 0; i < t->req_len; i++) apply(t, &t->reqs[i]);
+        t->req_len = 0;
+        pthread_mutex_unlock(&t->lock);
+
+        for (int i = 0; i < t->list_len; i++) deliver(t->list[i]);
+
+        // sleep until a followed room publishes or a request comes in
+        atomic_store(&t->sleeping, 1);
+        if (!pending(t)) {
+            struct pollfd pfd = { t->wake_fd, POLLIN, 0 };
+            poll(&pfd, 1, WATCH_POLL_MS);
+        }
+        atomic_store(&t->sleeping, 0);
+
+        uint64_t drain;
+        ssize_t r = read(t->wake_fd, &drain, sizeof(drain));
+        (void)r;
+    }
+    return NULL;
+}
+
+/* ---------- reactor side ---------- */
+
+void watch_init(int count) {
+    if (count < 1) count = 1;
+    threads = aligned_alloc(64, (size_t)count * sizeof(*threads));
+    if (!threads) { perror("watch"); exit(1); }
+    memset(threads, 0, (size_t)count * sizeof(*threads));
+
+    for (int i = 0; i < count; i++) {
+        struct WatchThread *t = &threads[i];
+        pthread_mutex_init(&t->lock, NULL);
+        t->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        t->by_room = calloc(MAX_ROOMS, sizeof(*t->by_room));
+        t->list = calloc(MAX_ROOMS, sizeof(*t->list));
+        if (t->wake_fd < 0 || !t->by_room || !t->list) { perror("watch"); exit(1); }
+    }
+    thread_count = count;
+
+    for (int i = 0; i < count; i++) {
+        pthread_create(&threads[i].thread, NULL, watch_thread, &threads[i]);
+        pthread_detach(threads[i].thread);
+    }
+    printf("[Watch] %d fan-out thread(s) started.\n", count);
+}
+
+// the room to watch: room_id if a game is on there, with -1 the first
+// table in play. -1 if there is none
+int watch_find(int room_id) {
+    if (thread_count == 0) return -1;
+
+    pthread_mutex_lock(&gameData->lobby_mutex);
+    if (room_id < 0) {
+        for (int i = 0; i < gameData->room_high_water && room_id < 0; i++) {
+            if (gameData->rooms[i].in_use) room_id = i;
+        }
+    }
+    bool ok = room_id >= 0 && room_id < gameData->room_high_water && gameData->rooms[room_id].in_use;
+    pthread_mutex_unlock(&gameData->lobby_mutex);
+    return ok ? room_id : -1;
+}
+
+static void request(struct Conn *conn, enum WatchOp op, int room) {
+    struct WatchThread *t = &threads[conn->fd % thread_count];
+
+    pthread_mutex_lock(&t->lock);
+    if (t->req_len == t->req_cap) {
+        int cap = t->req_cap ? t->req_cap * 2 : 64;
+        struct WatchReq *r = realloc(t->reqs, (size_t)cap * sizeof(*r));
+        if (!r) { perror("watch"); exit(1); }
+        t->reqs = r;
+        t->req_cap = cap;
+    }
+    t->reqs[t->req_len++] = (struct WatchReq){ op, conn_ref(conn), room };
+    pthread_mutex_unlock(&t->lock);
+
+    wake(t);
+}
+
+// start watching (or switch to) a room from watch_find(); the full
+// board follows from the fan-out thread
+void watch_join(struct Conn *conn, int room_id) {
+    if (conn->watch_room >= 0) request(conn, WATCH_LEAVE, conn->watch_room);
+    conn->watch_room = room_id;
+    request(conn, WATCH_JOIN, room_id);
+}
+
+// connection closing
+void watch_leave(struct Conn *conn) {
+    if (conn->watch_room < 0) return;
+    request(conn, WATCH_LEAVE, conn->watch_room);
+    conn->watch_room = -1;
+}
+
+// P_RESYNC from a spectator
+void watch_resync(struct Conn *conn) {
+    if (conn->watch_room >= 0) request(conn, WATCH_RESYNC, conn->watch_room);
+}